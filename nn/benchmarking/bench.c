@@ -0,0 +1,415 @@
+/**
+ * @file Microbenchmark harness
+ * @brief Times the kernels and training phases one by one (make bench)
+ *
+ * Every benchmark is warmed up and then repeated BENCH_REPEATS times. Fast kernels are
+ * called in a loop that is sized to run for at least BENCH_MIN_TIME per repetition, the
+ * times are reported per call. The median, the 95th percentile and the throughput of the
+ * median are printed and written as JSON next to the hyperfine results (results.json),
+ * with the same keys for the times so the same plots can read both.
+ *
+ * Usage: bench_simd [output.json]
+ */
+
+/* Includes ------------------------------------------ */
+#include "training.h"
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+/* --------------------------------------------------- */
+
+/* Defines- ------------------------------------------ */
+#define BENCH_WARMUP 3          // untimed repetitions before the measured ones
+#define BENCH_REPEATS 21        // measured repetitions of every benchmark
+#define BENCH_MIN_TIME 2e-3     // seconds a repetition of a fast kernel runs at least
+#define BENCH_MAX_RESULTS 32
+#define BENCH_HIDDEN_SIZES {128, 64}
+#define BENCH_NUM_HIDDEN 2
+#define BENCH_OUTPUT "benchmarking/bench-results.json"
+#define TEST_IMAGES "./data/t10k-images-idx3-ubyte"
+#define TEST_LABELS "./data/t10k-labels-idx1-ubyte"
+#define TEST_IMAGES_GZ TEST_IMAGES ".gz"
+#define TEST_LABELS_GZ TEST_LABELS ".gz"
+#define TEST_CSV "./data/mnist_test.csv"
+/* --------------------------------------------------- */
+
+/**
+ * @struct Bench_Result
+ * @brief Times of one benchmark and the work done by one call
+ */
+struct Bench_Result {
+    char name[64];                  /**< Name of the benchmark, the "command" in the JSON file */
+    const char *unit;               /**< "GFLOP/s" or "GB/s" */
+    double work;                    /**< Floating point operations or bytes of one call */
+    double times[BENCH_REPEATS];    /**< Seconds per call of every repetition, sorted */
+};
+/* --------------------------------------------------- */
+
+static struct Bench_Result results[BENCH_MAX_RESULTS];
+static int num_Results = 0;
+static volatile real sink;      // keeps the results of pure kernels alive
+
+/* Arguments of the benchmarked calls */
+struct Vector_Args {
+    const real *a;
+    const real *b;
+    real *y;
+    int size;
+    enum Activation activation;
+};
+
+struct Network_Args {
+    struct Network *network;
+    real *inputs;
+    real *targets;
+    const struct Data *data;
+    struct Inference_Scratch *scratch;
+};
+/* --------------------------------------------------- */
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Time a call, warmed up and repeated
+ * @param name name of the benchmark
+ * @param call function that is timed
+ * @param args arguments of the function
+ * @param work floating point operations or bytes of one call
+ * @param unit "GFLOP/s" or "GB/s"
+ * @param calibrate whether the call is repeated within a repetition until BENCH_MIN_TIME is reached
+ */
+static void run_Bench(const char *name, void (*call)(void *), void *args, double work, const char *unit, int calibrate)
+{
+    if (num_Results == BENCH_MAX_RESULTS){
+        fprintf(stderr, "Too many benchmarks, skipping %s\n", name);
+        return;
+    }
+    struct Bench_Result *result = &results[num_Results++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->unit = unit;
+    result->work = work;
+
+    for (int i = 0; i < BENCH_WARMUP; ++i){
+        call(args);
+    }
+    // the number of calls per repetition doubles until a repetition is long enough to time
+    long calls = 1;
+    while (calibrate){
+        double start = now();
+        for (long i = 0; i < calls; ++i){
+            call(args);
+        }
+        if (now() - start >= BENCH_MIN_TIME){
+            break;
+        }
+        calls *= 2;
+    }
+
+    for (int r = 0; r < BENCH_REPEATS; ++r){
+        double start = now();
+        for (long i = 0; i < calls; ++i){
+            call(args);
+        }
+        result->times[r] = (now() - start) / calls;
+    }
+    qsort(result->times, BENCH_REPEATS, sizeof(double), compare_doubles);
+}
+
+/* Statistics of the sorted times ------------------- */
+static double get_Median(const struct Bench_Result *result)
+{
+    return result->times[BENCH_REPEATS / 2];
+}
+
+static double get_P95(const struct Bench_Result *result)
+{
+    // nearest rank
+    int rank = (int)ceil(0.95 * BENCH_REPEATS);
+    return result->times[rank - 1];
+}
+
+static double get_Mean(const struct Bench_Result *result)
+{
+    double sum = 0.0;
+    for (int r = 0; r < BENCH_REPEATS; ++r){
+        sum += result->times[r];
+    }
+    return sum / BENCH_REPEATS;
+}
+
+static double get_Stddev(const struct Bench_Result *result)
+{
+    double mean = get_Mean(result), sum = 0.0;
+    for (int r = 0; r < BENCH_REPEATS; ++r){
+        sum += (result->times[r] - mean) * (result->times[r] - mean);
+    }
+    return sqrt(sum / (BENCH_REPEATS - 1));
+}
+
+static double get_Throughput(const struct Bench_Result *result)
+{
+    return result->work / get_Median(result) * 1e-9;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Parse the test set from the same files the main program prefers, without the cache
+ */
+static struct Data load_Test_Data(int num_rows)
+{
+    if (access(TEST_IMAGES, R_OK) == 0 && access(TEST_LABELS, R_OK) == 0){
+        return parse_MNIST_IDX(TEST_IMAGES, TEST_LABELS, num_rows, 10);
+    }
+    if (access(TEST_IMAGES_GZ, R_OK) == 0 && access(TEST_LABELS_GZ, R_OK) == 0){
+        return parse_MNIST_IDX(TEST_IMAGES_GZ, TEST_LABELS_GZ, num_rows, 10);
+    }
+    return parse_MNIST_CSV(TEST_CSV, num_rows, 10);
+}
+
+/* Benchmarked calls --------------------------------- */
+static void call_dotp(void *args)
+{
+    struct Vector_Args *v = (struct Vector_Args *)args;
+    sink = dotp(v->a, v->b, v->size);
+}
+
+static void call_activation_vec(void *args)
+{
+    struct Vector_Args *v = (struct Vector_Args *)args;
+    activation_vec(v->activation, v->a, v->b, v->y, v->size);
+}
+
+static void call_d_activation_vec(void *args)
+{
+    struct Vector_Args *v = (struct Vector_Args *)args;
+    // the errors are scaled in place, refresh them so they stay finite
+    memcpy(v->y, v->b, v->size * sizeof(real));
+    d_activation_vec(v->activation, v->a, v->y, v->size);
+}
+
+static void call_forward_propagate(void *args)
+{
+    struct Network_Args *n = (struct Network_Args *)args;
+    forward_propagate(n->network, n->inputs);
+}
+
+static void call_calculate_errors(void *args)
+{
+    struct Network_Args *n = (struct Network_Args *)args;
+    calculate_errors(n->network, n->targets);
+}
+
+static void call_update_weights(void *args)
+{
+    struct Network_Args *n = (struct Network_Args *)args;
+    update_weights(n->network, L_RATE);
+}
+
+static void call_predict_sample(void *args)
+{
+    struct Network_Args *n = (struct Network_Args *)args;
+    int label;
+    predict_Batch(n->network, n->scratch, n->inputs, INPUT_LAYER_SIZE, 1, &label);
+    sink = label;
+}
+
+static void call_calculate_accuracy(void *args)
+{
+    struct Network_Args *n = (struct Network_Args *)args;
+    sink = calculate_accuracy(n->network, n->data, n->data->num_Rows, NULL);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Send stdout to /dev/null, e.g. while the report of calculate_accuracy() is repeated
+ * @return the saved stdout for restore_stdout()
+ */
+static int silence_stdout(void)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0){
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    return saved;
+}
+
+static void restore_stdout(int saved)
+{
+    fflush(stdout);
+    if (saved >= 0){
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+static void call_load_dataset(void *args)
+{
+    struct Network_Args *n = (struct Network_Args *)args;
+    struct Data dataset = load_Test_Data(n->data->num_Rows);
+    sink = dataset.pixels[0];
+    free_Data(&dataset);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Benchmark the vector kernels on vectors of the given size
+ */
+static void bench_Kernels(int size)
+{
+    real *a = alloc_Matrix(1, size);
+    real *b = alloc_Matrix(1, size);
+    real *y = alloc_Matrix(1, size);
+    for (int i = 0; i < size; ++i){
+        a[i] = (real)rand() / RAND_MAX - 0.5;
+        b[i] = (real)rand() / RAND_MAX - 0.5;
+    }
+    struct Vector_Args args = {a, b, y, size, ACTIVATION_SIGMOID};
+    char name[64];
+
+    // two operations and two loaded values per element
+    snprintf(name, sizeof(name), "dotp/%d", size);
+    run_Bench(name, call_dotp, &args, 2.0 * size, "GFLOP/s", 1);
+
+    // the activations are bound by memory traffic rather than by a count of operations:
+    // the sums and biases are read and the outputs written
+    for (int act = 0; act < NUM_ACTIVATIONS; ++act){
+        args.activation = (enum Activation)act;
+        snprintf(name, sizeof(name), "activation_vec/%s/%d", get_Activation_Name(args.activation), size);
+        run_Bench(name, call_activation_vec, &args, 3.0 * size * sizeof(real), "GB/s", 1);
+    }
+    // the outputs and errors are read and the errors written, after a copy that refreshes them
+    for (int act = 0; act < NUM_ACTIVATIONS; ++act){
+        args.activation = (enum Activation)act;
+        snprintf(name, sizeof(name), "d_activation_vec/%s/%d", get_Activation_Name(args.activation), size);
+        run_Bench(name, call_d_activation_vec, &args, 5.0 * size * sizeof(real), "GB/s", 1);
+    }
+
+    free(a);
+    free(b);
+    free(y);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Benchmark the training phases of one sample, the data set loading and the evaluation
+ */
+static void bench_Network(void)
+{
+    int hidden_Sizes[] = BENCH_HIDDEN_SIZES;
+    struct Network network;
+    init_Network(&network, INPUT_LAYER_SIZE, hidden_Sizes, BENCH_NUM_HIDDEN, OUTPUT_LAYER_SIZE);
+    set_Network_Activations(&network, ACTIVATION_RELU, ACTIVATION_SOFTMAX);
+
+    // a multiply and an add per weight, the errors of the first hidden layer are not propagated further
+    double weights = 0.0, propagated = 0.0;
+    for (int l = 0; l < get_Num_Weighted_Layers(&network); ++l){
+        const struct Layer *layer = get_Const_Layer(&network, l);
+        weights += (double)layer->num_Inputs * layer->num_Neurons;
+        if (l > 0){
+            propagated += (double)layer->num_Inputs * layer->num_Neurons;
+        }
+    }
+
+    struct Data data = load_Test_Data(MAX_ROWS_TEST);
+    real *inputs = alloc_Matrix(1, INPUT_LAYER_SIZE);
+    real *targets = alloc_Matrix(1, OUTPUT_LAYER_SIZE);
+    get_Sample(&data, 0, inputs, targets);
+    struct Inference_Scratch scratch;
+    init_Inference_Scratch(&scratch, &network, 1);
+    struct Network_Args args = {&network, inputs, targets, &data, &scratch};
+
+    run_Bench("forward_propagate", call_forward_propagate, &args, 2.0 * weights, "GFLOP/s", 1);
+    // the latency of one sample, specialized with SPECIALIZE=784,128,64,10
+    run_Bench("predict_sample", call_predict_sample, &args, 2.0 * weights, "GFLOP/s", 1);
+    run_Bench("calculate_errors", call_calculate_errors, &args, 2.0 * propagated, "GFLOP/s", 1);
+    int saved = silence_stdout();
+    run_Bench("calculate_accuracy", call_calculate_accuracy, &args, 2.0 * weights * data.num_Rows, "GFLOP/s", 0);
+    restore_stdout(saved);
+    run_Bench("update_weights", call_update_weights, &args, 2.0 * weights, "GFLOP/s", 1);
+    // the raw pixels and labels that are decoded
+    run_Bench("load_dataset", call_load_dataset, &args, (double)data.num_Rows * (data.num_Features + 1), "GB/s", 0);
+
+    free(inputs);
+    free(targets);
+    free_Inference_Scratch(&scratch);
+    free_Data(&data);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Write the results in the layout of hyperfine's JSON export, extended by the percentile and throughput
+ * @return 1 on success, 0 otherwise
+ */
+static int write_Results(const char *filename)
+{
+    FILE *file = fopen(filename, "w");
+    if (file == NULL){
+        fprintf(stderr, "Could not open %s\n", filename);
+        return 0;
+    }
+    fprintf(file, "{\n");
+#ifdef SIMD
+    fprintf(file, "  \"cpu_level\": \"%s\",\n", get_Cpu_Level_Name(get_Cpu_Level()));
+#endif
+    fprintf(file, "  \"real\": \"%s\",\n", sizeof(real) == sizeof(float) ? "float" : "double");
+    fprintf(file, "  \"results\": [\n");
+    for (int i = 0; i < num_Results; ++i){
+        const struct Bench_Result *result = &results[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"command\": \"%s\",\n", result->name);
+        fprintf(file, "      \"mean\": %.9g,\n", get_Mean(result));
+        fprintf(file, "      \"stddev\": %.9g,\n", get_Stddev(result));
+        fprintf(file, "      \"median\": %.9g,\n", get_Median(result));
+        fprintf(file, "      \"p95\": %.9g,\n", get_P95(result));
+        fprintf(file, "      \"min\": %.9g,\n", result->times[0]);
+        fprintf(file, "      \"max\": %.9g,\n", result->times[BENCH_REPEATS - 1]);
+        fprintf(file, "      \"throughput\": %.6g,\n", get_Throughput(result));
+        fprintf(file, "      \"unit\": \"%s\",\n", result->unit);
+        fprintf(file, "      \"times\": [");
+        for (int r = 0; r < BENCH_REPEATS; ++r){
+            fprintf(file, "%s%.9g", r ? ", " : "", result->times[r]);
+        }
+        fprintf(file, "]\n    }%s\n", (i + 1 < num_Results) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+/* Main Entry ---------------------------------------- */
+int main(int argc, char **argv)
+{
+    const char *output = (argc >= 2) ? argv[1] : BENCH_OUTPUT;
+    srand(1);
+
+    bench_Kernels(INPUT_LAYER_SIZE);
+    bench_Kernels(128);
+    bench_Network();
+
+    fprintf(stdout, "%-36s %12s %12s %14s\n", "Benchmark", "median [us]", "p95 [us]", "throughput");
+    for (int i = 0; i < num_Results; ++i){
+        fprintf(stdout, "%-36s %12.3f %12.3f %9.3f %s\n", results[i].name, get_Median(&results[i]) * 1e6,
+                get_P95(&results[i]) * 1e6, get_Throughput(&results[i]), results[i].unit);
+    }
+    if (!write_Results(output)){
+        return 1;
+    }
+    fprintf(stdout, "Results written to %s\n", output);
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
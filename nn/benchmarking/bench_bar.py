@@ -0,0 +1,41 @@
+import json
+import sys
+
+import matplotlib.pyplot as plt
+import numpy as np
+
+# Data, written by make bench (or a hyperfine JSON export)
+filename = sys.argv[1] if len(sys.argv) > 1 else 'bench-results.json'
+with open(filename) as f:
+    results = json.load(f)['results']
+
+commands = [r['command'] for r in results]
+medians = np.array([r['median'] for r in results]) * 1e6
+p95s = np.array([r.get('p95', r['median']) for r in results]) * 1e6
+
+# Create bar chart, the error bars reach up to the 95th percentile
+x_pos = np.arange(len(commands))
+
+fig, ax = plt.subplots(figsize=(max(6, len(commands) * 0.5), 5))
+bars = ax.bar(x_pos, medians, yerr=[np.zeros_like(medians), p95s - medians], capsize=3, alpha=0.75,
+              ecolor='black', color='skyblue')
+
+# Add labels and title
+ax.set_xlabel('Benchmark')
+ax.set_ylabel('Median time per call (us)')
+ax.set_yscale('log')
+ax.set_title('Benchmarking Kernels and Training Phases')
+ax.set_xticks(x_pos)
+ax.set_xticklabels(commands, rotation=60, ha='right')
+
+# Attach the throughput above each bar
+for bar, result in zip(bars, results):
+    if 'throughput' in result:
+        ax.annotate(f"{result['throughput']:.1f} {result['unit']}",
+                    xy=(bar.get_x() + bar.get_width() / 2, bar.get_height()),
+                    xytext=(0, 3),
+                    textcoords="offset points",
+                    ha='center', va='bottom', rotation=90, fontsize=7)
+
+plt.tight_layout() # Adjust layout to make room for labels
+plt.show()
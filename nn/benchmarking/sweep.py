@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+#
+# Sweeps the seq, SIMD and parallel builds over a grid of network widths, depths, batch sizes
+# and OpenMP thread counts (make sweep). Run from the nn directory.
+#
+# Every build is compiled once into its own directory below build/sweep, with INSTRUMENT=1 so
+# every epoch reports its time and accuracy as JSON (see instrument.h). The topology is passed in
+# a config file, the batch size and thread count as --batch-size and --threads options. For every
+# grid point the throughput (samples/s over the training epochs), the time until the training
+# accuracy first reaches --target, the test accuracy and the peak RSS of the process are collected into one JSON file,
+# rewritten after every run so an interrupted sweep keeps its results.
+#
+# Example: python3 benchmarking/sweep.py --widths 64,256 --depths 1,2 --batches 32 --threads 1,2,4
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+NN_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SWEEP_DIR = os.path.join('build', 'sweep')
+EXECUTABLES = {'seq': 'main_seq', 'simd': 'main_simd', 'parallel': 'main_parallel'}
+
+
+def int_list(text):
+    return [int(value) for value in text.split(',') if value]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Scaling sweep over widths, depths, batch sizes and thread counts')
+    parser.add_argument('--builds', default='seq,simd,parallel', help='builds to run, of seq, simd and parallel')
+    parser.add_argument('--widths', type=int_list, default=[32, 128, 512], help='neurons of every hidden layer')
+    parser.add_argument('--depths', type=int_list, default=[1, 2, 3], help='numbers of hidden layers')
+    parser.add_argument('--batches', type=int_list, default=[16, 32, 128], help='mini-batch sizes')
+    parser.add_argument('--threads', type=int_list, default=None,
+                        help='OpenMP thread counts of the parallel build (default: 1, 2, 4, ... up to the number of cores)')
+    parser.add_argument('--train-mode', type=int, default=None, help='TRAIN_MODE of the parallel build')
+    parser.add_argument('--hidden-activation', default='relu')
+    parser.add_argument('--output-activation', default='softmax')
+    parser.add_argument('--target', type=float, default=95.0, help='training accuracy in percent for the time-to-accuracy')
+    parser.add_argument('--runs', type=int, default=1, help='runs per grid point, the median throughput is kept')
+    parser.add_argument('--workdir', default=NN_DIR, help='directory the programs run in, it has to contain data/')
+    parser.add_argument('--output', default=os.path.join(NN_DIR, 'benchmarking', 'sweep-results.json'))
+    args = parser.parse_args()
+
+    args.builds = [b for b in args.builds.split(',') if b]
+    for build in args.builds:
+        if build not in EXECUTABLES:
+            parser.error(f'unknown build {build}')
+    if args.threads is None:
+        cores = os.cpu_count() or 1
+        args.threads = [1]
+        while args.threads[-1] * 2 <= cores:
+            args.threads.append(args.threads[-1] * 2)
+        if args.threads[-1] != cores:
+            args.threads.append(cores)
+    return args
+
+
+def compile_build(build, train_mode):
+    """Compile one build, returns the path of the executable."""
+    build_dir = os.path.join(SWEEP_DIR, build + (f'-m{train_mode}' if train_mode is not None else ''))
+    command = ['make', '--no-print-directory', f'compile-{build}', f'BUILD_DIR={build_dir}', 'INSTRUMENT=1']
+    if train_mode is not None:
+        command.append(f'TRAIN_MODE={train_mode}')
+    subprocess.run(command, cwd=NN_DIR, check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(NN_DIR, build_dir, EXECUTABLES[build])
+
+
+def run_once(executable, config, batch, threads, workdir, target):
+    """Run one training, returns the measurements or None if the run failed."""
+    with tempfile.NamedTemporaryFile('r', suffix='.jsonl') as log:
+        env = dict(os.environ, NN_INSTRUMENT_LOG=log.name)
+        start = time.monotonic()
+        process = subprocess.Popen([executable, config, f'--batch-size={batch}', f'--threads={threads}'],
+                                   cwd=workdir, env=env,
+                                   stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        stderr = process.stderr.read()
+        # the resource usage of this child alone, RUSAGE_CHILDREN would give the maximum of all runs
+        _, status, usage = os.wait4(process.pid, 0)
+        seconds = time.monotonic() - start
+        if status != 0:
+            sys.stderr.write(stderr.decode(errors='replace'))
+            return None
+        records = [json.loads(line) for line in log if line.strip()]
+
+    epochs = [r for r in records if r['event'] == 'epoch']
+    evals = [r for r in records if r['event'] == 'eval']
+    train_seconds = sum(r['seconds'] for r in epochs)
+    train_samples = sum(r['samples'] for r in epochs)
+
+    time_to_accuracy = None
+    elapsed = 0.0
+    for record in epochs:
+        elapsed += record['seconds']
+        if record['accuracy'] >= target:
+            time_to_accuracy = elapsed
+            break
+
+    return {
+        'samples_per_second': train_samples / train_seconds if train_seconds > 0 else None,
+        'time_to_accuracy': time_to_accuracy,
+        'epochs': len(epochs),
+        'epoch_seconds': [r['seconds'] for r in epochs],
+        'train_accuracy': epochs[-1]['accuracy'] if epochs else None,
+        'test_accuracy': evals[-1]['accuracy'] if evals else None,
+        'phases': {phase: sum(r['phases'][phase] for r in epochs) for phase in epochs[0]['phases']} if epochs else {},
+        'peak_rss_kb': usage.ru_maxrss,
+        'seconds': seconds,
+    }
+
+
+def get_machine():
+    cpu = platform.processor()
+    try:
+        with open('/proc/cpuinfo') as f:
+            for line in f:
+                if line.startswith('model name'):
+                    cpu = line.split(':', 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    return {'cpu': cpu, 'cores': os.cpu_count(), 'system': platform.platform()}
+
+
+def main():
+    args = parse_args()
+    results = []
+    output = {
+        'machine': get_machine(),
+        'grid': {'builds': args.builds, 'widths': args.widths, 'depths': args.depths, 'batches': args.batches,
+                 'threads': args.threads, 'train_mode': args.train_mode, 'target': args.target,
+                 'hidden_activation': args.hidden_activation, 'output_activation': args.output_activation},
+        'results': results,
+    }
+
+    executables = {}
+    for build in args.builds:
+        print(f'Compiling {build}', flush=True)
+        executables[build] = compile_build(build, args.train_mode if build == 'parallel' else None)
+
+    with tempfile.TemporaryDirectory() as config_dir:
+        for depth in args.depths:
+            for width in args.widths:
+                hidden_sizes = [width] * depth
+                config = os.path.join(config_dir, f'w{width}-d{depth}.txt')
+                with open(config, 'w') as f:
+                    f.write(f'input_size=784\nhidden_sizes={",".join(map(str, hidden_sizes))}\noutput_size=10\n'
+                            f'hidden_activation={args.hidden_activation}\noutput_activation={args.output_activation}\n')
+
+                for batch in args.batches:
+                    for build in args.builds:
+                        # only the parallel build starts threads
+                        for threads in (args.threads if build == 'parallel' else [1]):
+                            runs = [run_once(executables[build], config, batch, threads, args.workdir, args.target)
+                                    for _ in range(args.runs)]
+                            runs = [r for r in runs if r is not None]
+                            if not runs:
+                                print(f'{build:8} width {width:4} depth {depth} batch {batch:4} threads {threads:3}  failed')
+                                continue
+                            runs.sort(key=lambda r: r['samples_per_second'] or 0.0)
+                            result = dict(runs[len(runs) // 2], build=build, width=width, depth=depth,
+                                          hidden_sizes=hidden_sizes, batch_size=batch, threads=threads, runs=len(runs))
+                            results.append(result)
+                            tta = result['time_to_accuracy']
+                            print(f'{build:8} width {width:4} depth {depth} batch {batch:4} threads {threads:3}  '
+                                  f'{result["samples_per_second"] or 0:10.0f} samples/s  '
+                                  f'to {args.target:g}%: {f"{tta:.2f} s" if tta is not None else "not reached":>11}  '
+                                  f'peak RSS {result["peak_rss_kb"] / 1024:7.1f} MiB', flush=True)
+                            with open(args.output, 'w') as f:
+                                json.dump(output, f, indent=2)
+
+    with open(args.output, 'w') as f:
+        json.dump(output, f, indent=2)
+    print(f'Results written to {args.output}')
+
+
+if __name__ == '__main__':
+    main()
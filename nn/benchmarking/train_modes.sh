@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Benchmarks the parallel training modes (TRAIN_MODE in net_parameters.h) against the
+# sequential version and compares the final accuracy of each of them.
+# Run from the nn directory (make benchmark-modes), the data is read from ./data.
+#
+# Each mode is built into its own directory below build/modes. hyperfine is used for
+# timing when it is installed, its JSON export is written to benchmarking/train-modes.json.
+
+set -e
+
+MODES_DIR=build/modes
+RUNS=${RUNS:-3}
+
+make --no-print-directory compile-seq BUILD_DIR=$MODES_DIR/seq > /dev/null
+for mode in 0 1 2; do
+    make --no-print-directory compile-parallel BUILD_DIR=$MODES_DIR/mode$mode TRAIN_MODE=$mode > /dev/null
+done
+
+SEQ=$MODES_DIR/seq/main_seq
+NEURON=$MODES_DIR/mode0/main_parallel
+DATA=$MODES_DIR/mode1/main_parallel
+HOGWILD=$MODES_DIR/mode2/main_parallel
+
+echo "Threads: ${OMP_NUM_THREADS:-$(nproc)}"
+echo "=============================="
+printf "%-34s %s\n" "Build" "Final accuracy"
+for exe in $SEQ $NEURON $DATA $HOGWILD; do
+    printf "%-34s %s\n" "$exe" "$(./$exe | sed -n 's/^Final Accuracy \[with unseen data\]: //p')"
+done
+echo "=============================="
+
+if command -v hyperfine > /dev/null; then
+    hyperfine --runs "$RUNS" --export-json benchmarking/train-modes.json \
+        -n sequential "./$SEQ" \
+        -n neuron-parallel "./$NEURON" \
+        -n data-parallel "./$DATA" \
+        -n hogwild "./$HOGWILD"
+else
+    for exe in $SEQ $NEURON $DATA $HOGWILD; do
+        start=$(date +%s.%N)
+        ./$exe > /dev/null
+        end=$(date +%s.%N)
+        awk -v exe="$exe" -v s="$start" -v e="$end" 'BEGIN { printf "%-34s %.3f s\n", exe, e - s }'
+    done
+fi
@@ -0,0 +1,90 @@
+/**
+ * @file Inference source file
+ * @brief Inference function definitions
+ */
+
+/* Includes ------------------------------------------ */
+#include "inference.h"
+#include "specialized.h"
+/* --------------------------------------------------- */
+
+void init_Inference_Scratch(struct Inference_Scratch *scratch, const struct Network *network, int max_Batch){
+    const int elements_Per_Line = WEIGHT_ALIGNMENT / sizeof(real);
+    int num_Layers = get_Num_Weighted_Layers(network);
+
+    scratch->max_Batch = max_Batch;
+    scratch->num_Layers = num_Layers;
+    scratch->ld = (int *)malloc((num_Layers + 1) * sizeof(int));
+    scratch->activations = (real **)malloc((num_Layers + 1) * sizeof(real *));
+    if (scratch->ld == NULL || scratch->activations == NULL){
+        fprintf(stderr, "Could not allocate inference scratch!");
+        exit(-1);
+    }
+
+    for (int l = 0; l <= num_Layers; ++l){
+        int width = (l == 0) ? network->input_Layer.num_Neurons : get_Const_Layer(network, l - 1)->num_Neurons;
+        scratch->ld[l] = (width + elements_Per_Line - 1) / elements_Per_Line * elements_Per_Line;
+        scratch->activations[l] = alloc_Matrix(max_Batch, scratch->ld[l]);
+    }
+}
+
+/* --------------------------------------------------- */
+void free_Inference_Scratch(struct Inference_Scratch *scratch){
+    if (scratch == NULL){
+        fprintf(stderr, "Inference scratch does not exist!\n");
+        return;
+    }
+    for (int l = 0; l <= scratch->num_Layers; ++l){
+        free(scratch->activations[l]);
+    }
+    free(scratch->activations);
+    free(scratch->ld);
+}
+
+/* --------------------------------------------------- */
+const real *infer_Batch(const struct Network *network, struct Inference_Scratch *scratch,
+                        const real *inputs, int ld_Inputs, int batch_Size){
+    if (SPECIALIZED && batch_Size <= SPECIALIZED_MAX_BATCH && is_Specialized_Network(network)){
+        // one sample after the other, with the layer sizes compiled into the kernels
+        real *outputs[MAX_HIDDEN_LAYERS + 1];
+        for (int s = 0; s < batch_Size; ++s){
+            for (int l = 0; l < scratch->num_Layers; ++l){
+                outputs[l] = scratch->activations[l + 1] + (size_t)s * scratch->ld[l + 1];
+            }
+            forward_Specialized(network, inputs + (size_t)s * ld_Inputs, outputs);
+        }
+        return scratch->activations[scratch->num_Layers];
+    }
+
+    const real *previous = inputs;
+    int ld_Previous = ld_Inputs;
+    for (int l = 0; l < scratch->num_Layers; ++l){
+        const struct Layer *layer = get_Const_Layer(network, l);
+        real *outputs = scratch->activations[l + 1];
+        int ld = scratch->ld[l + 1];
+
+        // outputs (batch x neurons) = previous activations (batch x inputs) * weights^T (inputs x neurons)
+        gemm(NO_TRANSPOSE, TRANSPOSE, batch_Size, layer->num_Neurons, layer->num_Inputs,
+             1.0, previous, ld_Previous, layer->weights, layer->stride,
+             0.0, outputs, ld);
+
+        for (int s = 0; s < batch_Size; ++s){
+            real *row = outputs + (size_t)s * ld;
+            activation_vec(layer->activation, row, layer->biases, row, layer->num_Neurons);
+        }
+        previous = outputs;
+        ld_Previous = ld;
+    }
+    return previous;
+}
+
+/* --------------------------------------------------- */
+void predict_Batch(const struct Network *network, struct Inference_Scratch *scratch,
+                   const real *inputs, int ld_Inputs, int batch_Size, int *labels){
+    const real *outputs = infer_Batch(network, scratch, inputs, ld_Inputs, batch_Size);
+    int ld_Out = scratch->ld[scratch->num_Layers];
+    for (int s = 0; s < batch_Size; ++s){
+        labels[s] = get_max_index(outputs + (size_t)s * ld_Out, network->output_Layer.num_Neurons);
+    }
+}
+/* --------------------------------------------------- */
@@ -0,0 +1,81 @@
+/**
+ * @file Inference header file
+ * @brief Read-only batched inference on a trained network
+ */
+#ifndef NN_INFERENCE_H
+#define NN_INFERENCE_H
+
+/* Includes ------------------------------------------ */
+#include "mathfunctions.h"
+#include "network.h"
+#include "workspace.h"
+/* --------------------------------------------------- */
+
+/**
+ * @struct Inference_Scratch
+ * @brief Caller-owned buffers of one inference batch
+ *
+ * Unlike a Workspace it has no room for errors, gradients or targets. The network is
+ * never written during inference, so any number of threads can run inference on the
+ * same network at the same time, as long as every thread uses its own scratch.
+ * - `activations[0]` is a staging buffer the caller may fill with the inputs of a batch
+ * - `activations[l + 1]` receives the outputs of weighted layer l
+ * - `ld[l]` is the leading dimension of `activations[l]`
+ */
+struct Inference_Scratch {
+    int max_Batch;          /**< Number of samples the matrices have room for */
+    int num_Layers;         /**< Number of weighted layers L */
+    int *ld;                /**< Leading dimensions of the activation matrices, L + 1 entries */
+    real **activations;     /**< Activation matrices (max_Batch x ld[l]), L + 1 entries */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Allocate the inference buffers for a network
+ * @param scratch pointer to the scratch struct that is going to be initialized
+ * @param network pointer to the network the buffers are sized for
+ * @param max_Batch maximum number of samples per batch
+ */
+void init_Inference_Scratch(struct Inference_Scratch *scratch, const struct Network *network, int max_Batch);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Delete the scratch struct previously initialized
+ * @param scratch pointer to the scratch struct that is going to be deleted
+ */
+void free_Inference_Scratch(struct Inference_Scratch *scratch);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Compute the outputs of the network for a batch of inputs
+ *
+ * The first layer reads the inputs in place, they can be the caller's own matrix or
+ * `scratch->activations[0]` after filling it. Batches of up to SPECIALIZED_MAX_BATCH
+ * samples run the specialized kernels if the build is specialized for the network's
+ * topology (see specialized.h).
+ *
+ * @param network pointer to the network, it is not changed
+ * @param scratch pointer to the scratch buffers of the calling thread
+ * @param inputs row-major matrix with the inputs of one sample per row
+ * @param ld_Inputs leading dimension (row stride) of inputs
+ * @param batch_Size number of samples, at most scratch->max_Batch
+ * @return the outputs (batch_Size x num_Outputs, leading dimension scratch->ld[L]), owned by the scratch
+ */
+const real *infer_Batch(const struct Network *network, struct Inference_Scratch *scratch,
+                        const real *inputs, int ld_Inputs, int batch_Size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Predict the class of every sample of a batch
+ * @param network pointer to the network, it is not changed
+ * @param scratch pointer to the scratch buffers of the calling thread
+ * @param inputs row-major matrix with the inputs of one sample per row
+ * @param ld_Inputs leading dimension (row stride) of inputs
+ * @param batch_Size number of samples, at most scratch->max_Batch
+ * @param labels array of batch_Size entries receiving the index of the largest output of each sample
+ */
+void predict_Batch(const struct Network *network, struct Inference_Scratch *scratch,
+                   const real *inputs, int ld_Inputs, int batch_Size, int *labels);
+/* --------------------------------------------------- */
+
+#endif //NN_INFERENCE_H
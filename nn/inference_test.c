@@ -0,0 +1,132 @@
+/**
+ * @brief Test for functions in inference.c
+ */
+/* Includes ------------------------------------------ */
+#include "layer.c"
+#include "network.c"
+#include "mathfunctions.c"
+#include "workspace.c"
+#include "mnist.c"
+#include "sampler.c"
+#include "pipeline.c"
+#include "instrument.c"
+#include "specialized.c"
+#include "training.c"
+#include "inference.c"
+#include <assert.h>
+
+/* Tolerance for results computed in a different order, float only keeps about 7 digits */
+#define EPSILON (sizeof(real) == sizeof(float) ? 1e-4 : 1e-12)
+/* --------------------------------------------------- */
+static void test_infer_Batch();
+static void test_infer_Batch_threads();
+/* --------------------------------------------------- */
+
+#define NUM_SAMPLES 9
+#define NUM_INPUTS 6
+#define NUM_OUTPUTS 3
+
+/**
+ * @brief Fill a matrix with random inputs, one sample per row
+ */
+static void fill_inputs(real inputs[NUM_SAMPLES][8])
+{
+    for (int s = 0; s < NUM_SAMPLES; ++s)
+    {
+        for (int i = 0; i < 8; ++i) inputs[s][i] = (i < NUM_INPUTS) ? (double)rand() / RAND_MAX : 0.0;
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that batched inference matches the single sample forward pass
+ *
+ * The outputs and predicted labels of a batch are compared with forward_propagate().
+ * Inference must not touch the layer buffers of the network.
+ */
+static void test_infer_Batch()
+{
+    int hidden_Sizes[] = {20, 12};
+    struct Network network;
+    srand(3);
+    init_Network(&network, NUM_INPUTS, hidden_Sizes, 2, NUM_OUTPUTS);
+    real inputs[NUM_SAMPLES][8];
+    fill_inputs(inputs);
+
+    struct Inference_Scratch scratch;
+    init_Inference_Scratch(&scratch, &network, NUM_SAMPLES);
+    assert(scratch.num_Layers == 3);
+    const real *outputs = infer_Batch(&network, &scratch, &inputs[0][0], 8, NUM_SAMPLES);
+    int labels[NUM_SAMPLES];
+    predict_Batch(&network, &scratch, &inputs[0][0], 8, NUM_SAMPLES, labels);
+
+    // nothing was written to the network
+    assert(network.input_Layer.outputs[0] == 0.0);
+    assert(network.output_Layer.outputs[0] == 0.0);
+
+    int ld_Out = scratch.ld[scratch.num_Layers];
+    for (int s = 0; s < NUM_SAMPLES; ++s)
+    {
+        forward_propagate(&network, inputs[s]);
+        for (int i = 0; i < NUM_OUTPUTS; ++i)
+        {
+            assert(fabs(outputs[s * ld_Out + i] - network.output_Layer.outputs[i]) < EPSILON);
+        }
+        assert(labels[s] == get_predicted_label(&network));
+    }
+
+    free_Inference_Scratch(&scratch);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that several threads can run inference on one network at the same time
+ */
+static void test_infer_Batch_threads()
+{
+    int hidden_Sizes[] = {20, 12};
+    struct Network network;
+    srand(5);
+    init_Network(&network, NUM_INPUTS, hidden_Sizes, 2, NUM_OUTPUTS);
+    real inputs[NUM_SAMPLES][8];
+    fill_inputs(inputs);
+
+    struct Inference_Scratch reference;
+    init_Inference_Scratch(&reference, &network, NUM_SAMPLES);
+    int expected[NUM_SAMPLES];
+    predict_Batch(&network, &reference, &inputs[0][0], 8, NUM_SAMPLES, expected);
+    free_Inference_Scratch(&reference);
+
+    int mismatches = 0;
+    #pragma omp parallel num_threads(4) reduction(+:mismatches)
+    {
+        struct Inference_Scratch scratch;
+        init_Inference_Scratch(&scratch, &network, NUM_SAMPLES);
+        for (int repeat = 0; repeat < 50; ++repeat)
+        {
+            int labels[NUM_SAMPLES];
+            predict_Batch(&network, &scratch, &inputs[0][0], 8, NUM_SAMPLES, labels);
+            for (int s = 0; s < NUM_SAMPLES; ++s)
+            {
+                mismatches += labels[s] != expected[s];
+            }
+        }
+        free_Inference_Scratch(&scratch);
+    }
+    assert(mismatches == 0);
+
+    free_Network(&network);
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_infer_Batch();
+    test_infer_Batch_threads();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
@@ -0,0 +1,187 @@
+/**
+ * @file Instrument source file
+ * @brief Instrument function definitions
+ */
+
+/* Includes ------------------------------------------ */
+#include "instrument.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+/* --------------------------------------------------- */
+
+static int initialized = 0;
+static FILE *log_File = NULL;
+static int counter_Fds[NUM_COUNTERS] = {-1, -1, -1};
+static double phase_Start[NUM_PHASES];
+static double phase_Total[NUM_PHASES];
+
+static const char *counter_Names[NUM_COUNTERS] = {"cycles", "instructions", "llc_misses"};
+
+/* --------------------------------------------------- */
+static double get_Wall_Time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Whether the calling thread is the first one of every enclosing team
+ */
+static int is_Timing_Thread(void)
+{
+    for (int level = 1; level <= omp_get_level(); ++level){
+        if (omp_get_ancestor_thread_num(level) != 0){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Open a counter of the calling thread and the threads it starts
+ * @return the file descriptor, or -1 if the OS does not allow the counter
+ */
+static int open_Counter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // counters that share the PMU with others only run part of the time and are scaled up
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @return the value of a counter, or -1 if it is unavailable
+ */
+static double read_Counter(enum Counter counter)
+{
+    uint64_t values[3]; // value, time enabled, time running
+    if (counter_Fds[counter] < 0 || read(counter_Fds[counter], values, sizeof(values)) != sizeof(values)){
+        return -1.0;
+    }
+    return values[2] > 0 ? values[0] * ((double)values[1] / values[2]) : 0.0;
+}
+
+/* --------------------------------------------------- */
+void init_Instrument(void){
+    if (initialized){
+        return;
+    }
+    initialized = 1;
+    log_File = stdout;
+    const char *filename = getenv("NN_INSTRUMENT_LOG");
+    if (filename != NULL && filename[0] != '\0'){
+        log_File = fopen(filename, "a");
+        if (log_File == NULL){
+            fprintf(stderr, "Could not open %s, the instrumentation log goes to stdout\n", filename);
+            log_File = stdout;
+        }
+    }
+
+    counter_Fds[COUNTER_CYCLES] = open_Counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counter_Fds[COUNTER_INSTRUCTIONS] = open_Counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counter_Fds[COUNTER_LLC_MISSES] = open_Counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                                                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    memset(phase_Total, 0, sizeof(phase_Total));
+}
+
+/* --------------------------------------------------- */
+void free_Instrument(void){
+    if (!initialized){
+        return;
+    }
+    for (int c = 0; c < NUM_COUNTERS; ++c){
+        if (counter_Fds[c] >= 0){
+            close(counter_Fds[c]);
+            counter_Fds[c] = -1;
+        }
+    }
+    if (log_File != stdout){
+        fclose(log_File);
+    }
+    log_File = NULL;
+    initialized = 0;
+}
+
+/* --------------------------------------------------- */
+void begin_Phase(enum Phase phase){
+    if (is_Timing_Thread()){
+        phase_Start[phase] = get_Wall_Time();
+    }
+}
+
+/* --------------------------------------------------- */
+void end_Phase(enum Phase phase){
+    if (is_Timing_Thread()){
+        phase_Total[phase] += get_Wall_Time() - phase_Start[phase];
+    }
+}
+
+/* --------------------------------------------------- */
+void start_Instrument_Interval(struct Instrument_Interval *interval){
+    init_Instrument();
+    memcpy(interval->phase_Seconds, phase_Total, sizeof(phase_Total));
+    for (int c = 0; c < NUM_COUNTERS; ++c){
+        interval->counters[c] = read_Counter((enum Counter)c);
+    }
+    // taken last, so reading the counters is not part of the interval
+    interval->start = get_Wall_Time();
+}
+
+/* --------------------------------------------------- */
+void log_Instrument_Interval(const struct Instrument_Interval *interval, const char *event, int epoch,
+                             int num_samples, int num_correct){
+    double seconds = get_Wall_Time() - interval->start;
+    init_Instrument();
+
+    fprintf(log_File, "{\"event\": \"%s\", ", event);
+    if (epoch >= 0){
+        fprintf(log_File, "\"epoch\": %d, ", epoch);
+    }
+    fprintf(log_File, "\"samples\": %d, \"correct\": %d, \"accuracy\": %.4f, \"seconds\": %.6f, \"samples_per_second\": %.1f, ",
+            num_samples, num_correct, num_samples > 0 ? 100.0 * num_correct / num_samples : 0.0, seconds,
+            seconds > 0.0 ? num_samples / seconds : 0.0);
+
+    fprintf(log_File, "\"phases\": {");
+    for (int p = 0; p < NUM_PHASES; ++p){
+        fprintf(log_File, "%s\"%s\": %.6f", p ? ", " : "", get_Phase_Name((enum Phase)p),
+                phase_Total[p] - interval->phase_Seconds[p]);
+    }
+    fprintf(log_File, "}, \"counters\": {");
+    for (int c = 0; c < NUM_COUNTERS; ++c){
+        double value = read_Counter((enum Counter)c);
+        fprintf(log_File, "%s\"%s\": ", c ? ", " : "", counter_Names[c]);
+        if (value < 0.0 || interval->counters[c] < 0.0){
+            fprintf(log_File, "null");
+        }
+        else{
+            fprintf(log_File, "%.0f", value - interval->counters[c]);
+        }
+    }
+    fprintf(log_File, "}}\n");
+    fflush(log_File);
+}
+
+/* --------------------------------------------------- */
+const char *get_Phase_Name(enum Phase phase){
+    static const char *names[NUM_PHASES] = {"staging", "forward", "errors", "update", "eval"};
+    return (phase >= 0 && phase < NUM_PHASES) ? names[phase] : "unknown";
+}
+/* --------------------------------------------------- */
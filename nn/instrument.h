@@ -0,0 +1,127 @@
+/**
+ * @file Instrument header file
+ * @brief Phase timers and hardware counters of training and evaluation, built with INSTRUMENT=1
+ */
+#ifndef NN_INSTRUMENT_H
+#define NN_INSTRUMENT_H
+
+/* Includes ------------------------------------------ */
+#include <stdint.h>
+#include "net_parameters.h"
+/* --------------------------------------------------- */
+
+/* Phase timers around a call, with INSTRUMENT 0 they expand to nothing */
+#if INSTRUMENT
+#define INSTRUMENT_BEGIN(phase) begin_Phase(phase)
+#define INSTRUMENT_END(phase) end_Phase(phase)
+#else
+#define INSTRUMENT_BEGIN(phase) ((void)0)
+#define INSTRUMENT_END(phase) ((void)0)
+#endif
+/* --------------------------------------------------- */
+
+/**
+ * @enum Phase
+ * @brief Parts of training and evaluation whose wall time is recorded
+ */
+enum Phase {
+    PHASE_STAGING = 0,  /**< Gathering a batch, or waiting for the pipeline to hand it out */
+    PHASE_FORWARD = 1,  /**< Forward propagation of a batch */
+    PHASE_ERRORS = 2,   /**< Errors of a batch */
+    PHASE_UPDATE = 3,   /**< Gradients and weight update of a batch */
+    PHASE_EVAL = 4,     /**< Accuracy on a data set */
+    NUM_PHASES
+};
+/* --------------------------------------------------- */
+
+/**
+ * @enum Counter
+ * @brief Hardware counters read through perf_event_open()
+ */
+enum Counter {
+    COUNTER_CYCLES = 0,         /**< CPU cycles */
+    COUNTER_INSTRUCTIONS = 1,   /**< Retired instructions */
+    COUNTER_LLC_MISSES = 2,     /**< Read misses of the last level cache */
+    NUM_COUNTERS
+};
+/* --------------------------------------------------- */
+
+/**
+ * @struct Instrument_Interval
+ * @brief Snapshot of the timers and counters at the start of an epoch or an evaluation
+ */
+struct Instrument_Interval {
+    double start;                           /**< Wall time of the start in seconds */
+    double phase_Seconds[NUM_PHASES];       /**< Time recorded in every phase before the start */
+    double counters[NUM_COUNTERS];          /**< Counter values at the start, negative if unavailable */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Open the hardware counters and the log
+ *
+ * The counters count the calling thread and the threads it starts later, so this has to run
+ * before the first parallel region. Counters the OS does not allow (e.g. perf_event_paranoid,
+ * containers, virtual machines) are reported as null. The log is written to the file named by
+ * NN_INSTRUMENT_LOG in the environment, or to stdout. Calling it again does nothing.
+ */
+void init_Instrument(void);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Close the hardware counters and the log
+ */
+void free_Instrument(void);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Start the timer of a phase
+ *
+ * It can be called by every thread of a parallel region, only the first thread of every
+ * enclosing team records, so the phase times are those of one thread.
+ *
+ * @param phase the phase that starts
+ */
+void begin_Phase(enum Phase phase);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Stop the timer of a phase and add the time to its total
+ * @param phase the phase that ends, started with begin_Phase()
+ */
+void end_Phase(enum Phase phase);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Take a snapshot of the timers and counters
+ * @param interval receives the snapshot
+ */
+void start_Instrument_Interval(struct Instrument_Interval *interval);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Write one record of the time, phases and counters since a snapshot to the log
+ *
+ * The record is one line of JSON, e.g.
+ * `{"event": "epoch", "epoch": 0, "samples": 60000, "correct": 52000, "accuracy": 86.67, "seconds": 3.1,
+ *   "samples_per_second": 19354.8, "phases": {"staging": 0.2, ...}, "counters": {"cycles": 9.1e9, ...}}`
+ *
+ * @param interval snapshot taken at the start
+ * @param event name of the record, "epoch" or "eval"
+ * @param epoch number of the epoch, or negative to leave it out
+ * @param num_samples number of samples processed since the snapshot
+ * @param num_correct number of correct predictions among them
+ */
+void log_Instrument_Interval(const struct Instrument_Interval *interval, const char *event, int epoch,
+                             int num_samples, int num_correct);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the name of a phase as written to the log
+ * @param phase the phase
+ * @return "staging", "forward", "errors", "update" or "eval"
+ */
+const char *get_Phase_Name(enum Phase phase);
+/* --------------------------------------------------- */
+
+#endif //NN_INSTRUMENT_H
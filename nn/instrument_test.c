@@ -0,0 +1,103 @@
+/**
+ * @brief Test for functions in instrument.c
+ */
+/* Includes ------------------------------------------ */
+#include "instrument.c"
+#include <assert.h>
+/* --------------------------------------------------- */
+static void test_Phases();
+static void test_log_Instrument_Interval();
+/* --------------------------------------------------- */
+
+#define LOG_FILE "/tmp/nn_instrument_test.log"
+
+static void sleep_Seconds(double seconds)
+{
+    struct timespec ts = {0, (long)(seconds * 1e9)};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Function to test that only the first thread of every team records a phase
+ */
+static void test_Phases(){
+    memset(phase_Total, 0, sizeof(phase_Total));
+    begin_Phase(PHASE_FORWARD);
+    sleep_Seconds(0.01);
+    end_Phase(PHASE_FORWARD);
+    assert(phase_Total[PHASE_FORWARD] >= 0.01 && phase_Total[PHASE_FORWARD] < 1.0);
+    assert(phase_Total[PHASE_UPDATE] == 0.0);
+
+    // every thread runs the phase once, the time is added once
+    double before = phase_Total[PHASE_UPDATE];
+    #pragma omp parallel num_threads(4)
+    {
+        begin_Phase(PHASE_UPDATE);
+        #pragma omp parallel num_threads(2)
+        {
+            assert(is_Timing_Thread() == (omp_get_ancestor_thread_num(1) == 0 && omp_get_thread_num() == 0));
+        }
+        sleep_Seconds(0.01);
+        end_Phase(PHASE_UPDATE);
+    }
+    assert(phase_Total[PHASE_UPDATE] - before >= 0.01 && phase_Total[PHASE_UPDATE] - before < 0.04);
+    assert(strcmp(get_Phase_Name(PHASE_STAGING), "staging") == 0);
+    assert(strcmp(get_Phase_Name(PHASE_EVAL), "eval") == 0);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that a record holds the time of the phases since the snapshot
+ */
+static void test_log_Instrument_Interval(){
+    remove(LOG_FILE);
+    setenv("NN_INSTRUMENT_LOG", LOG_FILE, 1);
+    init_Instrument();
+    memset(phase_Total, 0, sizeof(phase_Total));
+    phase_Total[PHASE_ERRORS] = 5.0;
+
+    struct Instrument_Interval interval;
+    start_Instrument_Interval(&interval);
+    begin_Phase(PHASE_ERRORS);
+    sleep_Seconds(0.01);
+    end_Phase(PHASE_ERRORS);
+    log_Instrument_Interval(&interval, "epoch", 3, 200, 50);
+    log_Instrument_Interval(&interval, "eval", -1, 10, 10);
+    free_Instrument();
+    unsetenv("NN_INSTRUMENT_LOG");
+
+    FILE *file = fopen(LOG_FILE, "r");
+    assert(file != NULL);
+    char line[1024];
+    assert(fgets(line, sizeof(line), file) != NULL);
+    const char *epoch_Prefix = "{\"event\": \"epoch\", \"epoch\": 3, \"samples\": 200, \"correct\": 50, \"accuracy\": 25.0000, ";
+    assert(strncmp(line, epoch_Prefix, strlen(epoch_Prefix)) == 0);
+    // only the time since the snapshot is counted
+    double errors = -1.0;
+    char *field = strstr(line, "\"errors\": ");
+    assert(field != NULL && sscanf(field, "\"errors\": %lf", &errors) == 1);
+    assert(errors >= 0.01 && errors < 1.0);
+    assert(strstr(line, "\"staging\": 0.000000") != NULL);
+    // the counters are numbers or null, depending on what the OS allows
+    assert(strstr(line, "\"counters\": {\"cycles\": ") != NULL);
+    assert(line[strlen(line) - 2] == '}' && line[strlen(line) - 1] == '\n');
+
+    assert(fgets(line, sizeof(line), file) != NULL);
+    const char *eval_Prefix = "{\"event\": \"eval\", \"samples\": 10, ";
+    assert(strncmp(line, eval_Prefix, strlen(eval_Prefix)) == 0);
+    assert(fgets(line, sizeof(line), file) == NULL);
+    fclose(file);
+    remove(LOG_FILE);
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_Phases();
+    test_log_Instrument_Interval();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
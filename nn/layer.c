@@ -6,49 +6,132 @@
 /* Includes ------------------------------------------ */
 #include "layer.h"
 
+/* --------------------------------------------------- */
+/**
+ * @brief Draw random weights suited to the activation function of the layer
+ *
+ * Sigmoid layers keep the original uniform [0.0, 1.0] weights. ReLU layers use the
+ * He range +-sqrt(6 / inputs) and tanh and softmax layers the Xavier range
+ * +-sqrt(6 / (inputs + neurons)), which keep the variance of the outputs
+ * about constant from layer to layer.
+ */
+static void init_Weights(struct Layer *layer){
+    double low = 0.0, high = 1.0;
+    if (layer->activation == ACTIVATION_RELU || layer->activation == ACTIVATION_LEAKY_RELU){
+        high = sqrt(6.0 / layer->num_Inputs);
+        low = -high;
+    }
+    else if (layer->activation != ACTIVATION_SIGMOID){
+        high = sqrt(6.0 / (layer->num_Inputs + layer->num_Neurons));
+        low = -high;
+    }
+
+    for(int i = 0; i < layer->num_Neurons; i++){
+        real *row = get_Weight_Row(layer, i);
+        /* Iterates through num_Inputs and for each connection, it initializes the weights */
+        for (int j = 0; j < layer->num_Inputs; ++j) {
+            /* seed for the random function should be defined in the main program, so that it is only called once */
+            row[j] = (real)(low + (high - low) * ((double)rand() / RAND_MAX));
+        }
+        /* padding never contributes to a result, keep it at 0 */
+        for (int j = layer->num_Inputs; j < layer->stride; ++j) {
+            row[j] = 0.0;
+        }
+    }
+}
+
 /* --------------------------------------------------- */
 void init_Layer(struct Layer *layer, int num_Neurons, int num_Inputs_Per_Neurons){
     layer->num_Neurons = num_Neurons; /* number of neurons of the layer are num_Neurons passed as argument */
+    layer->num_Inputs = num_Inputs_Per_Neurons;
+    /* round the row length up to a whole number of cache lines */
+    const int elements_Per_Line = WEIGHT_ALIGNMENT / sizeof(real);
+    layer->stride = (num_Inputs_Per_Neurons + elements_Per_Line - 1) / elements_Per_Line * elements_Per_Line;
+    layer->activation = ACTIVATION_SIGMOID;
+    layer->first_Moments = NULL;
+    layer->second_Moments = NULL;
+
     /* allocate memory for outputs array */
-    layer->outputs = (double *)malloc(num_Neurons * sizeof(double));
+    layer->outputs = (real *)malloc(num_Neurons * sizeof(real));
     /* check malloc is healthy */
     if (layer->outputs == NULL){
         fprintf(stderr, "Could not allocate layer->outputs!");
         exit(-1);
     }
 
-    /* allocate memory for weights 2D array */
-    layer->weights = (double **)malloc(num_Neurons * sizeof(double *));
-    /* check malloc is healthy */
-    if (layer->weights == NULL){
-        fprintf(stderr, "Could not allocate layer->weights!");
+    /* allocate one aligned block for the whole weight matrix */
+    size_t weights_Size = (size_t)num_Neurons * layer->stride * sizeof(real);
+    layer->weights = NULL;
+    if (weights_Size > 0){
+        /* weights_Size is a multiple of WEIGHT_ALIGNMENT as required by aligned_alloc */
+        layer->weights = (real *)aligned_alloc(WEIGHT_ALIGNMENT, weights_Size);
+        /* check malloc is healthy */
+        if (layer->weights == NULL){
+            fprintf(stderr, "Could not allocate layer->weights!");
+            exit(-1);
+        }
+    }
+
+    /* allocate memory for biases array */
+    layer->biases = (real *)malloc(num_Neurons * sizeof(real));
+    if (layer->biases == NULL){
+        fprintf(stderr, "Could not allocate layer->biases!");
         exit(-1);
     }
 
     /* allocate memory for errors array */
-    layer->errors = (double *)malloc(num_Neurons * sizeof(double));
+    layer->errors = (real *)malloc(num_Neurons * sizeof(real));
     if (layer->errors == NULL){
         fprintf(stderr, "Could not allocate layer->errors!");
         exit(-1);
     }
 
-    /* initialize the weights randomly and outputs to 0 */
+    /* initialize the weights randomly, outputs and biases to 0 */
     for(int i = 0; i < num_Neurons; i++){
         layer->outputs[i] = 0.0;
+        layer->biases[i] = 0.0;
+    }
+    init_Weights(layer);
+}
+/* --------------------------------------------------- */
 
-        /* Allocate memory for the weights of the current neuron */
-        layer->weights[i] = (double *)malloc(num_Inputs_Per_Neurons * sizeof(double));
-        /* check malloc is healthy */
-        if (layer->weights[i] == NULL){
-            fprintf(stderr, "Could not allocate layer->weights[%d]", i);
-            exit(-1);
-        }
-        /* Second for-loop because weights is a 2D Array */
-        /* Iterates through num_Inputs_Per_Neuron and for each connection, it initializes the weights */
-        for (int j = 0; j < num_Inputs_Per_Neurons; ++j) {
-            /* seed for the random function should be defined in the main program, so that it is only called once */
-            layer->weights[i][j] = ((double)rand() / RAND_MAX); /* initialize randomly weights from 0 to 1*/
-        }
+void set_Layer_Activation(struct Layer *layer, enum Activation activation){
+    if (layer->activation == activation){
+        return;
+    }
+    layer->activation = activation;
+    init_Weights(layer);
+}
+/* --------------------------------------------------- */
+
+/**
+ * @brief Allocate one zeroed optimizer state block, the weight part aligned like the weights
+ */
+static real *alloc_Moments(const struct Layer *layer){
+    size_t count = (size_t)layer->num_Neurons * layer->stride + layer->num_Neurons;
+    size_t size = (count * sizeof(real) + WEIGHT_ALIGNMENT - 1) / WEIGHT_ALIGNMENT * WEIGHT_ALIGNMENT;
+    real *moments = (real *)aligned_alloc(WEIGHT_ALIGNMENT, size);
+    if (moments == NULL){
+        fprintf(stderr, "Could not allocate optimizer state!");
+        exit(-1);
+    }
+    for (size_t i = 0; i < count; ++i){
+        moments[i] = 0.0;
+    }
+    return moments;
+}
+/* --------------------------------------------------- */
+
+void set_Layer_Optimizer(struct Layer *layer, enum Optimizer optimizer){
+    free(layer->first_Moments);
+    free(layer->second_Moments);
+    layer->first_Moments = NULL;
+    layer->second_Moments = NULL;
+    if (optimizer == OPTIMIZER_MOMENTUM || optimizer == OPTIMIZER_ADAM){
+        layer->first_Moments = alloc_Moments(layer);
+    }
+    if (optimizer == OPTIMIZER_RMSPROP || optimizer == OPTIMIZER_ADAM){
+        layer->second_Moments = alloc_Moments(layer);
     }
 }
 /* --------------------------------------------------- */
@@ -59,11 +142,13 @@ void free_Layer(struct Layer *layer){
                       "Exiting Program!\n");
         return;
     }
-    //free all weights[i] and weights
-    for (int i = 0; i < layer->num_Neurons; ++i) {
-        free(layer->weights[i]);
-    }
+    //free the weight matrix
     free(layer->weights);
+    //free the biases
+    free(layer->biases);
+    //free the optimizer state
+    free(layer->first_Moments);
+    free(layer->second_Moments);
     //free all outputs
     free(layer->outputs);
     // free errors
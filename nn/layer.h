@@ -10,6 +10,11 @@
 #include <stdlib.h>
 #include <time.h>
 #include "net_parameters.h"
+#include "mathfunctions.h"
+/* --------------------------------------------------- */
+
+/* Defines- ------------------------------------------ */
+#define WEIGHT_ALIGNMENT 64 // Alignment in bytes of the weight matrix and of each of its rows (one cache line)
 /* --------------------------------------------------- */
 
 /**
@@ -19,15 +24,31 @@
  * The `Layer` struct is used to represent a single layer in a neural network.
  * It contains the following fields:
  * - `outputs`: An array storing the output values of each neuron in the layer.
- * - `weights`: A 2D array storing pointers to arrays of weights for each neuron.
+ * - `weights`: A contiguous row-major matrix with one row of weights per neuron.
+ * - `biases`: An array with the bias of each neuron, added to its weighted sum.
  * - `num_Neurons`: The number of neurons in the layer.
+ * - `num_Inputs`: The number of weights per neuron (neurons of the previous layer).
+ * - `stride`: The leading dimension of `weights`, i.e. the distance between two rows.
  * - `errors`: An array storing error values used during backpropagation.
+ * - `activation`: The activation function of the neurons.
+ * - `first_Moments`, `second_Moments`: Optimizer state, each one block laid out like `weights`
+ *   and followed by one entry per bias, or NULL if the optimizer does not use it.
+ *
+ * The weights of neuron `i` start at `weights[i * stride]`. The stride is `num_Inputs`
+ * rounded up to a multiple of WEIGHT_ALIGNMENT bytes, so every row starts on a cache line
+ * and the whole matrix is one allocation that can be streamed from front to back.
  */
 struct Layer {
-    double *outputs;    /**< Array to store the output values of each neuron in the layer */
-    double **weights;   /**< 2D array to store the weights for each neuron's connections */
+    real *outputs;      /**< Array to store the output values of each neuron in the layer */
+    real *weights;      /**< Row-major matrix (num_Neurons x stride) with the weights of each neuron's connections */
+    real *biases;       /**< Array with the bias of each neuron */
     int num_Neurons;    /**< Number of neurons in the layer */
-    double *errors;     /**< Array to store error values for backpropagation */
+    int num_Inputs;     /**< Number of connections per neuron to the previous layer */
+    int stride;         /**< Leading dimension of weights in elements (padded num_Inputs) */
+    real *errors;       /**< Array to store error values for backpropagation */
+    enum Activation activation; /**< Activation function of the neurons */
+    real *first_Moments;    /**< Velocity or mean of the gradients (num_Neurons x stride + num_Neurons), or NULL */
+    real *second_Moments;   /**< Mean square of the gradients (num_Neurons x stride + num_Neurons), or NULL */
 };
 /* --------------------------------------------------- */
 
@@ -39,12 +60,37 @@ struct Layer {
  * in case of input layer to the data
  *
  * This function initializes a layer by allocating memory for the output of each output values
- * of each neuron and the weights associated with each input connection to those neurons.
- * It initializes the outputs to 0.0 and the weights to random numbers between [0.0, 1.0]
+ * of each neuron and one aligned block for the weights associated with each input connection
+ * to those neurons. The activation is sigmoid. It initializes the outputs to 0.0, the weights
+ * to random numbers between [0.0, 1.0], the padding at the end of each row and the biases to 0.0
  */
 void init_Layer(struct Layer *layer, int num_Neurons, int num_Inputs_Per_Neurons);
 /* --------------------------------------------------- */
 
+/**
+ * @brief Change the activation function of a layer
+ *
+ * If the activation changes, the weights are drawn again in a range suited to it
+ * (He initialization for ReLU, Xavier for tanh and softmax).
+ *
+ * @param layer pointer to the layer struct
+ * @param activation the new activation function
+ */
+void set_Layer_Activation(struct Layer *layer, enum Activation activation);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Allocate the state an optimizer keeps for the weights and biases of a layer
+ *
+ * Any previous state is released, the new state starts at 0.0. Momentum keeps first moments,
+ * RMSProp second moments and Adam both, plain SGD none.
+ *
+ * @param layer pointer to the layer struct
+ * @param optimizer the update rule the layer is trained with
+ */
+void set_Layer_Optimizer(struct Layer *layer, enum Optimizer optimizer);
+/* --------------------------------------------------- */
+
 /**
  * @brief Delete the layer struct previously initialized
  * @param layer pointer to the layer struct that is going to be deleted
@@ -52,5 +98,41 @@ void init_Layer(struct Layer *layer, int num_Neurons, int num_Inputs_Per_Neurons
 void free_Layer(struct Layer *layer);
 /* --------------------------------------------------- */
 
-#endif //NN_LAYER_H
+/**
+ * @brief Get the weights of one neuron
+ * @param layer pointer to the layer struct
+ * @param neuron index of the neuron in the layer
+ * @return pointer to the first of the `num_Inputs` weights of the neuron
+ */
+static inline real *get_Weight_Row(const struct Layer *layer, int neuron)
+{
+    return layer->weights + (size_t)neuron * layer->stride;
+}
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the optimizer state of the weights of one neuron
+ * @param layer pointer to the layer struct
+ * @param moments `first_Moments` or `second_Moments` of the layer
+ * @param neuron index of the neuron in the layer
+ * @return pointer to the state of the first weight of the neuron, NULL if `moments` is NULL
+ */
+static inline real *get_Moment_Row(const struct Layer *layer, real *moments, int neuron)
+{
+    return (moments != NULL) ? moments + (size_t)neuron * layer->stride : NULL;
+}
+/* --------------------------------------------------- */
 
+/**
+ * @brief Get the part of an optimizer state block that belongs to the biases
+ * @param layer pointer to the layer struct
+ * @param moments `first_Moments` or `second_Moments` of the layer
+ * @return pointer to the `num_Neurons` entries of the biases, NULL if `moments` is NULL
+ */
+static inline real *get_Bias_Moments(const struct Layer *layer, real *moments)
+{
+    return (moments != NULL) ? moments + (size_t)layer->num_Neurons * layer->stride : NULL;
+}
+/* --------------------------------------------------- */
+
+#endif //NN_LAYER_H
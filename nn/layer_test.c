@@ -6,6 +6,7 @@
 #include <assert.h>
 /* --------------------------------------------------- */
 static void test_init_Layer();
+static void test_set_Layer_Activation();
 /**
  * @brief Function to test the function to initialize the artificial neuronal network layer
  *
@@ -20,10 +21,19 @@ static void test_init_Layer(){
     /* Initializes a Layer (layer) with 5 Neurons and each Neuron is connected to 3 Neuron from previous layer*/
     init_Layer(&layer, 5,3);
     assert(layer.num_Neurons == 5);
+    assert(layer.num_Inputs == 3);
+    /* rows are padded to whole cache lines and the matrix is aligned */
+    assert(layer.stride >= 3 && (layer.stride * sizeof(real)) % WEIGHT_ALIGNMENT == 0);
+    assert((size_t)layer.weights % WEIGHT_ALIGNMENT == 0);
     for (int i = 0; i < layer.num_Neurons; ++i) {
         assert(layer.outputs[i] == 0.0);
+        const real *row = get_Weight_Row(&layer, i);
+        assert(row == layer.weights + i * layer.stride);
         for (int j = 0; j < 3; ++j) {
-            assert(layer.weights[i][j] >= 0.0 && layer.weights[i][j] <= 1.0);
+            assert(row[j] >= 0.0 && row[j] <= 1.0);
+        }
+        for (int j = 3; j < layer.stride; ++j) {
+            assert(row[j] == 0.0);
         }
     }
 
@@ -33,12 +43,55 @@ static void test_init_Layer(){
 }
 /* --------------------------------------------------- */
 
+/**
+ * @brief Function to test that a new activation function draws weights in its own range
+ */
+static void test_set_Layer_Activation(){
+    struct Layer layer;
+    init_Layer(&layer, 5, 24);
+    assert(layer.activation == ACTIVATION_SIGMOID);
+
+    /* He initialization for ReLU, centered around 0 */
+    set_Layer_Activation(&layer, ACTIVATION_RELU);
+    assert(layer.activation == ACTIVATION_RELU);
+    double limit = sqrt(6.0 / 24), sum = 0.0;
+    for (int i = 0; i < layer.num_Neurons; ++i) {
+        const real *row = get_Weight_Row(&layer, i);
+        for (int j = 0; j < 24; ++j) {
+            assert(fabs(row[j]) <= limit);
+            sum += row[j];
+        }
+        for (int j = 24; j < layer.stride; ++j) {
+            assert(row[j] == 0.0);
+        }
+    }
+    assert(fabs(sum / (5 * 24)) < limit / 4);
+
+    /* the same activation keeps the weights */
+    real first = layer.weights[0];
+    set_Layer_Activation(&layer, ACTIVATION_RELU);
+    assert(layer.weights[0] == first);
+
+    /* Xavier initialization for tanh */
+    set_Layer_Activation(&layer, ACTIVATION_TANH);
+    limit = sqrt(6.0 / (24 + 5));
+    for (int i = 0; i < layer.num_Neurons; ++i) {
+        for (int j = 0; j < 24; ++j) {
+            assert(fabs(get_Weight_Row(&layer, i)[j]) <= limit);
+        }
+    }
+
+    free_Layer(&layer);
+}
+/* --------------------------------------------------- */
+
 /**
  * Main entry for the test.
  */
 int main(int argc, char **argv)
 {
     test_init_Layer();
+    test_set_Layer_Activation();
 
     return 0;
 
@@ -5,44 +5,87 @@
 /* Includes ------------------------------------------ */
 #include "training.h"
 #include "ctype.h"
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <omp.h>
 
 /* Defines- ------------------------------------------ */
+#define TRAIN_IMAGES "./data/train-images-idx3-ubyte.gz"
+#define TRAIN_LABELS "./data/train-labels-idx1-ubyte.gz"
+#define TEST_IMAGES "./data/t10k-images-idx3-ubyte.gz"
+#define TEST_LABELS "./data/t10k-labels-idx1-ubyte.gz"
 #define TRAIN_CSV "./data/mnist_train.csv"
 #define TEST_CSV "./data/mnist_test.csv"
 
+/**
+ * @struct Config
+ * @brief Everything a run can be configured with, from the defaults, the config file and the command line
+ */
+struct Config {
+    int input_Size;                         /**< Neurons of the input layer */
+    int hidden_Sizes[MAX_HIDDEN_LAYERS];    /**< Neurons of every hidden layer */
+    int num_Hidden_Layers;                  /**< Number of hidden layers */
+    int output_Size;                        /**< Neurons of the output layer */
+    enum Activation hidden_Activation;      /**< Activation of the hidden layers */
+    enum Activation output_Activation;      /**< Activation of the output layer */
+    enum Optimizer optimizer;               /**< Update rule of the training */
+    struct Training_Config training;        /**< Epochs, learning rate, batch size, ... */
+    int log_Level;                          /**< See set_Log_Level() */
+    int threads;                            /**< OpenMP threads, 0 for the OpenMP default */
+    char cpu_Level[16];                     /**< Instruction set of the SIMD kernels, empty for the detected one */
+    char save_Model[FILENAME_MAX];          /**< Model file written after training */
+    char load_Model[FILENAME_MAX];          /**< Model file used instead of training */
+    char train_Images[FILENAME_MAX];        /**< IDX files and CSV export of the training set */
+    char train_Labels[FILENAME_MAX];
+    char train_Csv[FILENAME_MAX];
+    char test_Images[FILENAME_MAX];         /**< IDX files and CSV export of the test set */
+    char test_Labels[FILENAME_MAX];
+    char test_Csv[FILENAME_MAX];
+};
+
 /* Prototypes----------------------------------------- */
-int parse_config_file(const char *config_file, int *input_Size, int *hidden_Sizes, int *num_Hidden_Layers, int *output_Size);
+void init_config(struct Config *config);
+int set_config_option(struct Config *config, const char *key, char *value);
+int parse_config_file(const char *config_file, struct Config *config);
+static long parse_integer(const char *key, const char *value, long minimum, long maximum);
+void print_usage(const char *program);
 void print_network_structure(struct Network *network);
+struct Data load_dataset(const char *images_file, const char *labels_file, const char *csv_file, int num_rows);
 
 /* Main Entry ---------------------------------------- */
 int main(int argc, char **argv)
 {
-    // Print which mode is chosen based on the compilation flag
-#if defined(SEQ)
-    fprintf(stdout, "Sequential Processing\n");
-    fprintf(stdout, "==============================\n");
-#elif defined(PARALLEL)
-    fprintf(stdout, "Parallel Processing - OMP\n");
-    fprintf(stdout, "==============================\n");
-#elif defined(SIMD)
-    fprintf(stdout, "SIMD Processing\n");
-    fprintf(stdout, "==============================\n");
-#endif
+    // The hardware counters only follow the threads started after they are opened
+    if (INSTRUMENT)
+    {
+        init_Instrument();
+    }
 
     struct Network network;
-    int input_Size = INPUT_LAYER_SIZE;            // Default input size
-    int hidden_Sizes[MAX_HIDDEN_LAYERS];          // Allocate space for hidden layers
-    int num_Hidden_Layers = NUMBER_HIDDEN_LAYERS; // Default number of hidden layers
-    int output_Size = OUTPUT_LAYER_SIZE;          // Default output size
+    struct Config config;
+    init_config(&config);
 
-    // Set default hidden layer sizes
-    int default_hidden_Sizes[] = HIDDEN_LAYER_SIZE;
-    memcpy(hidden_Sizes, default_hidden_Sizes, num_Hidden_Layers * sizeof(int));
+    // Arguments of the form --key=value override the config file, the others select it or the topology
+    char *positional[5];
+    int num_Positional = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strncmp(argv[i], "--", 2) != 0 && num_Positional < 5)
+        {
+            positional[num_Positional++] = argv[i];
+        }
+    }
 
-    if (argc == 2) // Case 1: Config file is passed
+    if (num_Positional == 1) // Case 1: Config file is passed
     {
-        const char *config_file = argv[1];
-        if (parse_config_file(config_file, &input_Size, hidden_Sizes, &num_Hidden_Layers, &output_Size))
+        const char *config_file = positional[0];
+        if (parse_config_file(config_file, &config))
         {
             fprintf(stdout, "Using network structure from config file: %s\n", config_file);
         }
@@ -51,29 +94,23 @@ int main(int argc, char **argv)
             fprintf(stderr, "Failed to parse config file: %s. Using default network structure.\n", config_file);
         }
     }
-    else if (argc >= 4) // Case 2: Command-line arguments are passed
+    else if (num_Positional >= 4) // Case 2: Command-line arguments are passed
     {
-        input_Size = atoi(argv[1]);
-        num_Hidden_Layers = atoi(argv[2]);
-
-        if (num_Hidden_Layers > MAX_HIDDEN_LAYERS)
-        {
-            fprintf(stderr, "Error: Number of hidden layers exceeds the maximum allowed (%d).\n", MAX_HIDDEN_LAYERS);
-            exit(EXIT_FAILURE);
-        }
+        config.input_Size = (int)parse_integer("input_size", positional[0], 1, INT_MAX);
+        config.num_Hidden_Layers = (int)parse_integer("num_hidden_layers", positional[1], 1, MAX_HIDDEN_LAYERS);
 
         // Parse hidden layer sizes, assumed to be comma-separated
-        char *token = strtok(argv[3], ",");
-        for (int i = 0; i < num_Hidden_Layers && token != NULL; i++)
+        char *token = strtok(positional[2], ",");
+        for (int i = 0; i < config.num_Hidden_Layers && token != NULL; i++)
         {
-            hidden_Sizes[i] = atoi(token);
+            config.hidden_Sizes[i] = (int)parse_integer("hidden_sizes", token, 1, INT_MAX);
             token = strtok(NULL, ",");
         }
 
-        output_Size = atoi(argv[4]);
+        config.output_Size = (int)parse_integer("output_size", positional[3], 1, INT_MAX);
         fprintf(stdout, "Using network structure from command-line arguments\n");
     }
-    else if (argc == 3) // Case: Not enough args
+    else if (num_Positional >= 2) // Case: Not enough args
     {
         fprintf(stdout, "Not enough arguments passed, using default configuration\n");
     }
@@ -82,50 +119,333 @@ int main(int argc, char **argv)
         fprintf(stdout, "No config file or arguments provided. Using default network structure.\n");
     }
 
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--", 2) != 0)
+        {
+            continue;
+        }
+        // --batch-size=64 and --batch_size=64 both set the config file key batch_size
+        char option[FILENAME_MAX + 64];
+        snprintf(option, sizeof(option), "%s", argv[i] + 2);
+        char *value = strchr(option, '=');
+        if (value == NULL)
+        {
+            fprintf(stderr, "Error: Option %s has no value, use --key=value\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        *value++ = '\0';
+        for (char *c = option; *c != '\0'; ++c)
+        {
+            if (*c == '-')
+            {
+                *c = '_';
+            }
+        }
+        if (!set_config_option(&config, option, value))
+        {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // The runtime settings apply before the first parallel region and kernel call
+    set_Log_Level(config.log_Level);
+    if (config.threads > 0)
+    {
+        omp_set_num_threads(config.threads);
+    }
+    if (config.cpu_Level[0] != '\0')
+    {
+#ifdef SIMD
+        enum Cpu_Level level;
+        if (!parse_Cpu_Level(config.cpu_Level, &level) || !set_Cpu_Level(level))
+        {
+            fprintf(stderr, "Error: Instruction set %s is unknown or not supported by this CPU\n", config.cpu_Level);
+            exit(EXIT_FAILURE);
+        }
+#else
+        fprintf(stderr, "Warning: cpu_level only selects the kernels of the SIMD versions, ignored\n");
+#endif
+    }
+
+    // Print which mode is chosen based on the compilation flag
+#if defined(SEQ)
+    fprintf(stdout, "Sequential Processing\n");
+    fprintf(stdout, "==============================\n");
+#elif defined(PARALLEL)
+    fprintf(stdout, "Parallel Processing - OMP (%d threads)\n", omp_get_max_threads());
+    fprintf(stdout, "==============================\n");
+#elif defined(SIMD) && defined(FLOAT32)
+    fprintf(stdout, "SIMD Processing - single precision (%s)\n", get_Cpu_Level_Name(get_Cpu_Level()));
+    fprintf(stdout, "==============================\n");
+#elif defined(SIMD)
+    fprintf(stdout, "SIMD Processing (%s)\n", get_Cpu_Level_Name(get_Cpu_Level()));
+    fprintf(stdout, "==============================\n");
+#endif
+
     srand(0); /* for weights random initialisation */
 
-    init_Network(&network, input_Size, hidden_Sizes, num_Hidden_Layers, output_Size);
+    if (config.load_Model[0] != '\0')
+    {
+        // The topology is taken from the model file
+        if (!load_Network(&network, config.load_Model, 1))
+        {
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stdout, "Loaded trained network from %s\n", config.load_Model);
+    }
+    else
+    {
+        init_Network(&network, config.input_Size, config.hidden_Sizes, config.num_Hidden_Layers, config.output_Size);
+        if (!set_Network_Activations(&network, config.hidden_Activation, config.output_Activation))
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
     print_network_structure(&network);
-    fprintf(stdout, "Epochs = %d\nLearning Rate = %f\nBatch Size = %d\n", EPOCHS, L_RATE, BATCH_SIZE);
-    fprintf(stdout, "Stopping Training after %d epochs without improvement\n", EARLY_STOPPING_PATIENCE);
+    if (SPECIALIZED)
+    {
+        fprintf(stdout, "Kernels specialized for %s: %s\n", get_Specialized_Topology(),
+                is_Specialized_Network(&network) ? "used" : "not used, the topology differs");
+    }
+    fprintf(stdout, "Epochs = %d\nLearning Rate = %f\nBatch Size = %d\nOptimizer = %s\n", config.training.epochs,
+            config.training.learning_rate, config.training.batch_Size, get_Optimizer_Name(config.optimizer));
+    fprintf(stdout, "Stopping Training after %d epochs without improvement\n", config.training.patience);
     fprintf(stdout, "==============================\n");
 
 
     // Prepare dataset
-    struct Data train_data = parse_MNIST_CSV_and_normalize(TRAIN_CSV, MAX_ROWS_TRAIN, 10);
-    struct Data test_data = parse_MNIST_CSV_and_normalize(TEST_CSV, MAX_ROWS_TEST, 10);
+    struct Data train_data = {0}; // not needed for a loaded network
+    if (config.load_Model[0] == '\0')
+    {
+        train_data = load_dataset(config.train_Images, config.train_Labels, config.train_Csv, MAX_ROWS_TRAIN);
+    }
+    struct Data test_data = load_dataset(config.test_Images, config.test_Labels, config.test_Csv, MAX_ROWS_TEST);
 
-    if (LOG >= 2)
+    if (get_Log_Level() >= 2)
     {
         fprintf(stdout, "Printing weights before training\n");
         print_weights(&network);
     }
 
     fprintf(stdout, "==============================\n");
-    fprintf(stdout, "Starting to train\n");
-    training(&network, EPOCHS, L_RATE, train_data.values, train_data.labels, MAX_ROWS_TRAIN);
-    fprintf(stdout, "==============================\n");
+    if (config.load_Model[0] == '\0')
+    {
+        set_Network_Optimizer(&network, config.optimizer);
+        fprintf(stdout, "Starting to train\n");
+        if (training(&network, &config.training, &train_data, train_data.num_Rows) < 0)
+        {
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stdout, "==============================\n");
+    }
+
+    if (config.save_Model[0] != '\0' && save_Network(&network, config.save_Model))
+    {
+        fprintf(stdout, "Saved trained network to %s\n", config.save_Model);
+    }
 
-    if (LOG >= 2)
+    if (get_Log_Level() >= 2)
     {
         fprintf(stdout, "Printing weights after training\n");
         print_weights(&network);
     }
 
     fprintf(stdout, "==============================\n");
-    calculate_accuracy(&network, test_data.values, test_data.labels);
+    if (calculate_accuracy(&network, &test_data, test_data.num_Rows, NULL) < 0.0)
+    {
+        exit(EXIT_FAILURE);
+    }
     fprintf(stdout, "==============================\n");
 
     // Free allocated memory
-    free_Data(&train_data, MAX_ROWS_TRAIN);
-    free_Data(&test_data, MAX_ROWS_TEST);
+    free_Data(&train_data);
+    free_Data(&test_data);
     free_Network(&network);
+    if (INSTRUMENT)
+    {
+        free_Instrument();
+    }
 
     return 0;
 }
 
 /* --------------------------------------------------- */
-int parse_config_file(const char *config_file, int *input_Size, int *hidden_Sizes, int *num_Hidden_Layers, int *output_Size)
+void init_config(struct Config *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->input_Size = INPUT_LAYER_SIZE;
+    config->num_Hidden_Layers = NUMBER_HIDDEN_LAYERS;
+    int default_hidden_Sizes[] = HIDDEN_LAYER_SIZE;
+    memcpy(config->hidden_Sizes, default_hidden_Sizes, sizeof(default_hidden_Sizes));
+    config->output_Size = OUTPUT_LAYER_SIZE;
+    config->hidden_Activation = HIDDEN_ACTIVATION;
+    config->output_Activation = OUTPUT_ACTIVATION;
+    config->optimizer = OPTIMIZER;
+    init_Training_Config(&config->training);
+    config->log_Level = LOG;
+    snprintf(config->train_Images, FILENAME_MAX, "%s", TRAIN_IMAGES);
+    snprintf(config->train_Labels, FILENAME_MAX, "%s", TRAIN_LABELS);
+    snprintf(config->train_Csv, FILENAME_MAX, "%s", TRAIN_CSV);
+    snprintf(config->test_Images, FILENAME_MAX, "%s", TEST_IMAGES);
+    snprintf(config->test_Labels, FILENAME_MAX, "%s", TEST_LABELS);
+    snprintf(config->test_Csv, FILENAME_MAX, "%s", TEST_CSV);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Parse the integer value of a key, exits if it is not one or outside of minimum .. maximum
+ */
+static long parse_integer(const char *key, const char *value, long minimum, long maximum)
+{
+    char *end;
+    errno = 0;
+    long number = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || number < minimum || number > maximum)
+    {
+        fprintf(stderr, "Error: %s has to be an integer from %ld to %ld, got %s\n", key, minimum, maximum, value);
+        exit(EXIT_FAILURE);
+    }
+    return number;
+}
+
+/* --------------------------------------------------- */
+int set_config_option(struct Config *config, const char *key, char *value)
+{
+    if (strcmp(key, "input_size") == 0)
+    {
+        config->input_Size = (int)parse_integer(key, value, 1, INT_MAX);
+    }
+    else if (strcmp(key, "hidden_sizes") == 0)
+    {
+        char *token = strtok(value, ",");
+        int i = 0;
+        while (token != NULL)
+        {
+            if (i >= MAX_HIDDEN_LAYERS)
+            {
+                fprintf(stderr, "Error: Config file defines more hidden layers than the maximum allowed (%d).\n", MAX_HIDDEN_LAYERS);
+                exit(EXIT_FAILURE);
+            }
+            config->hidden_Sizes[i++] = (int)parse_integer(key, token, 1, INT_MAX);
+            token = strtok(NULL, ",");
+        }
+        config->num_Hidden_Layers = i; // Update the number of hidden layers based on the count
+    }
+
+    else if (strcmp(key, "num_hidden_layers") == 0)
+    {
+        config->num_Hidden_Layers = (int)parse_integer(key, value, 1, MAX_HIDDEN_LAYERS);
+    }
+    else if (strcmp(key, "output_size") == 0)
+    {
+        config->output_Size = (int)parse_integer(key, value, 1, INT_MAX);
+    }
+    else if (strcmp(key, "hidden_activation") == 0 || strcmp(key, "output_activation") == 0)
+    {
+        enum Activation *activation = (strcmp(key, "hidden_activation") == 0) ? &config->hidden_Activation : &config->output_Activation;
+        if (!parse_Activation(value, activation))
+        {
+            fprintf(stderr, "Error: Unknown activation function in config file: %s\n", value);
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (strcmp(key, "optimizer") == 0)
+    {
+        if (!parse_Optimizer(value, &config->optimizer))
+        {
+            fprintf(stderr, "Error: Unknown optimizer in config file: %s\n", value);
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (strcmp(key, "epochs") == 0)
+    {
+        config->training.epochs = (int)parse_integer(key, value, 0, INT_MAX);
+    }
+    else if (strcmp(key, "learning_rate") == 0)
+    {
+        char *end;
+        config->training.learning_rate = strtod(value, &end);
+        if (end == value || *end != '\0' || !(config->training.learning_rate > 0.0))
+        {
+            fprintf(stderr, "Error: learning_rate has to be a positive number, got %s\n", value);
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (strcmp(key, "batch_size") == 0)
+    {
+        config->training.batch_Size = (int)parse_integer(key, value, 1, INT_MAX);
+    }
+    else if (strcmp(key, "patience") == 0)
+    {
+        config->training.patience = (int)parse_integer(key, value, 0, INT_MAX);
+    }
+    else if (strcmp(key, "shuffle") == 0)
+    {
+        config->training.shuffle = parse_integer(key, value, 0, INT_MAX) != 0;
+    }
+    else if (strcmp(key, "seed") == 0)
+    {
+        config->training.seed = (uint64_t)parse_integer(key, value, 0, LONG_MAX);
+    }
+    else if (strcmp(key, "pipeline_slots") == 0)
+    {
+        config->training.pipeline_Slots = (int)parse_integer(key, value, 0, INT_MAX);
+    }
+    else if (strcmp(key, "log") == 0)
+    {
+        config->log_Level = (int)parse_integer(key, value, 0, INT_MAX);
+    }
+    else if (strcmp(key, "threads") == 0)
+    {
+        config->threads = (int)parse_integer(key, value, 0, INT_MAX);
+    }
+    else if (strcmp(key, "cpu_level") == 0)
+    {
+        snprintf(config->cpu_Level, sizeof(config->cpu_Level), "%s", value);
+    }
+    else if (strcmp(key, "save_model") == 0)
+    {
+        snprintf(config->save_Model, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "load_model") == 0)
+    {
+        snprintf(config->load_Model, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "train_images") == 0)
+    {
+        snprintf(config->train_Images, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "train_labels") == 0)
+    {
+        snprintf(config->train_Labels, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "train_csv") == 0)
+    {
+        snprintf(config->train_Csv, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "test_images") == 0)
+    {
+        snprintf(config->test_Images, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "test_labels") == 0)
+    {
+        snprintf(config->test_Labels, FILENAME_MAX, "%s", value);
+    }
+    else if (strcmp(key, "test_csv") == 0)
+    {
+        snprintf(config->test_Csv, FILENAME_MAX, "%s", value);
+    }
+    else
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+int parse_config_file(const char *config_file, struct Config *config)
 {
     FILE *file = fopen(config_file, "r");
     if (file == NULL)
@@ -134,7 +454,7 @@ int parse_config_file(const char *config_file, int *input_Size, int *hidden_Size
         return 0;
     }
 
-    char line[256];
+    char line[FILENAME_MAX + 64];
     while (fgets(line, sizeof(line), file))
     {
         // Remove any trailing newline character
@@ -161,36 +481,7 @@ int parse_config_file(const char *config_file, int *input_Size, int *hidden_Size
             *(end_value + 1) = '\0';
 
             // Process the key-value pairs
-            if (strcmp(key, "input_size") == 0)
-            {
-                *input_Size = atoi(value);
-            }
-            else if (strcmp(key, "hidden_sizes") == 0)
-            {
-                char *token = strtok(value, ",");
-                int i = 0;
-                while (token != NULL)
-                {
-                    if (i >= MAX_HIDDEN_LAYERS)
-                    {
-                        fprintf(stderr, "Error: Config file defines more hidden layers than the maximum allowed (%d).\n", MAX_HIDDEN_LAYERS);
-                        exit(EXIT_FAILURE);
-                    }
-                    hidden_Sizes[i++] = atoi(token);
-                    token = strtok(NULL, ",");
-                }
-                *num_Hidden_Layers = i; // Update the number of hidden layers based on the count
-            }
-
-            else if (strcmp(key, "num_hidden_layers") == 0)
-            {
-                *num_Hidden_Layers = atoi(value);
-            }
-            else if (strcmp(key, "output_size") == 0)
-            {
-                *output_Size = atoi(value);
-            }
-            else
+            if (!set_config_option(config, key, value))
             {
                 fprintf(stderr, "Warning: Unknown key in config file: %s\n", key);
             }
@@ -200,6 +491,98 @@ int parse_config_file(const char *config_file, int *input_Size, int *hidden_Size
     fclose(file);
     return 1; // Return 1 to indicate success
 }
+
+/* --------------------------------------------------- */
+void print_usage(const char *program)
+{
+    fprintf(stdout, "Usage: %s [config file | input_size num_hidden_layers hidden_sizes output_size] [--key=value ...]\n", program);
+    fprintf(stdout, "Every key of the config file can also be given as --key=value, which overrides the config file:\n");
+    fprintf(stdout, "  input_size, hidden_sizes (e.g. 128,64), num_hidden_layers, output_size\n");
+    fprintf(stdout, "  hidden_activation, output_activation   sigmoid, relu, leaky_relu, tanh, softmax (output only)\n");
+    fprintf(stdout, "  optimizer                              sgd, momentum, rmsprop, adam\n");
+    fprintf(stdout, "  epochs (%d), learning_rate (%g), batch_size (%d), patience (%d)\n", EPOCHS, L_RATE, BATCH_SIZE,
+            EARLY_STOPPING_PATIENCE);
+    fprintf(stdout, "  shuffle (%d), seed (%d), pipeline_slots (%d), log (%d)\n", SHUFFLE, SHUFFLE_SEED, PIPELINE_SLOTS, LOG);
+    fprintf(stdout, "  threads                                OpenMP threads of the parallel version, 0 for the OpenMP default\n");
+    fprintf(stdout, "  cpu_level                              sse2, avx2 or avx512 kernels of the SIMD versions\n");
+    fprintf(stdout, "  save_model, load_model                 model file written after training / evaluated instead\n");
+    fprintf(stdout, "  train_images, train_labels, train_csv, test_images, test_labels, test_csv   data set files\n");
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Copy a file name without its ".gz" suffix, names without one are copied unchanged
+ */
+static void strip_gz_suffix(const char *filename, char *plain)
+{
+    size_t length = strlen(filename);
+    if (length > strlen(".gz") && strcmp(filename + length - strlen(".gz"), ".gz") == 0)
+    {
+        length -= strlen(".gz");
+    }
+    snprintf(plain, FILENAME_MAX, "%.*s", (int)length, filename);
+}
+
+/* --------------------------------------------------- */
+struct Data load_dataset(const char *images_file, const char *labels_file, const char *csv_file, int num_rows)
+{
+    // Prefer the decompressed IDX files, then the gzip compressed ones as shipped, then the CSV export
+    char images_plain[FILENAME_MAX], labels_plain[FILENAME_MAX];
+    strip_gz_suffix(images_file, images_plain);
+    strip_gz_suffix(labels_file, labels_plain);
+
+    const char *sources[2];
+    int num_sources = 2;
+    // files that are there but not valid IDX files are skipped, an error message says why
+    if (access(images_plain, R_OK) == 0 && access(labels_plain, R_OK) == 0 && check_MNIST_IDX(images_plain, labels_plain))
+    {
+        sources[0] = images_plain;
+        sources[1] = labels_plain;
+    }
+    else if ((strcmp(images_file, images_plain) != 0 || strcmp(labels_file, labels_plain) != 0) &&
+             access(images_file, R_OK) == 0 && access(labels_file, R_OK) == 0 && check_MNIST_IDX(images_file, labels_file))
+    {
+        sources[0] = images_file;
+        sources[1] = labels_file;
+    }
+    else
+    {
+        sources[0] = csv_file;
+        num_sources = 1;
+    }
+
+    // Reuse the parsed dataset of an earlier run as long as the sources are unchanged
+    char cache_file[sizeof(images_plain) + sizeof(".cache")];
+    snprintf(cache_file, sizeof(cache_file), "%s.cache", sources[0]);
+    struct Data dataset;
+    if (load_Data_Cache(cache_file, sources, num_sources, num_rows, 10, NORM_MAX, NORM_MIN, &dataset))
+    {
+        fprintf(stdout, "Mapped %s\n", cache_file);
+        return dataset;
+    }
+
+    fprintf(stdout, "Loading %s\n", sources[0]);
+    if (num_sources == 2)
+    {
+        dataset = parse_MNIST_IDX(sources[0], sources[1], num_rows, 10);
+    }
+    else
+    {
+        dataset = parse_MNIST_CSV(sources[0], num_rows, 10);
+    }
+    if (dataset.num_Rows == 0)
+    {
+        fprintf(stderr, "Error: %s holds no samples\n", sources[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (dataset.num_Rows < num_rows)
+    {
+        fprintf(stdout, "%s holds only %d samples\n", sources[0], dataset.num_Rows);
+    }
+    write_Data_Cache(cache_file, sources, num_sources, &dataset, num_rows);
+    return dataset;
+}
+
 /* --------------------------------------------------- */
 void print_network_structure(struct Network *network)
 {
@@ -208,7 +591,9 @@ void print_network_structure(struct Network *network)
     fprintf(stdout, "%d Hidden Layers\n", network->num_Hidden_Layers);
     for (int i = 0; i < network->num_Hidden_Layers; i++)
     {
-        fprintf(stdout, "Hidden Layer Nr %d has %d Neurons\n", i + 1, network->hidden_Layer[i].num_Neurons);
+        fprintf(stdout, "Hidden Layer Nr %d has %d Neurons (%s)\n", i + 1, network->hidden_Layer[i].num_Neurons,
+                get_Activation_Name(network->hidden_Layer[i].activation));
     }
+    fprintf(stdout, "Output Layer activation: %s\n", get_Activation_Name(network->output_Layer.activation));
 }
 /* -------------------- EOF -------------------------- */
\ No newline at end of file
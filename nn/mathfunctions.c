@@ -5,18 +5,396 @@
 
 /* Includes ------------------------------------------ */
 #include "mathfunctions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <omp.h>
+#include <pthread.h>
 #include <immintrin.h>
 
 /* --------------------------------------------------- */
-double sigmoid(double x){
-    return (1/(1+ exp(-x)));
+real sigmoid(real x){
+    return (1/(1+ REAL_EXP(-x)));
 }
 
 /* --------------------------------------------------- */
-double d_sigmoid(double x){
-    double s = sigmoid(x);
-    return s * (1.0 - s);
+real d_sigmoid(real x){
+    real s = sigmoid(x);
+    return s * (1 - s);
+}
+
+/* --------------------------------------------------- */
+int get_max_index(const real *values, int size){
+    int max_index = 0;
+    for (int i = 1; i < size; ++i) {
+        if (values[i] > values[max_index]) {
+            max_index = i;
+        }
+    }
+    return max_index;
+}
+
+/* --------------------------------------------------- */
+/*
+ * activation_vec() replaces the libm exp() by a polynomial that the compiler vectorizes:
+ * x = n * ln2 + r with |r| <= ln2 / 2, so exp(x) = 2^n * exp(r). Adding EXP_SHIFTER
+ * rounds x / ln2 to the integer n in the low mantissa bits, 2^n is then assembled
+ * directly in the exponent field and exp(r) is a Taylor polynomial of EXP_DEGREE.
+ */
+#ifdef FLOAT32
+typedef uint32_t real_bits;
+#define EXP_SHIFTER         12582912.0f             // 1.5 * 2^23
+#define EXP_MANTISSA_BITS   23
+#define EXP_BIAS            127
+#define EXP_DEGREE          7
+#else
+typedef uint64_t real_bits;
+#define EXP_SHIFTER         6755399441055744.0      // 1.5 * 2^52
+#define EXP_MANTISSA_BITS   52
+#define EXP_BIAS            1023
+#define EXP_DEGREE          12
+#endif
+#define LOG2_E              1.4426950408889634
+#define LN2_HI              0.693145751953125       // ln2 split in two parts, n * LN2_HI is exact
+#define LN2_LO              1.4286068203094172e-06
+#define SIGMOID_CLAMP       40.0                    // sigmoid() rounds to 0 or 1 beyond, exp() stays finite
+#define SOFTMAX_CLAMP       80.0                    // exp(-80) is still a normal float
+
+/* 1 / k! for k = 0 .. 12 */
+static const real exp_coefficients[] = {
+    1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+    1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600
+};
+
+/**
+ * @brief exp() for |x| <= SOFTMAX_CLAMP without any branch or library call
+ */
+static inline __attribute__((always_inline)) real fast_exp(real x)
+{
+    real t = x * (real)LOG2_E + EXP_SHIFTER;
+    real_bits n_bits;
+    memcpy(&n_bits, &t, sizeof(t));
+    real n = t - EXP_SHIFTER;
+    real r = (x - n * (real)LN2_HI) - n * (real)LN2_LO;
+
+    real p = exp_coefficients[EXP_DEGREE];
+    // fully unrolled, a loop inside the loop of the caller keeps it from being vectorized
+    #pragma GCC unroll 16
+    for (int k = EXP_DEGREE - 1; k >= 0; --k) {
+        p = p * r + exp_coefficients[k];
+    }
+
+    // the low bits of n_bits hold n, the shift drops the exponent of the shifter
+    real_bits scale_bits = (n_bits + EXP_BIAS) << EXP_MANTISSA_BITS;
+    real scale;
+    memcpy(&scale, &scale_bits, sizeof(scale));
+    return p * scale;
+}
+
+/**
+ * @brief Weighted sum plus bias, the bias is skipped if there is none
+ */
+static inline __attribute__((always_inline)) real biased(const real *x, const real *biases, int i)
+{
+    return (biases != NULL) ? x[i] + biases[i] : x[i];
+}
+
+/**
+ * @brief Clamp biased values into [low, high]
+ *
+ * In a loop of its own: inside the exp loop the compiler resolves the clamped
+ * cases into branches with constant results and gives up vectorizing.
+ */
+static inline __attribute__((always_inline)) void clamp_loop(const real *x, const real *biases, real *y, int size, real low, real high)
+{
+    for (int i = 0; i < size; ++i) {
+        real v = biased(x, biases, i);
+        v = (v < low) ? low : v;
+        y[i] = (v > high) ? high : v;
+    }
+}
+
+static inline __attribute__((always_inline)) void softmax_loop(const real *x, const real *biases, real *y, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        y[i] = biased(x, biases, i);
+    }
+    // exp(x - max) cannot overflow, the clamp keeps fast_exp() away from denormals
+    real max = y[get_max_index(y, size)];
+    for (int i = 0; i < size; ++i) {
+        y[i] -= max;
+    }
+    clamp_loop(y, NULL, y, size, -SOFTMAX_CLAMP, 0.0);
+    for (int i = 0; i < size; ++i) {
+        y[i] = fast_exp(y[i]);
+    }
+    real sum = 0.0;
+    for (int i = 0; i < size; ++i) {
+        sum += y[i];
+    }
+    real scale = 1 / sum;
+    for (int i = 0; i < size; ++i) {
+        y[i] *= scale;
+    }
+}
+
+static inline __attribute__((always_inline)) void activation_vec_body(enum Activation activation, const real *x, const real *biases,
+                                                                      real *y, int size)
+{
+    switch (activation) {
+        case ACTIVATION_RELU:
+            for (int i = 0; i < size; ++i) {
+                real v = biased(x, biases, i);
+                y[i] = (v > 0) ? v : 0;
+            }
+            break;
+        case ACTIVATION_LEAKY_RELU:
+            for (int i = 0; i < size; ++i) {
+                // max(x, slope * x) for a slope below 1. A select between x and slope * x does not
+                // vectorize, the compiler may not evaluate the product the select would skip
+                real v = biased(x, biases, i);
+                real scaled = (real)LEAKY_RELU_SLOPE * v;
+                y[i] = (v > scaled) ? v : scaled;
+            }
+            break;
+        case ACTIVATION_TANH:
+            // tanh(x) = 2 * sigmoid(2x) - 1
+            clamp_loop(x, biases, y, size, -SIGMOID_CLAMP / 2, SIGMOID_CLAMP / 2);
+            for (int i = 0; i < size; ++i) {
+                y[i] = 2 / (1 + fast_exp(-2 * y[i])) - 1;
+            }
+            break;
+        case ACTIVATION_SOFTMAX:
+            softmax_loop(x, biases, y, size);
+            break;
+        default:
+            clamp_loop(x, biases, y, size, -SIGMOID_CLAMP, SIGMOID_CLAMP);
+            for (int i = 0; i < size; ++i) {
+                y[i] = 1 / (1 + fast_exp(-y[i]));
+            }
+            break;
+    }
+}
+
+static inline __attribute__((always_inline)) void activation_vec_loop(enum Activation activation, const real *x, const real *biases,
+                                                                      real *y, int size)
+{
+    // one instance with and one without biases, so no loop has to test for them
+    if (biases == NULL) {
+        activation_vec_body(activation, x, NULL, y, size);
+    } else {
+        activation_vec_body(activation, x, biases, y, size);
+    }
+}
+
+static inline __attribute__((always_inline)) void d_activation_vec_loop(enum Activation activation, const real *outputs, real *errors, int size)
+{
+    // every derivative is expressed through the outputs, the sign of an output is the sign of its input
+    switch (activation) {
+        case ACTIVATION_RELU:
+            for (int i = 0; i < size; ++i) {
+                errors[i] = (outputs[i] > 0) ? errors[i] : 0;
+            }
+            break;
+        case ACTIVATION_LEAKY_RELU:
+            for (int i = 0; i < size; ++i) {
+                real positive = (outputs[i] > 0) ? 1 : 0;
+                errors[i] *= (real)LEAKY_RELU_SLOPE + (1 - (real)LEAKY_RELU_SLOPE) * positive;
+            }
+            break;
+        case ACTIVATION_TANH:
+            for (int i = 0; i < size; ++i) {
+                errors[i] *= 1 - outputs[i] * outputs[i];
+            }
+            break;
+        case ACTIVATION_SOFTMAX:
+            // fused with the cross-entropy loss, target - output already is the error
+            break;
+        default:
+            for (int i = 0; i < size; ++i) {
+                errors[i] *= outputs[i] * (1 - outputs[i]);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief One update of parameters from their gradients, gradient i is scale * gradients[i]
+ *
+ * The gradients point in the direction of smaller errors, so they are added to the parameters.
+ */
+static inline __attribute__((always_inline)) void optimizer_update_loop(const struct Optimizer_Step *step, real *params,
+                                                                        real *first_Moments, real *second_Moments,
+                                                                        const real *gradients, real scale, int size)
+{
+    const real learning_rate = step->learning_rate;
+    const real epsilon = step->epsilon;
+    switch (step->optimizer) {
+        case OPTIMIZER_MOMENTUM:
+            for (int i = 0; i < size; ++i) {
+                real velocity = (real)MOMENTUM * first_Moments[i] + scale * gradients[i];
+                first_Moments[i] = velocity;
+                params[i] += learning_rate * velocity;
+            }
+            break;
+        case OPTIMIZER_RMSPROP:
+            for (int i = 0; i < size; ++i) {
+                real gradient = scale * gradients[i];
+                real mean_Square = (real)RMSPROP_DECAY * second_Moments[i] + (1 - (real)RMSPROP_DECAY) * gradient * gradient;
+                second_Moments[i] = mean_Square;
+                params[i] += learning_rate * gradient / (REAL_SQRT(mean_Square) + epsilon);
+            }
+            break;
+        case OPTIMIZER_ADAM:
+            for (int i = 0; i < size; ++i) {
+                real gradient = scale * gradients[i];
+                real mean = (real)ADAM_BETA1 * first_Moments[i] + (1 - (real)ADAM_BETA1) * gradient;
+                real mean_Square = (real)ADAM_BETA2 * second_Moments[i] + (1 - (real)ADAM_BETA2) * gradient * gradient;
+                first_Moments[i] = mean;
+                second_Moments[i] = mean_Square;
+                params[i] += learning_rate * mean / (REAL_SQRT(mean_Square) + epsilon);
+            }
+            break;
+        default:
+            for (int i = 0; i < size; ++i) {
+                params[i] += learning_rate * scale * gradients[i];
+            }
+            break;
+    }
+}
+
+#if defined(SIMD)
+/* Compiled for every instruction set level, selected together with dotp() */
+static void activation_vec_sse2(enum Activation activation, const real *x, const real *biases, real *y, int size)
+{
+    activation_vec_loop(activation, x, biases, y, size);
+}
+static __attribute__((target("avx2,fma"))) void activation_vec_avx2(enum Activation activation, const real *x, const real *biases, real *y, int size)
+{
+    activation_vec_loop(activation, x, biases, y, size);
+}
+static __attribute__((target("avx512f"))) void activation_vec_avx512(enum Activation activation, const real *x, const real *biases, real *y, int size)
+{
+    activation_vec_loop(activation, x, biases, y, size);
+}
+static void d_activation_vec_sse2(enum Activation activation, const real *outputs, real *errors, int size)
+{
+    d_activation_vec_loop(activation, outputs, errors, size);
+}
+static __attribute__((target("avx2,fma"))) void d_activation_vec_avx2(enum Activation activation, const real *outputs, real *errors, int size)
+{
+    d_activation_vec_loop(activation, outputs, errors, size);
+}
+static __attribute__((target("avx512f"))) void d_activation_vec_avx512(enum Activation activation, const real *outputs, real *errors, int size)
+{
+    d_activation_vec_loop(activation, outputs, errors, size);
+}
+
+static void optimizer_update_vec_sse2(const struct Optimizer_Step *step, real *params, real *first_Moments,
+                                      real *second_Moments, const real *gradients, real scale, int size)
+{
+    optimizer_update_loop(step, params, first_Moments, second_Moments, gradients, scale, size);
+}
+static __attribute__((target("avx2,fma"))) void optimizer_update_vec_avx2(const struct Optimizer_Step *step, real *params, real *first_Moments,
+                                                                          real *second_Moments, const real *gradients, real scale, int size)
+{
+    optimizer_update_loop(step, params, first_Moments, second_Moments, gradients, scale, size);
+}
+static __attribute__((target("avx512f"))) void optimizer_update_vec_avx512(const struct Optimizer_Step *step, real *params, real *first_Moments,
+                                                                           real *second_Moments, const real *gradients, real scale, int size)
+{
+    optimizer_update_loop(step, params, first_Moments, second_Moments, gradients, scale, size);
+}
+
+static void (*activation_vec_kernel)(enum Activation activation, const real *x, const real *biases, real *y, int size) = activation_vec_sse2;
+static void (*d_activation_vec_kernel)(enum Activation activation, const real *outputs, real *errors, int size) = d_activation_vec_sse2;
+static void (*optimizer_update_vec_kernel)(const struct Optimizer_Step *step, real *params, real *first_Moments,
+                                           real *second_Moments, const real *gradients, real scale, int size) = optimizer_update_vec_sse2;
+
+void activation_vec(enum Activation activation, const real *x, const real *biases, real *y, int size){
+    activation_vec_kernel(activation, x, biases, y, size);
+}
+
+void d_activation_vec(enum Activation activation, const real *outputs, real *errors, int size){
+    d_activation_vec_kernel(activation, outputs, errors, size);
+}
+
+void optimizer_update_vec(const struct Optimizer_Step *step, real *params, real *first_Moments, real *second_Moments,
+                          const real *gradients, real scale, int size){
+    optimizer_update_vec_kernel(step, params, first_Moments, second_Moments, gradients, scale, size);
+}
+#else
+void activation_vec(enum Activation activation, const real *x, const real *biases, real *y, int size){
+    activation_vec_loop(activation, x, biases, y, size);
+}
+
+void d_activation_vec(enum Activation activation, const real *outputs, real *errors, int size){
+    d_activation_vec_loop(activation, outputs, errors, size);
+}
+
+void optimizer_update_vec(const struct Optimizer_Step *step, real *params, real *first_Moments, real *second_Moments,
+                          const real *gradients, real scale, int size){
+    optimizer_update_loop(step, params, first_Moments, second_Moments, gradients, scale, size);
+}
+#endif
+
+/* --------------------------------------------------- */
+void sigmoid_vec(const real *x, real *y, int size){
+    activation_vec(ACTIVATION_SIGMOID, x, NULL, y, size);
+}
+
+/* --------------------------------------------------- */
+void d_sigmoid_vec(const real *outputs, real *errors, int size){
+    d_activation_vec(ACTIVATION_SIGMOID, outputs, errors, size);
+}
+
+/* --------------------------------------------------- */
+static const char *activation_names[NUM_ACTIVATIONS] = {"sigmoid", "relu", "leaky_relu", "tanh", "softmax"};
+
+const char *get_Activation_Name(enum Activation activation){
+    return (activation >= 0 && activation < NUM_ACTIVATIONS) ? activation_names[activation] : "unknown";
+}
+
+/* --------------------------------------------------- */
+int parse_Activation(const char *name, enum Activation *activation){
+    for (int a = 0; a < NUM_ACTIVATIONS; ++a) {
+        if (strcmp(name, activation_names[a]) == 0) {
+            *activation = (enum Activation)a;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* --------------------------------------------------- */
+struct Optimizer_Step get_Optimizer_Step(enum Optimizer optimizer, real learning_rate, long step){
+    struct Optimizer_Step result = {optimizer, learning_rate, (real)OPTIMIZER_EPSILON};
+    if (optimizer == OPTIMIZER_ADAM){
+        // Bias corrections of the zero initialized moments, folded into the step size and epsilon
+        double correction1 = 1.0 - pow(ADAM_BETA1, (double)step);
+        double correction2 = sqrt(1.0 - pow(ADAM_BETA2, (double)step));
+        result.learning_rate = (real)(learning_rate * correction2 / correction1);
+        result.epsilon = (real)(OPTIMIZER_EPSILON * correction2);
+    }
+    return result;
+}
+
+/* --------------------------------------------------- */
+static const char *optimizer_names[NUM_OPTIMIZERS] = {"sgd", "momentum", "rmsprop", "adam"};
+
+const char *get_Optimizer_Name(enum Optimizer optimizer){
+    return (optimizer >= 0 && optimizer < NUM_OPTIMIZERS) ? optimizer_names[optimizer] : "unknown";
+}
+
+/* --------------------------------------------------- */
+int parse_Optimizer(const char *name, enum Optimizer *optimizer){
+    for (int o = 0; o < NUM_OPTIMIZERS; ++o) {
+        if (strcmp(name, optimizer_names[o]) == 0) {
+            *optimizer = (enum Optimizer)o;
+            return 1;
+        }
+    }
+    return 0;
 }
 
 // Default to SEQ if no flag is defined
@@ -25,8 +403,8 @@ double d_sigmoid(double x){
 #endif
 
 #if defined(SEQ)  // Sequential version
-double dotp(const double *a, const double *b, int size) {
-    double sum = 0.0;
+real dotp(const real *a, const real *b, int size) {
+    real sum = 0.0;
     for (int i = 0; i < size; ++i) {
         sum += a[i] * b[i];
     }
@@ -34,45 +412,528 @@ double dotp(const double *a, const double *b, int size) {
 }
 
 #elif defined(PARALLEL)  // OpenMP parallel version
-double dotp(const double *a, const double *b, int size) {
-    double sum = 0.0;
-      #pragma omp parallel for reduction(+:sum)
+/* The threads are distributed by the training loop, one dot product is too small to share */
+real dotp(const real *a, const real *b, int size) {
+    real sum = 0.0;
+    #pragma omp simd reduction(+:sum)
     for (int i = 0; i < size; ++i) {
         sum += a[i] * b[i];
     }
     return sum;
 }
 
-#elif defined(SIMD)  // SIMD version with AVX instructions
-double dotp(const double *a, const double *b, int size) {
-    __m256d sum = _mm256_setzero_pd();  // accumulator for partial sums
+#elif defined(SIMD)  // SIMD versions, the widest instruction set of the CPU is selected at startup
+/*
+ * The SIMD build runs on every x86-64 CPU: the translation units are compiled for the
+ * SSE2 baseline and only the kernels below are compiled for wider instruction sets
+ * through target attributes. init_Cpu_Dispatch() checks cpuid once before main()
+ * and points the kernel pointers at the widest version the CPU supports.
+ * The VEC* macros map the intrinsics of each register width to the precision of real.
+ */
+#ifdef FLOAT32
+#define LANES128        4
+#define VEC128          __m128
+#define SETZERO128      _mm_setzero_ps
+#define LOADU128        _mm_loadu_ps
+#define STOREU128       _mm_storeu_ps
+#define ADD128          _mm_add_ps
+#define MUL128          _mm_mul_ps
+#define LANES256        8
+#define VEC256          __m256
+#define SETZERO256      _mm256_setzero_ps
+#define LOAD256         _mm256_load_ps
+#define LOADU256        _mm256_loadu_ps
+#define STOREU256       _mm256_storeu_ps
+#define ADD256          _mm256_add_ps
+#define FMADD256        _mm256_fmadd_ps
+#define BROADCAST256    _mm256_broadcast_ss
+#define LANES512        16
+#define VEC512          __m512
+#define SETZERO512      _mm512_setzero_ps
+#define LOAD512         _mm512_load_ps
+#define LOADU512        _mm512_loadu_ps
+#define STOREU512       _mm512_storeu_ps
+#define ADD512          _mm512_add_ps
+#define FMADD512        _mm512_fmadd_ps
+#define SET1_512        _mm512_set1_ps
+#else
+#define LANES128        2
+#define VEC128          __m128d
+#define SETZERO128      _mm_setzero_pd
+#define LOADU128        _mm_loadu_pd
+#define STOREU128       _mm_storeu_pd
+#define ADD128          _mm_add_pd
+#define MUL128          _mm_mul_pd
+#define LANES256        4
+#define VEC256          __m256d
+#define SETZERO256      _mm256_setzero_pd
+#define LOAD256         _mm256_load_pd
+#define LOADU256        _mm256_loadu_pd
+#define STOREU256       _mm256_storeu_pd
+#define ADD256          _mm256_add_pd
+#define FMADD256        _mm256_fmadd_pd
+#define BROADCAST256    _mm256_broadcast_sd
+#define LANES512        8
+#define VEC512          __m512d
+#define SETZERO512      _mm512_setzero_pd
+#define LOAD512         _mm512_load_pd
+#define LOADU512        _mm512_loadu_pd
+#define STOREU512       _mm512_storeu_pd
+#define ADD512          _mm512_add_pd
+#define FMADD512        _mm512_fmadd_pd
+#define SET1_512        _mm512_set1_pd
+#endif
+
+/**
+ * @brief Add up the lanes of a stored register and the remaining elements of the vectors
+ */
+static inline real dotp_finish(const real *sums, int lanes, const real *a, const real *b, int i, int size)
+{
+    real final_sum = 0.0;
+    for (int l = 0; l < lanes; ++l) {
+        final_sum += sums[l];
+    }
+    for (; i < size; ++i) {
+        final_sum += a[i] * b[i];
+    }
+    return final_sum;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Scalar product with SSE2 instructions, available on every x86-64 CPU
+ */
+static real dotp_sse2(const real *a, const real *b, int size) {
+    // two accumulators hide the latency of the additions
+    VEC128 sum0 = SETZERO128(), sum1 = SETZERO128();
+
+    int i;
+    for (i = 0; i <= size - 2 * LANES128; i += 2 * LANES128) {
+        sum0 = ADD128(sum0, MUL128(LOADU128(&a[i]), LOADU128(&b[i])));
+        sum1 = ADD128(sum1, MUL128(LOADU128(&a[i + LANES128]), LOADU128(&b[i + LANES128])));
+    }
+
+    real sums[LANES128];
+    STOREU128(sums, ADD128(sum0, sum1));
+    return dotp_finish(sums, LANES128, a, b, i, size);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Scalar product with AVX2 and fused multiply-add instructions
+ */
+static __attribute__((target("avx2,fma"))) real dotp_avx2(const real *a, const real *b, int size) {
+    VEC256 sum0 = SETZERO256(), sum1 = SETZERO256();
 
     int i;
-    for (i = 0; i <= size - 4; i += 4) {
-        // Load four double-precision floats from each array
-        __m256d vec1 = _mm256_loadu_pd(&a[i]);
-        __m256d vec2 = _mm256_loadu_pd(&b[i]);
+    for (i = 0; i <= size - 2 * LANES256; i += 2 * LANES256) {
+        sum0 = FMADD256(LOADU256(&a[i]), LOADU256(&b[i]), sum0);
+        sum1 = FMADD256(LOADU256(&a[i + LANES256]), LOADU256(&b[i + LANES256]), sum1);
+    }
 
-        // Perform element-wise multiplication
-        __m256d prod = _mm256_mul_pd(vec1, vec2);
+    real sums[LANES256];
+    STOREU256(sums, ADD256(sum0, sum1));
+    return dotp_finish(sums, LANES256, a, b, i, size);
+}
 
-        // Accumulate the results
-        sum = _mm256_add_pd(sum, prod);
+/* --------------------------------------------------- */
+/**
+ * @brief Scalar product with AVX-512 instructions
+ */
+static __attribute__((target("avx512f"))) real dotp_avx512(const real *a, const real *b, int size) {
+    VEC512 sum0 = SETZERO512(), sum1 = SETZERO512();
+
+    int i;
+    for (i = 0; i <= size - 2 * LANES512; i += 2 * LANES512) {
+        sum0 = FMADD512(LOADU512(&a[i]), LOADU512(&b[i]), sum0);
+        sum1 = FMADD512(LOADU512(&a[i + LANES512]), LOADU512(&b[i + LANES512]), sum1);
     }
 
-    // Horizontal addition of the 4 elements in the AVX register
-    double sums[4];
-    _mm256_storeu_pd(sums, sum);
-    double final_sum = sums[0] + sums[1] + sums[2] + sums[3];
+    real sums[LANES512];
+    STOREU512(sums, ADD512(sum0, sum1));
+    return dotp_finish(sums, LANES512, a, b, i, size);
+}
 
-    // Handle remaining elements
-    for (; i < size; ++i) {
-        final_sum += a[i] * b[i];
+/* Selected by init_Cpu_Dispatch(), the baseline until then */
+static real (*dotp_kernel)(const real *a, const real *b, int size) = dotp_sse2;
+
+real dotp(const real *a, const real *b, int size) {
+    return dotp_kernel(a, b, size);
+}
+#endif
+
+/* --------------------------------------------------- */
+/*
+ * gemm() follows the usual blocked layout of optimized BLAS libraries:
+ * - op(B) is cut into KC x NC blocks that are packed into NR wide column panels (L2 / L3 resident)
+ * - op(A) is cut into MC x KC blocks that are packed into MR high row panels (L1 / L2 resident)
+ * - a micro-kernel multiplies one MR x KC panel of A with one KC x NR panel of B,
+ *   keeping the MR x NR tile of C in registers for the whole KC loop
+ * Packing also resolves the transposes, so the micro-kernels only ever see one layout.
+ */
+#define GEMM_MR 4       // rows of the register tile
+#ifdef FLOAT32
+#define GEMM_NR 16      // columns of the register tile, one AVX-512 or two AVX2 registers of floats
+#else
+#define GEMM_NR 8       // columns of the register tile, one AVX-512 or two AVX2 registers of doubles
+#endif
+#define GEMM_KC 256     // depth of the packed panels
+#define GEMM_MC 96      // rows of a packed block of A, multiple of GEMM_MR
+#define GEMM_NC 512     // columns of a packed block of B, multiple of GEMM_NR
+
+/* Packing buffers, one pair per thread so that gemm() can be called from several threads.
+   Both live in one allocation that the destructor of packing_Key frees when the thread exits. */
+static _Thread_local real *packed_A = NULL;
+static _Thread_local real *packed_B = NULL;
+static pthread_key_t packing_Key;
+static pthread_once_t packing_Key_Once = PTHREAD_ONCE_INIT;
+
+static void create_packing_Key(void)
+{
+    if (pthread_key_create(&packing_Key, free) != 0) {
+        fprintf(stderr, "Could not create the gemm packing buffer key!");
+        exit(-1);
     }
+}
 
-    return final_sum;
+/* --------------------------------------------------- */
+/**
+ * @brief Multiply one packed panel of A with one packed panel of B (portable version)
+ * @param kc depth of the panels
+ * @param a packed panel of A, kc columns of GEMM_MR values
+ * @param b packed panel of B, kc rows of GEMM_NR values
+ * @param ab resulting GEMM_MR x GEMM_NR tile, row-major
+ */
+static void gemm_micro_kernel_scalar(int kc, const real *a, const real *b, real *ab)
+{
+    real tile[GEMM_MR * GEMM_NR] = {0.0};
+    for (int p = 0; p < kc; ++p) {
+        for (int i = 0; i < GEMM_MR; ++i) {
+            for (int j = 0; j < GEMM_NR; ++j) {
+                tile[i * GEMM_NR + j] += a[p * GEMM_MR + i] * b[p * GEMM_NR + j];
+            }
+        }
+    }
+    for (int i = 0; i < GEMM_MR * GEMM_NR; ++i) {
+        ab[i] = tile[i];
+    }
+}
+
+#if defined(SIMD)
+_Static_assert(GEMM_NR == 2 * LANES256, "the AVX2 micro-kernel keeps a tile row in two registers");
+_Static_assert(GEMM_NR == LANES512, "the AVX-512 micro-kernel keeps a tile row in one register");
+
+/* --------------------------------------------------- */
+/**
+ * @brief Multiply one packed panel of A with one packed panel of B (AVX2 / FMA version)
+ *
+ * The 4 x GEMM_NR tile lives in eight 256 bit accumulators, each step of the k loop
+ * broadcasts four values of A and issues eight fused multiply-adds.
+ *
+ * @param kc depth of the panels
+ * @param a packed panel of A, kc columns of GEMM_MR values
+ * @param b packed panel of B, kc rows of GEMM_NR values
+ * @param ab resulting GEMM_MR x GEMM_NR tile, row-major
+ */
+static __attribute__((target("avx2,fma"))) void gemm_micro_kernel_avx2(int kc, const real *a, const real *b, real *ab)
+{
+    VEC256 c00 = SETZERO256(), c01 = SETZERO256();
+    VEC256 c10 = SETZERO256(), c11 = SETZERO256();
+    VEC256 c20 = SETZERO256(), c21 = SETZERO256();
+    VEC256 c30 = SETZERO256(), c31 = SETZERO256();
+
+    for (int p = 0; p < kc; ++p) {
+        // Packed panels are 64 byte aligned, so the B rows can use aligned loads
+        VEC256 b0 = LOAD256(b);
+        VEC256 b1 = LOAD256(b + LANES256);
+
+        VEC256 a0 = BROADCAST256(a);
+        c00 = FMADD256(a0, b0, c00);
+        c01 = FMADD256(a0, b1, c01);
+        VEC256 a1 = BROADCAST256(a + 1);
+        c10 = FMADD256(a1, b0, c10);
+        c11 = FMADD256(a1, b1, c11);
+        VEC256 a2 = BROADCAST256(a + 2);
+        c20 = FMADD256(a2, b0, c20);
+        c21 = FMADD256(a2, b1, c21);
+        VEC256 a3 = BROADCAST256(a + 3);
+        c30 = FMADD256(a3, b0, c30);
+        c31 = FMADD256(a3, b1, c31);
+
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    STOREU256(ab, c00);               STOREU256(ab + LANES256, c01);
+    STOREU256(ab + GEMM_NR, c10);     STOREU256(ab + GEMM_NR + LANES256, c11);
+    STOREU256(ab + 2 * GEMM_NR, c20); STOREU256(ab + 2 * GEMM_NR + LANES256, c21);
+    STOREU256(ab + 3 * GEMM_NR, c30); STOREU256(ab + 3 * GEMM_NR + LANES256, c31);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Multiply one packed panel of A with one packed panel of B (AVX-512 version)
+ *
+ * A tile row fits into one 512 bit register. Four accumulators alone would stall on the
+ * latency of the fused multiply-adds, so even and odd steps of the k loop go to two
+ * sets of accumulators that are added at the end.
+ *
+ * @param kc depth of the panels
+ * @param a packed panel of A, kc columns of GEMM_MR values
+ * @param b packed panel of B, kc rows of GEMM_NR values
+ * @param ab resulting GEMM_MR x GEMM_NR tile, row-major
+ */
+static __attribute__((target("avx512f"))) void gemm_micro_kernel_avx512(int kc, const real *a, const real *b, real *ab)
+{
+    VEC512 c0 = SETZERO512(), c1 = SETZERO512(), c2 = SETZERO512(), c3 = SETZERO512();
+    VEC512 d0 = SETZERO512(), d1 = SETZERO512(), d2 = SETZERO512(), d3 = SETZERO512();
+
+    int p;
+    for (p = 0; p + 1 < kc; p += 2) {
+        VEC512 b0 = LOAD512(b);
+        VEC512 b1 = LOAD512(b + GEMM_NR);
+        c0 = FMADD512(SET1_512(a[0]), b0, c0);
+        c1 = FMADD512(SET1_512(a[1]), b0, c1);
+        c2 = FMADD512(SET1_512(a[2]), b0, c2);
+        c3 = FMADD512(SET1_512(a[3]), b0, c3);
+        d0 = FMADD512(SET1_512(a[GEMM_MR]), b1, d0);
+        d1 = FMADD512(SET1_512(a[GEMM_MR + 1]), b1, d1);
+        d2 = FMADD512(SET1_512(a[GEMM_MR + 2]), b1, d2);
+        d3 = FMADD512(SET1_512(a[GEMM_MR + 3]), b1, d3);
+
+        a += 2 * GEMM_MR;
+        b += 2 * GEMM_NR;
+    }
+    if (p < kc) {
+        VEC512 b0 = LOAD512(b);
+        c0 = FMADD512(SET1_512(a[0]), b0, c0);
+        c1 = FMADD512(SET1_512(a[1]), b0, c1);
+        c2 = FMADD512(SET1_512(a[2]), b0, c2);
+        c3 = FMADD512(SET1_512(a[3]), b0, c3);
+    }
+
+    STOREU512(ab, ADD512(c0, d0));
+    STOREU512(ab + GEMM_NR, ADD512(c1, d1));
+    STOREU512(ab + 2 * GEMM_NR, ADD512(c2, d2));
+    STOREU512(ab + 3 * GEMM_NR, ADD512(c3, d3));
+}
+
+/* Selected by init_Cpu_Dispatch(), the portable kernel compiled for SSE2 until then */
+static void (*gemm_micro_kernel)(int kc, const real *a, const real *b, real *ab) = gemm_micro_kernel_scalar;
+
+/* --------------------------------------------------- */
+static enum Cpu_Level detected_Level = CPU_LEVEL_SSE2;
+static enum Cpu_Level active_Level = CPU_LEVEL_SSE2;
+
+enum Cpu_Level detect_Cpu_Level(void){
+    return detected_Level;
+}
+
+/* --------------------------------------------------- */
+enum Cpu_Level get_Cpu_Level(void){
+    return active_Level;
+}
+
+/* --------------------------------------------------- */
+const char *get_Cpu_Level_Name(enum Cpu_Level level){
+    switch (level) {
+        case CPU_LEVEL_AVX512:   return "avx512";
+        case CPU_LEVEL_AVX2_FMA: return "avx2";
+        default:                 return "sse2";
+    }
+}
+
+/* --------------------------------------------------- */
+int parse_Cpu_Level(const char *name, enum Cpu_Level *level){
+    for (enum Cpu_Level l = CPU_LEVEL_SSE2; l <= CPU_LEVEL_AVX512; ++l) {
+        if (strcmp(name, get_Cpu_Level_Name(l)) == 0) {
+            *level = l;
+            return 1;
+        }
+    }
+    return 0;
 }
+
+/* --------------------------------------------------- */
+int set_Cpu_Level(enum Cpu_Level level){
+    if (level < CPU_LEVEL_SSE2 || level > detected_Level) {
+        return 0;
+    }
+    switch (level) {
+        case CPU_LEVEL_AVX512:
+            dotp_kernel = dotp_avx512;
+            gemm_micro_kernel = gemm_micro_kernel_avx512;
+            activation_vec_kernel = activation_vec_avx512;
+            d_activation_vec_kernel = d_activation_vec_avx512;
+            optimizer_update_vec_kernel = optimizer_update_vec_avx512;
+            break;
+        case CPU_LEVEL_AVX2_FMA:
+            dotp_kernel = dotp_avx2;
+            gemm_micro_kernel = gemm_micro_kernel_avx2;
+            activation_vec_kernel = activation_vec_avx2;
+            d_activation_vec_kernel = d_activation_vec_avx2;
+            optimizer_update_vec_kernel = optimizer_update_vec_avx2;
+            break;
+        default:
+            dotp_kernel = dotp_sse2;
+            gemm_micro_kernel = gemm_micro_kernel_scalar;
+            activation_vec_kernel = activation_vec_sse2;
+            d_activation_vec_kernel = d_activation_vec_sse2;
+            optimizer_update_vec_kernel = optimizer_update_vec_sse2;
+            break;
+    }
+    active_Level = level;
+    return 1;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Detect the instruction sets of the CPU and select the kernels, runs before main()
+ *
+ * NN_CPU_LEVEL=sse2|avx2 in the environment caps the selection, e.g. to reproduce
+ * the results of an older node.
+ */
+static void __attribute__((constructor)) init_Cpu_Dispatch(void)
+{
+    // a constructor may run before the one of libgcc that fills the cpuid cache
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        detected_Level = CPU_LEVEL_AVX512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        detected_Level = CPU_LEVEL_AVX2_FMA;
+    }
+
+    enum Cpu_Level level = detected_Level;
+    const char *cap = getenv("NN_CPU_LEVEL");
+    enum Cpu_Level cap_Level;
+    if (cap != NULL && parse_Cpu_Level(cap, &cap_Level) && cap_Level < level) {
+        level = cap_Level;
+    }
+    set_Cpu_Level(level);
+}
+#else  // SEQ and PARALLEL use the portable kernel
+#define gemm_micro_kernel gemm_micro_kernel_scalar
 #endif
+
+/* --------------------------------------------------- */
+/**
+ * @brief Pack a block of op(A) into panels of GEMM_MR rows, padding the last panel with zeros
+ */
+static void pack_A(enum Transpose trans_A, const real *A, int lda, int row, int col, int mc, int kc, real *packed)
+{
+    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+        int mr = (mc - ir < GEMM_MR) ? mc - ir : GEMM_MR;
+        for (int p = 0; p < kc; ++p) {
+            for (int i = 0; i < GEMM_MR; ++i) {
+                real value = 0.0;
+                if (i < mr) {
+                    size_t r = row + ir + i, c = col + p;
+                    value = (trans_A == NO_TRANSPOSE) ? A[r * lda + c] : A[c * lda + r];
+                }
+                *packed++ = value;
+            }
+        }
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Pack a block of op(B) into panels of GEMM_NR columns, padding the last panel with zeros
+ */
+static void pack_B(enum Transpose trans_B, const real *B, int ldb, int row, int col, int kc, int nc, real *packed)
+{
+    for (int jr = 0; jr < nc; jr += GEMM_NR) {
+        int nr = (nc - jr < GEMM_NR) ? nc - jr : GEMM_NR;
+        for (int p = 0; p < kc; ++p) {
+            for (int j = 0; j < GEMM_NR; ++j) {
+                real value = 0.0;
+                if (j < nr) {
+                    size_t r = row + p, c = col + jr + j;
+                    value = (trans_B == NO_TRANSPOSE) ? B[r * ldb + c] : B[c * ldb + r];
+                }
+                *packed++ = value;
+            }
+        }
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Write the valid m x n part of a tile to C as C = alpha * ab + beta * C
+ */
+static void store_tile(const real *ab, real alpha, real beta, real *C, int ldc, int m, int n)
+{
+    for (int i = 0; i < m; ++i) {
+        real *c = C + (size_t)i * ldc;
+        const real *t = ab + i * GEMM_NR;
+        if (beta == 0.0) {
+            for (int j = 0; j < n; ++j) {
+                c[j] = alpha * t[j];
+            }
+        } else {
+            for (int j = 0; j < n; ++j) {
+                c[j] = alpha * t[j] + beta * c[j];
+            }
+        }
+    }
+}
+
+/* --------------------------------------------------- */
+void gemm(enum Transpose trans_A, enum Transpose trans_B, int M, int N, int K,
+          real alpha, const real *A, int lda, const real *B, int ldb,
+          real beta, real *C, int ldc)
+{
+    if (M <= 0 || N <= 0) {
+        return;
+    }
+    if (K <= 0 || alpha == 0.0) {
+        // Nothing to multiply, only scale C
+        for (int i = 0; i < M; ++i) {
+            real *c = C + (size_t)i * ldc;
+            for (int j = 0; j < N; ++j) {
+                c[j] = (beta == 0.0) ? 0.0 : beta * c[j];
+            }
+        }
+        return;
+    }
+
+    if (packed_A == NULL) {
+        _Static_assert(GEMM_MC * GEMM_KC * sizeof(real) % 64 == 0, "packed_B has to start on a cache line");
+        pthread_once(&packing_Key_Once, create_packing_Key);
+        packed_A = (real *)aligned_alloc(64, (GEMM_MC * GEMM_KC + GEMM_KC * GEMM_NC) * sizeof(real));
+        if (packed_A == NULL || pthread_setspecific(packing_Key, packed_A) != 0) {
+            fprintf(stderr, "Could not allocate gemm packing buffers!");
+            exit(-1);
+        }
+        packed_B = packed_A + GEMM_MC * GEMM_KC;
+    }
+
+    real ab[GEMM_MR * GEMM_NR] __attribute__((aligned(64)));
+
+    for (int jc = 0; jc < N; jc += GEMM_NC) {
+        int nc = (N - jc < GEMM_NC) ? N - jc : GEMM_NC;
+        for (int pc = 0; pc < K; pc += GEMM_KC) {
+            int kc = (K - pc < GEMM_KC) ? K - pc : GEMM_KC;
+            // The first panel applies beta, the following ones accumulate
+            real beta_block = (pc == 0) ? beta : 1.0;
+            pack_B(trans_B, B, ldb, pc, jc, kc, nc, packed_B);
+
+            for (int ic = 0; ic < M; ic += GEMM_MC) {
+                int mc = (M - ic < GEMM_MC) ? M - ic : GEMM_MC;
+                pack_A(trans_A, A, lda, ic, pc, mc, kc, packed_A);
+
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    int nr = (nc - jr < GEMM_NR) ? nc - jr : GEMM_NR;
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        int mr = (mc - ir < GEMM_MR) ? mc - ir : GEMM_MR;
+                        gemm_micro_kernel(kc, packed_A + (size_t)ir * kc, packed_B + (size_t)jr * kc, ab);
+                        store_tile(ab, alpha, beta_block, C + (size_t)(ic + ir) * ldc + jc + jr, ldc, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
 /* -------------------- EOF -------------------------- */
 
 
@@ -9,6 +9,64 @@
 /* Includes ------------------------------------------ */
 #include <math.h>
 #include <stdio.h>
+#include "net_parameters.h"
+/* --------------------------------------------------- */
+
+/* Bound of the absolute error of sigmoid_vec(), float is limited by its own rounding */
+#ifdef FLOAT32
+#define SIGMOID_VEC_MAX_ERROR 5e-7
+#else
+#define SIGMOID_VEC_MAX_ERROR 1e-15
+#endif
+/* --------------------------------------------------- */
+
+/**
+ * @brief Selects whether a matrix operand of gemm() is used as stored or transposed
+ */
+enum Transpose {
+    NO_TRANSPOSE = 0,   /**< use the matrix as stored */
+    TRANSPOSE = 1       /**< use the transpose of the stored matrix */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @enum Activation
+ * @brief Activation function applied to the weighted sums of a layer
+ *
+ * The values are stored in model files, so existing ones must never change.
+ */
+enum Activation {
+    ACTIVATION_SIGMOID = 0,     /**< Logistic function 1 / (1 + e^-x) */
+    ACTIVATION_RELU = 1,        /**< max(0, x) */
+    ACTIVATION_LEAKY_RELU = 2,  /**< x for x > 0, LEAKY_RELU_SLOPE * x otherwise */
+    ACTIVATION_TANH = 3,        /**< Hyperbolic tangent */
+    ACTIVATION_SOFTMAX = 4,     /**< Normalized exponentials, output layer only, trained with the cross-entropy loss */
+    NUM_ACTIVATIONS
+};
+/* --------------------------------------------------- */
+
+/**
+ * @enum Optimizer
+ * @brief Rule that turns the gradients of a batch into an update of the weights and biases
+ */
+enum Optimizer {
+    OPTIMIZER_SGD = 0,      /**< Plain gradient descent */
+    OPTIMIZER_MOMENTUM = 1, /**< Gradient descent with a velocity that decays by MOMENTUM per step */
+    OPTIMIZER_RMSPROP = 2,  /**< Gradients scaled by the root of their running mean square */
+    OPTIMIZER_ADAM = 3,     /**< Running mean of the gradients scaled by the root of their running mean square */
+    NUM_OPTIMIZERS
+};
+/* --------------------------------------------------- */
+
+/**
+ * @struct Optimizer_Step
+ * @brief Scalars of one optimizer update, the same for every parameter
+ */
+struct Optimizer_Step {
+    enum Optimizer optimizer;   /**< Update rule */
+    real learning_rate;         /**< Step size, for Adam with the bias corrections of this step folded in */
+    real epsilon;               /**< Added to the root of the mean square, for Adam scaled like the step size */
+};
 /* --------------------------------------------------- */
 
 /**
@@ -16,7 +74,7 @@
  * @param x the variable
  * @return value x after calculation
  */
-double sigmoid(double x);
+real sigmoid(real x);
 /* --------------------------------------------------- */
 
 /**
@@ -24,7 +82,136 @@ double sigmoid(double x);
  * @param x the variable
  * @return value x after calculation
  */
-double d_sigmoid(double x);
+real d_sigmoid(real x);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Sigmoid activation of a whole array, e.g. the outputs of a layer
+ *
+ * Uses a polynomial approximation of exp() that vectorizes. The absolute error
+ * against sigmoid() is below SIGMOID_VEC_MAX_ERROR.
+ *
+ * @param x input values
+ * @param y output values, may be the same array as x
+ * @param size number of values
+ */
+void sigmoid_vec(const real *x, real *y, int size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Multiply the errors of a layer with the sigmoid derivative
+ *
+ * The derivative is taken from the outputs y = sigmoid(x) as y * (1 - y),
+ * so unlike d_sigmoid() nothing is recomputed.
+ *
+ * @param outputs outputs of the sigmoid activation
+ * @param errors errors that are scaled in place
+ * @param size number of values
+ */
+void d_sigmoid_vec(const real *outputs, real *errors, int size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Add the biases and apply an activation function to a whole array, e.g. the outputs of a layer
+ *
+ * Computes y = f(x + biases) in one pass over the array. The exponentials use the same
+ * approximation as sigmoid_vec(). For ACTIVATION_SOFTMAX the array is one complete
+ * output vector.
+ *
+ * @param activation the activation function
+ * @param x weighted sums
+ * @param biases biases added to the weighted sums, NULL for none
+ * @param y outputs, may be the same array as x
+ * @param size number of values
+ */
+void activation_vec(enum Activation activation, const real *x, const real *biases, real *y, int size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Multiply the errors of a layer with the derivative of its activation function
+ *
+ * The derivatives are taken from the outputs of the activation. ACTIVATION_SOFTMAX leaves
+ * the errors unchanged: with the cross-entropy loss the error of a softmax output layer
+ * is target - output.
+ *
+ * @param activation the activation function
+ * @param outputs outputs of the activation
+ * @param errors errors that are scaled in place
+ * @param size number of values
+ */
+void d_activation_vec(enum Activation activation, const real *outputs, real *errors, int size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the scalars of an optimizer update
+ * @param optimizer the update rule
+ * @param learning_rate step size
+ * @param step number of the update, starting at 1, used by the bias corrections of Adam
+ * @return the scalars passed to optimizer_update_vec()
+ */
+struct Optimizer_Step get_Optimizer_Step(enum Optimizer optimizer, real learning_rate, long step);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Update parameters and their optimizer state from the gradients in one pass
+ *
+ * Gradient i is scale * gradients[i], e.g. one error times the inputs of a neuron or the
+ * summed gradients of a batch with scale 1. The gradients point towards smaller errors
+ * and are added. Momentum uses only the first moments, RMSProp only the second ones.
+ *
+ * @param step scalars from get_Optimizer_Step()
+ * @param params parameters that are updated in place
+ * @param first_Moments velocity or running mean of the gradients, NULL if unused
+ * @param second_Moments running mean of the squared gradients, NULL if unused
+ * @param gradients gradients of the parameters
+ * @param scale factor of all gradients
+ * @param size number of parameters
+ */
+void optimizer_update_vec(const struct Optimizer_Step *step, real *params, real *first_Moments, real *second_Moments,
+                          const real *gradients, real scale, int size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the name of an optimizer, as used in config files
+ * @param optimizer the update rule
+ * @return e.g. "sgd" or "adam"
+ */
+const char *get_Optimizer_Name(enum Optimizer optimizer);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Look up an optimizer by its name
+ * @param name name as returned by get_Optimizer_Name()
+ * @param optimizer receives the update rule
+ * @return 1 if the name is known, 0 otherwise
+ */
+int parse_Optimizer(const char *name, enum Optimizer *optimizer);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the name of an activation function, as used in config files
+ * @param activation the activation function
+ * @return e.g. "sigmoid" or "relu"
+ */
+const char *get_Activation_Name(enum Activation activation);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Look up an activation function by its name
+ * @param name name as returned by get_Activation_Name()
+ * @param activation receives the activation function
+ * @return 1 if the name is known, 0 otherwise
+ */
+int parse_Activation(const char *name, enum Activation *activation);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the index of the largest value, e.g. the predicted class of an output layer
+ * @param values array of values
+ * @param size number of values
+ * @return index of the first maximum
+ */
+int get_max_index(const real *values, int size);
 /* --------------------------------------------------- */
 
 /**
@@ -34,7 +221,86 @@ double d_sigmoid(double x);
  * @param size number of elements in vectors
  * @return the scalar product
  */
- double dotp(const double *a, const double *b, int size);
+ real dotp(const real *a, const real *b, int size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief General matrix-matrix product C = alpha * op(A) * op(B) + beta * C
+ *
+ * All matrices are stored row-major. op(A) is M x K, op(B) is K x N and C is M x N.
+ * If beta is 0.0, C does not need to be initialized.
+ *
+ * @param trans_A whether A is stored as M x K (NO_TRANSPOSE) or as K x M (TRANSPOSE)
+ * @param trans_B whether B is stored as K x N (NO_TRANSPOSE) or as N x K (TRANSPOSE)
+ * @param M number of rows of op(A) and C
+ * @param N number of columns of op(B) and C
+ * @param K number of columns of op(A) and rows of op(B)
+ * @param alpha scaling factor of the product
+ * @param A matrix A
+ * @param lda leading dimension (row stride) of A
+ * @param B matrix B
+ * @param ldb leading dimension (row stride) of B
+ * @param beta scaling factor of C before the product is added
+ * @param C matrix C
+ * @param ldc leading dimension (row stride) of C
+ */
+void gemm(enum Transpose trans_A, enum Transpose trans_B, int M, int N, int K,
+          real alpha, const real *A, int lda, const real *B, int ldb,
+          real beta, real *C, int ldc);
+/* --------------------------------------------------- */
+
+#ifdef SIMD
+/**
+ * @brief Instruction sets the SIMD kernels (dotp(), the gemm() micro-kernel and the
+ *        vectorized activations) are dispatched to
+ *
+ * The widest level the CPU supports is selected via cpuid before main() runs.
+ */
+enum Cpu_Level {
+    CPU_LEVEL_SSE2 = 0,     /**< x86-64 baseline, available on every CPU */
+    CPU_LEVEL_AVX2_FMA = 1, /**< 256 bit registers with fused multiply-add */
+    CPU_LEVEL_AVX512 = 2    /**< 512 bit registers (AVX-512F) */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the widest instruction set the CPU supports
+ * @return the detected level
+ */
+enum Cpu_Level detect_Cpu_Level(void);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the instruction set the kernels are currently dispatched to
+ * @return the active level
+ */
+enum Cpu_Level get_Cpu_Level(void);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Dispatch the kernels to another instruction set, must not run concurrently with them
+ * @param level the level to use
+ * @return 1 on success, 0 if the CPU does not support the level
+ */
+int set_Cpu_Level(enum Cpu_Level level);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the name of an instruction set level, as accepted by NN_CPU_LEVEL
+ * @param level the level
+ * @return "sse2", "avx2" or "avx512"
+ */
+const char *get_Cpu_Level_Name(enum Cpu_Level level);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Look up an instruction set level by its name
+ * @param name name as returned by get_Cpu_Level_Name()
+ * @param level receives the level
+ * @return 1 if the name is known, 0 otherwise
+ */
+int parse_Cpu_Level(const char *name, enum Cpu_Level *level);
 /* --------------------------------------------------- */
+#endif
 
 #endif //NN_MATHFUNCTIONS_H
@@ -5,16 +5,31 @@
 #include "mathfunctions.c"
 #include <assert.h>
 
+/* Tolerance for results computed in a different order, float only keeps about 7 digits */
+#define EPSILON (sizeof(real) == sizeof(float) ? 1e-4 : 1e-12)
+#include <stdlib.h>
+
 /* --------------------------------------------------- */
 void test_sigmoid();
 void test_d_sigmoid();
+void test_sigmoid_vec();
+void test_d_sigmoid_vec();
+void test_activation_vec();
+void test_d_activation_vec();
+void test_optimizer_update_vec();
 void test_dotp();
+void test_gemm();
+void test_gemm_micro_kernel();
+void test_gemm_blocked();
+#ifdef SIMD
+void test_cpu_dispatch();
+#endif
 
 /* --------------------------------------------------- */
 void test_sigmoid()
 {
     // Test sigmoid with 0
-    double result = sigmoid(0);
+    real result = sigmoid(0);
     assert(fabs(result - 0.5) < 1e-9); // Sigmoid of 0 should be 0.5
 
     // Test sigmoid with positive input
@@ -30,7 +45,7 @@ void test_sigmoid()
 void test_d_sigmoid()
 {
     // Test derivative of sigmoid at 0
-    double result = d_sigmoid(0);
+    real result = d_sigmoid(0);
     assert(fabs(result - 0.25) < 1e-9); // Derivative of sigmoid at 0 should be 0.25
 
     // Test derivative of sigmoid with positive input
@@ -42,28 +57,402 @@ void test_d_sigmoid()
     assert(fabs(result - 0.19661193) < 1e-7); // Derivative at -1 should be approximately 0.19661193
 }
 
+/* --------------------------------------------------- */
+void test_sigmoid_vec()
+{
+    // The approximation stays within its error bound over the whole range, including saturation
+    int size = 20001;
+    real *x = malloc(size * sizeof(real));
+    real *y = malloc(size * sizeof(real));
+    for (int i = 0; i < size; ++i) x[i] = -100.0 + 200.0 * i / (size - 1);
+    sigmoid_vec(x, y, size);
+    for (int i = 0; i < size; ++i)
+    {
+        assert(fabs(y[i] - sigmoid(x[i])) < SIGMOID_VEC_MAX_ERROR);
+    }
+    assert(y[0] >= 0.0 && y[size - 1] <= 1.0);
+
+    // In place on an odd size
+    sigmoid_vec(x + 1, x + 1, 7);
+    for (int i = 1; i < 8; ++i) assert(x[i] == y[i]);
+
+    free(x);
+    free(y);
+}
+
+/* --------------------------------------------------- */
+void test_d_sigmoid_vec()
+{
+    // The errors are scaled with the derivative at the pre-activation the outputs came from
+    real inputs[] = {-3.0, -1.0, 0.0, 0.5, 1.0, 4.0};
+    real outputs[6], errors[6];
+    sigmoid_vec(inputs, outputs, 6);
+    for (int i = 0; i < 6; ++i) errors[i] = i - 2.0;
+    d_sigmoid_vec(outputs, errors, 6);
+    for (int i = 0; i < 6; ++i)
+    {
+        assert(fabs(errors[i] - (i - 2.0) * d_sigmoid(inputs[i])) < EPSILON);
+    }
+}
+
+/* --------------------------------------------------- */
+void test_activation_vec()
+{
+    // Every activation matches its libm definition, the exponentials within the sigmoid_vec() bound
+    int size = 2001;
+    real *x = malloc(size * sizeof(real));
+    real *y = malloc(size * sizeof(real));
+    for (int i = 0; i < size; ++i) x[i] = -50.0 + 100.0 * i / (size - 1);
+
+    activation_vec(ACTIVATION_RELU, x, NULL, y, size);
+    for (int i = 0; i < size; ++i) assert(y[i] == (x[i] > 0 ? x[i] : 0.0));
+
+    activation_vec(ACTIVATION_LEAKY_RELU, x, NULL, y, size);
+    for (int i = 0; i < size; ++i) assert(fabs(y[i] - (x[i] > 0 ? x[i] : LEAKY_RELU_SLOPE * x[i])) < EPSILON);
+
+    activation_vec(ACTIVATION_TANH, x, NULL, y, size);
+    for (int i = 0; i < size; ++i) assert(fabs(y[i] - tanh(x[i])) < 4 * SIGMOID_VEC_MAX_ERROR);
+
+    activation_vec(ACTIVATION_SIGMOID, x, NULL, y, size);
+    for (int i = 0; i < size; ++i) assert(fabs(y[i] - sigmoid(x[i])) < SIGMOID_VEC_MAX_ERROR);
+
+    // Softmax of inputs far beyond the range of exp() still sums to one
+    real logits[] = {1000.0, 999.0, -1000.0, 998.5, 0.0};
+    real probabilities[5];
+    activation_vec(ACTIVATION_SOFTMAX, logits, NULL, probabilities, 5);
+    double sum = 0.0, norm = 1.0 + exp(-1.0) + exp(-1.5);
+    for (int i = 0; i < 5; ++i) sum += probabilities[i];
+    assert(fabs(sum - 1.0) < 4 * SIGMOID_VEC_MAX_ERROR);
+    assert(fabs(probabilities[0] - 1.0 / norm) < 4 * SIGMOID_VEC_MAX_ERROR);
+    assert(fabs(probabilities[1] - exp(-1.0) / norm) < 4 * SIGMOID_VEC_MAX_ERROR);
+    assert(probabilities[2] < 1e-30 && probabilities[4] < 1e-30);
+
+    // The biases are added before the activation, also for softmax
+    real *biases = malloc(size * sizeof(real));
+    real *shifted = malloc(size * sizeof(real));
+    real *z = malloc(size * sizeof(real));
+    for (int i = 0; i < size; ++i)
+    {
+        biases[i] = 0.5 - (i % 7) * 0.25;
+        shifted[i] = x[i] + biases[i];
+    }
+    for (int a = 0; a < NUM_ACTIVATIONS; ++a)
+    {
+        int n = (a == ACTIVATION_SOFTMAX) ? 64 : size;
+        activation_vec((enum Activation)a, x, biases, y, n);
+        activation_vec((enum Activation)a, shifted, NULL, z, n);
+        for (int i = 0; i < n; ++i) assert(y[i] == z[i]);
+    }
+    // and in place
+    memcpy(y, x, size * sizeof(real));
+    activation_vec(ACTIVATION_SIGMOID, y, biases, y, size);
+    activation_vec(ACTIVATION_SIGMOID, shifted, NULL, z, size);
+    for (int i = 0; i < size; ++i) assert(y[i] == z[i]);
+
+    free(biases);
+    free(shifted);
+    free(z);
+    free(x);
+    free(y);
+}
+
+/* --------------------------------------------------- */
+void test_d_activation_vec()
+{
+    // The derivatives are taken from the outputs of the activations
+    real inputs[] = {-3.0, -0.5, 0.5, 2.0};
+    real outputs[4], errors[4];
+
+    activation_vec(ACTIVATION_RELU, inputs, NULL, outputs, 4);
+    for (int i = 0; i < 4; ++i) errors[i] = 2.0;
+    d_activation_vec(ACTIVATION_RELU, outputs, errors, 4);
+    for (int i = 0; i < 4; ++i) assert(errors[i] == (inputs[i] > 0 ? 2.0 : 0.0));
+
+    activation_vec(ACTIVATION_LEAKY_RELU, inputs, NULL, outputs, 4);
+    for (int i = 0; i < 4; ++i) errors[i] = 2.0;
+    d_activation_vec(ACTIVATION_LEAKY_RELU, outputs, errors, 4);
+    for (int i = 0; i < 4; ++i) assert(fabs(errors[i] - (inputs[i] > 0 ? 2.0 : 2.0 * LEAKY_RELU_SLOPE)) < EPSILON);
+
+    activation_vec(ACTIVATION_TANH, inputs, NULL, outputs, 4);
+    for (int i = 0; i < 4; ++i) errors[i] = 2.0;
+    d_activation_vec(ACTIVATION_TANH, outputs, errors, 4);
+    for (int i = 0; i < 4; ++i) assert(fabs(errors[i] - 2.0 / (cosh(inputs[i]) * cosh(inputs[i]))) < EPSILON);
+
+    // Fused with cross-entropy, the errors of a softmax layer stay as they are
+    activation_vec(ACTIVATION_SOFTMAX, inputs, NULL, outputs, 4);
+    for (int i = 0; i < 4; ++i) errors[i] = i;
+    d_activation_vec(ACTIVATION_SOFTMAX, outputs, errors, 4);
+    for (int i = 0; i < 4; ++i) assert(errors[i] == i);
+
+    // Names round trip for the config file
+    for (int a = 0; a < NUM_ACTIVATIONS; ++a)
+    {
+        enum Activation parsed;
+        assert(parse_Activation(get_Activation_Name((enum Activation)a), &parsed) && parsed == (enum Activation)a);
+    }
+    enum Activation unknown;
+    assert(!parse_Activation("swish", &unknown));
+}
+
+/* --------------------------------------------------- */
+void test_optimizer_update_vec()
+{
+    // Three steps of every optimizer match the textbook updates, computed in double
+    int size = 37;
+    real params[37], first[37], second[37], gradients[37];
+    double expected[37], mean[37], mean_Square[37];
+    for (int o = 0; o < NUM_OPTIMIZERS; ++o)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            params[i] = expected[i] = 0.1 * i;
+            first[i] = second[i] = 0.0;
+            mean[i] = mean_Square[i] = 0.0;
+        }
+        for (int t = 1; t <= 3; ++t)
+        {
+            for (int i = 0; i < size; ++i) gradients[i] = sin(i + t);
+            struct Optimizer_Step step = get_Optimizer_Step((enum Optimizer)o, 0.01, t);
+            optimizer_update_vec(&step, params, first, second, gradients, 0.5, size);
+            for (int i = 0; i < size; ++i)
+            {
+                double g = 0.5 * gradients[i];
+                if (o == OPTIMIZER_MOMENTUM)
+                {
+                    mean[i] = MOMENTUM * mean[i] + g;
+                    expected[i] += 0.01 * mean[i];
+                }
+                else if (o == OPTIMIZER_RMSPROP)
+                {
+                    mean_Square[i] = RMSPROP_DECAY * mean_Square[i] + (1 - RMSPROP_DECAY) * g * g;
+                    expected[i] += 0.01 * g / (sqrt(mean_Square[i]) + OPTIMIZER_EPSILON);
+                }
+                else if (o == OPTIMIZER_ADAM)
+                {
+                    mean[i] = ADAM_BETA1 * mean[i] + (1 - ADAM_BETA1) * g;
+                    mean_Square[i] = ADAM_BETA2 * mean_Square[i] + (1 - ADAM_BETA2) * g * g;
+                    double corrected_Mean = mean[i] / (1 - pow(ADAM_BETA1, t));
+                    double corrected_Square = mean_Square[i] / (1 - pow(ADAM_BETA2, t));
+                    expected[i] += 0.01 * corrected_Mean / (sqrt(corrected_Square) + OPTIMIZER_EPSILON);
+                }
+                else
+                {
+                    expected[i] += 0.01 * g;
+                }
+            }
+        }
+        for (int i = 0; i < size; ++i) assert(fabs(params[i] - expected[i]) < EPSILON);
+    }
+
+    // Names round trip for the config file
+    for (int o = 0; o < NUM_OPTIMIZERS; ++o)
+    {
+        enum Optimizer parsed;
+        assert(parse_Optimizer(get_Optimizer_Name((enum Optimizer)o), &parsed) && parsed == (enum Optimizer)o);
+    }
+    enum Optimizer unknown;
+    assert(!parse_Optimizer("lbfgs", &unknown));
+}
+
 /* --------------------------------------------------- */
 void test_dotp()
 {
     // Test dot product with two vectors of size 3
-    double a[] = {1.0, 2.0, 3.0};
-    double b[] = {4.0, 5.0, 6.0};
-    double result = dotp(a, b, 3);
+    real a[] = {1.0, 2.0, 3.0};
+    real b[] = {4.0, 5.0, 6.0};
+    real result = dotp(a, b, 3);
     assert(fabs(result - 32.0) < 1e-9); // Dot product should be 1*4 + 2*5 + 3*6 = 32
 
     // Test dot product with vectors containing zeros
-    double c[] = {0.0, 0.0, 0.0};
-    double d[] = {7.0, 8.0, 9.0};
+    real c[] = {0.0, 0.0, 0.0};
+    real d[] = {7.0, 8.0, 9.0};
     result = dotp(c, d, 3);
     assert(fabs(result - 0.0) < 1e-9); // Dot product should be 0
 
     // Test dot product with negative numbers
-    double e[] = {-1.0, -2.0, -3.0};
-    double f[] = {1.0, 2.0, 3.0};
+    real e[] = {-1.0, -2.0, -3.0};
+    real f[] = {1.0, 2.0, 3.0};
     result = dotp(e, f, 3);
     assert(fabs(result + 14.0) < 1e-9); // Dot product should be -1*1 + -2*2 + -3*3 = -14
 }
 
+/* --------------------------------------------------- */
+void test_gemm()
+{
+    // A is 2x3, B is 3x2 and C = A * B is 2x2
+    real A[] = {1.0, 2.0, 3.0,
+                  4.0, 5.0, 6.0};
+    real A_t[] = {1.0, 4.0,
+                    2.0, 5.0,
+                    3.0, 6.0};
+    real B[] = {7.0, 8.0,
+                  9.0, 10.0,
+                  11.0, 12.0};
+    real B_t[] = {7.0, 9.0, 11.0,
+                    8.0, 10.0, 12.0};
+    real expected[] = {58.0, 64.0,
+                         139.0, 154.0};
+    real C[4];
+
+    // Every combination of transposed operands gives the same product
+    gemm(NO_TRANSPOSE, NO_TRANSPOSE, 2, 2, 3, 1.0, A, 3, B, 2, 0.0, C, 2);
+    for (int i = 0; i < 4; ++i) assert(fabs(C[i] - expected[i]) < 1e-9);
+    gemm(NO_TRANSPOSE, TRANSPOSE, 2, 2, 3, 1.0, A, 3, B_t, 3, 0.0, C, 2);
+    for (int i = 0; i < 4; ++i) assert(fabs(C[i] - expected[i]) < 1e-9);
+    gemm(TRANSPOSE, NO_TRANSPOSE, 2, 2, 3, 1.0, A_t, 2, B, 2, 0.0, C, 2);
+    for (int i = 0; i < 4; ++i) assert(fabs(C[i] - expected[i]) < 1e-9);
+    gemm(TRANSPOSE, TRANSPOSE, 2, 2, 3, 1.0, A_t, 2, B_t, 3, 0.0, C, 2);
+    for (int i = 0; i < 4; ++i) assert(fabs(C[i] - expected[i]) < 1e-9);
+
+    // alpha scales the product and beta the previous content of C
+    gemm(NO_TRANSPOSE, NO_TRANSPOSE, 2, 2, 3, 2.0, A, 3, B, 2, -1.0, C, 2);
+    for (int i = 0; i < 4; ++i) assert(fabs(C[i] - expected[i]) < 1e-9); // 2 * AB - AB = AB
+
+    // Leading dimensions larger than the number of columns skip the padding
+    real A_padded[] = {1.0, 2.0, 3.0, 99.0,
+                         4.0, 5.0, 6.0, 99.0};
+    real C_padded[] = {0.0, 0.0, -1.0,
+                         0.0, 0.0, -1.0};
+    gemm(NO_TRANSPOSE, NO_TRANSPOSE, 2, 2, 3, 1.0, A_padded, 4, B, 2, 0.0, C_padded, 3);
+    assert(fabs(C_padded[0] - 58.0) < 1e-9 && fabs(C_padded[1] - 64.0) < 1e-9 && C_padded[2] == -1.0);
+    assert(fabs(C_padded[3] - 139.0) < 1e-9 && fabs(C_padded[4] - 154.0) < 1e-9 && C_padded[5] == -1.0);
+}
+
+/* --------------------------------------------------- */
+void test_gemm_micro_kernel()
+{
+    // The micro-kernel of this build (selected at startup for SIMD) has to match the portable one
+    int kc = 37;
+    real *a = aligned_alloc(64, kc * GEMM_MR * sizeof(real));
+    real *b = aligned_alloc(64, kc * GEMM_NR * sizeof(real));
+    real ab[GEMM_MR * GEMM_NR], ab_scalar[GEMM_MR * GEMM_NR];
+    srand(3);
+    for (int i = 0; i < kc * GEMM_MR; ++i) a[i] = (double)rand() / RAND_MAX - 0.5;
+    for (int i = 0; i < kc * GEMM_NR; ++i) b[i] = (double)rand() / RAND_MAX - 0.5;
+
+    gemm_micro_kernel(kc, a, b, ab);
+    gemm_micro_kernel_scalar(kc, a, b, ab_scalar);
+    for (int i = 0; i < GEMM_MR * GEMM_NR; ++i)
+    {
+        assert(fabs(ab[i] - ab_scalar[i]) < EPSILON);
+    }
+
+    free(a);
+    free(b);
+}
+
+/* --------------------------------------------------- */
+void test_gemm_blocked()
+{
+    // Sizes that cross the block sizes and leave partial register tiles
+    int sizes[][3] = {{1, 1, 1}, {5, 3, 7}, {32, 130, 785}, {101, 9, 300}, {97, 515, 33}};
+    srand(4);
+    for (unsigned t = 0; t < sizeof(sizes) / sizeof(sizes[0]); ++t)
+    {
+        int M = sizes[t][0], N = sizes[t][1], K = sizes[t][2];
+        for (int trans = 0; trans < 4; ++trans)
+        {
+            enum Transpose trans_A = (trans & 1) ? TRANSPOSE : NO_TRANSPOSE;
+            enum Transpose trans_B = (trans & 2) ? TRANSPOSE : NO_TRANSPOSE;
+            // Leading dimensions one larger than needed to check the strides
+            int lda = (trans_A == NO_TRANSPOSE ? K : M) + 1;
+            int ldb = (trans_B == NO_TRANSPOSE ? N : K) + 1;
+            int ldc = N + 1;
+            real *A = malloc((size_t)(trans_A == NO_TRANSPOSE ? M : K) * lda * sizeof(real));
+            real *B = malloc((size_t)(trans_B == NO_TRANSPOSE ? K : N) * ldb * sizeof(real));
+            real *C = malloc((size_t)M * ldc * sizeof(real));
+            real *C_reference = malloc((size_t)M * ldc * sizeof(real));
+            for (int i = 0; i < (trans_A == NO_TRANSPOSE ? M : K) * lda; ++i) A[i] = (double)rand() / RAND_MAX - 0.5;
+            for (int i = 0; i < (trans_B == NO_TRANSPOSE ? K : N) * ldb; ++i) B[i] = (double)rand() / RAND_MAX - 0.5;
+            for (int i = 0; i < M * ldc; ++i) C[i] = C_reference[i] = (double)rand() / RAND_MAX - 0.5;
+
+            // Straightforward triple loop as reference
+            for (int i = 0; i < M; ++i)
+            {
+                for (int j = 0; j < N; ++j)
+                {
+                    double sum = 0.0;
+                    for (int p = 0; p < K; ++p)
+                    {
+                        double a = (trans_A == NO_TRANSPOSE) ? A[i * lda + p] : A[p * lda + i];
+                        double b = (trans_B == NO_TRANSPOSE) ? B[p * ldb + j] : B[j * ldb + p];
+                        sum += a * b;
+                    }
+                    C_reference[i * ldc + j] = 0.5 * sum - 2.0 * C_reference[i * ldc + j];
+                }
+            }
+            gemm(trans_A, trans_B, M, N, K, 0.5, A, lda, B, ldb, -2.0, C, ldc);
+
+            for (int i = 0; i < M; ++i)
+            {
+                for (int j = 0; j < ldc; ++j)
+                {
+                    // the padding column must stay untouched
+                    assert(fabs(C[i * ldc + j] - C_reference[i * ldc + j]) < 1e2 * EPSILON);
+                }
+            }
+            free(A);
+            free(B);
+            free(C);
+            free(C_reference);
+        }
+    }
+}
+
+#ifdef SIMD
+/* --------------------------------------------------- */
+void test_cpu_dispatch()
+{
+    // The kernels of every level the CPU supports have to match the portable ones
+    enum Cpu_Level detected = detect_Cpu_Level();
+    assert(get_Cpu_Level() <= detected);
+    assert(set_Cpu_Level(CPU_LEVEL_SSE2));
+    enum Cpu_Level parsed;
+    assert(parse_Cpu_Level("avx2", &parsed) && parsed == CPU_LEVEL_AVX2_FMA);
+    assert(!parse_Cpu_Level("avx3", &parsed));
+
+    int kc = 41, size = 2 * LANES512 + 5;
+    real *a = aligned_alloc(64, kc * GEMM_MR * sizeof(real));
+    real *b = aligned_alloc(64, kc * GEMM_NR * sizeof(real));
+    real ab[GEMM_MR * GEMM_NR], ab_scalar[GEMM_MR * GEMM_NR];
+    srand(5);
+    for (int i = 0; i < kc * GEMM_MR; ++i) a[i] = (double)rand() / RAND_MAX - 0.5;
+    for (int i = 0; i < kc * GEMM_NR; ++i) b[i] = (double)rand() / RAND_MAX - 0.5;
+
+    for (enum Cpu_Level level = CPU_LEVEL_SSE2; level <= CPU_LEVEL_AVX512; ++level)
+    {
+        if (level > detected)
+        {
+            assert(!set_Cpu_Level(level));
+            continue;
+        }
+        assert(set_Cpu_Level(level) && get_Cpu_Level() == level);
+
+        // odd sizes exercise the remainder loops
+        for (int n = 0; n <= size; ++n)
+        {
+            double expected = 0.0;
+            for (int i = 0; i < n; ++i) expected += (double)a[i] * b[i];
+            assert(fabs(dotp(a, b, n) - expected) < EPSILON);
+        }
+        test_activation_vec();
+        test_d_activation_vec();
+        test_optimizer_update_vec();
+        // a depth of one only takes the remainder step of the unrolled AVX-512 loop
+        for (int depth = 1; depth <= kc; depth += kc - 1)
+        {
+            gemm_micro_kernel_scalar(depth, a, b, ab_scalar);
+            gemm_micro_kernel(depth, a, b, ab);
+            for (int i = 0; i < GEMM_MR * GEMM_NR; ++i) assert(fabs(ab[i] - ab_scalar[i]) < EPSILON);
+        }
+    }
+    set_Cpu_Level(detected);
+
+    free(a);
+    free(b);
+}
+#endif
+
 /**
  * Main entry for the test.
  */
@@ -71,7 +460,18 @@ int main()
 {
     test_sigmoid();
     test_d_sigmoid();
+    test_sigmoid_vec();
+    test_d_sigmoid_vec();
+    test_activation_vec();
+    test_d_activation_vec();
+    test_optimizer_update_vec();
     test_dotp();
+    test_gemm();
+    test_gemm_micro_kernel();
+    test_gemm_blocked();
+#ifdef SIMD
+    test_cpu_dispatch();
+#endif
     return 0;
 }
 /* -------------------- EOF -------------------------- */
\ No newline at end of file
@@ -1,13 +1,64 @@
 /**
- * @file Mathfunctions source file
- * @brief Different Math function definitions
+ * @file MNIST Dataset helper functions source file
+ * @brief Parsing and normalizing of the MNIST dataset
  */
 
 /* Includes ------------------------------------------ */
 #include "mnist.h"
+#include <zlib.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Header of a dataset cache file, followed by the pixels at `pixels_Offset`
+ * and the labels at `labels_Offset`
+ */
+struct Data_Cache_Header
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t num_Rows;
+    int32_t num_Requested; // rows requested from the sources, more than num_Rows if they hold no more
+    int32_t num_Features;
+    int32_t num_Classes;
+    int32_t num_Sources;
+    double norm_Max;
+    double norm_Min;
+    int64_t source_Size[DATA_CACHE_MAX_SOURCES];
+    int64_t source_Mtime_Sec[DATA_CACHE_MAX_SOURCES];
+    int64_t source_Mtime_Nsec[DATA_CACHE_MAX_SOURCES];
+    uint64_t pixels_Offset;
+    uint64_t labels_Offset;
+};
+
+/* --------------------------------------------------- */
+struct Data init_Data(int num_rows, int num_features, int num_classes)
+{
+    struct Data dataset;
+    dataset.num_Rows = num_rows;
+    dataset.num_Features = num_features;
+    dataset.num_Classes = num_classes;
+    dataset.norm_Max = NORM_MAX;
+    dataset.norm_Min = NORM_MIN;
+    dataset.mapping = NULL;
+    dataset.mapping_Size = 0;
+
+    // One block for all samples instead of one allocation per row
+    dataset.pixels = malloc((size_t)num_rows * num_features);
+    dataset.labels = malloc(num_rows);
+    if (dataset.pixels == NULL || dataset.labels == NULL)
+    {
+        fprintf(stderr, "Could not allocate memory for %d samples\n", num_rows);
+        exit(EXIT_FAILURE);
+    }
+    return dataset;
+}
 
 /* --------------------------------------------------- */
-struct Data parse_MNIST_CSV_and_normalize(const char *filename, int num_rows, int num_classes)
+struct Data parse_MNIST_CSV(const char *filename, int num_rows, int num_classes)
 {
     FILE *file = fopen(filename, "r");
     if (file == NULL)
@@ -17,35 +68,35 @@ struct Data parse_MNIST_CSV_and_normalize(const char *filename, int num_rows, in
     }
 
     // Allocate memory for struct data
-    struct Data dataset;
-    dataset.values = malloc(num_rows * sizeof(double *));
-    dataset.labels = malloc(num_rows * sizeof(double *));
+    struct Data dataset = init_Data(num_rows, MAX_COLUMNS - 1, num_classes);
+    memset(dataset.pixels, 0, (size_t)num_rows * dataset.num_Features);
+    memset(dataset.labels, 0, num_rows);
 
     char line[4096]; // Assuming lines won't exceed 4096 characters
     int row_count = 0;
 
-    while (fgets(line, sizeof(line), file) && row_count < num_rows)
+    while (row_count < num_rows && fgets(line, sizeof(line), file))
     {
-        // Allocate memory for values and labels arrays in each row
-        dataset.values[row_count] = malloc((MAX_COLUMNS - 1) * sizeof(double));
-        dataset.labels[row_count] = malloc(num_classes * sizeof(double));
+        uint8_t *values = dataset.pixels + (size_t)row_count * dataset.num_Features;
 
         // Split the line by comma
         char *token = strtok(line, ",");
         int col_count = 0;
 
-        // Extract label from the first element and perform one-hot encoding
+        // Extract label from the first element
         int label = atoi(token);
-        for (int i = 0; i < num_classes; i++)
+        if (label < 0 || label >= num_classes)
         {
-            dataset.labels[row_count][i] = (i == label) ? 1.0 : 0.0;
+            fprintf(stderr, "Error: label %d of sample %d in %s is out of range\n", label, row_count, filename);
+            exit(EXIT_FAILURE);
         }
+        dataset.labels[row_count] = (uint8_t)label;
 
         // Extract values from the remaining elements
         token = strtok(NULL, ",");
-        while (token != NULL && col_count < (MAX_COLUMNS - 1))
+        while (token != NULL && col_count < dataset.num_Features)
         {
-            dataset.values[row_count][col_count] = atof(token);
+            values[col_count] = (uint8_t)atoi(token);
             token = strtok(NULL, ",");
             col_count++;
         }
@@ -54,33 +105,350 @@ struct Data parse_MNIST_CSV_and_normalize(const char *filename, int num_rows, in
     }
 
     fclose(file);
+    // a shorter file gives fewer samples, not rows of zeros
+    dataset.num_Rows = row_count;
+
+    return dataset;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Read exactly `size` bytes from a (possibly gzip compressed) file or exit
+ */
+static void read_IDX_bytes(gzFile file, const char *filename, void *buffer, size_t size)
+{
+    if (gzread(file, buffer, (unsigned)size) != (int)size)
+    {
+        fprintf(stderr, "Error reading %s: file is truncated or corrupt\n", filename);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Open an IDX file and read its header
+ * @param filename path to the file, gzip compressed or not
+ * @param magic expected magic number
+ * @param dimensions receives the big-endian dimensions of the header
+ * @param num_dimensions number of dimensions encoded in the magic number
+ * @return the open file, positioned at the first data byte, or NULL with an error message
+ */
+static gzFile open_IDX(const char *filename, uint32_t magic, uint32_t *dimensions, int num_dimensions)
+{
+    gzFile file = gzopen(filename, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return NULL;
+    }
+    // 64 KiB of decompression buffer instead of the default 8 KiB
+    gzbuffer(file, 1 << 16);
+
+    // The header is a magic number followed by one 32 bit size per dimension, all big-endian
+    unsigned char header[4 * 4];
+    int header_Size = 4 * (1 + num_dimensions);
+    if (gzread(file, header, (unsigned)header_Size) != header_Size)
+    {
+        fprintf(stderr, "Error reading %s: file is truncated or corrupt\n", filename);
+        gzclose(file);
+        return NULL;
+    }
+    for (int i = 0; i <= num_dimensions; ++i)
+    {
+        uint32_t value = (uint32_t)header[4 * i] << 24 | (uint32_t)header[4 * i + 1] << 16 |
+                         (uint32_t)header[4 * i + 2] << 8 | (uint32_t)header[4 * i + 3];
+        if (i == 0 && value != magic)
+        {
+            fprintf(stderr, "Error: %s is not an IDX file of the expected type (magic 0x%08x, expected 0x%08x)\n", filename, value, magic);
+            gzclose(file);
+            return NULL;
+        }
+        if (i > 0)
+        {
+            dimensions[i - 1] = value;
+        }
+    }
+    return file;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Open a pair of IDX files and validate their headers
+ * @param images receives the open images file, positioned at the first pixel
+ * @param labels receives the open labels file, positioned at the first label
+ * @param num_samples receives the number of samples both files hold
+ * @return 1 on success, 0 with an error message and both files closed otherwise
+ */
+static int open_IDX_pair(const char *images_filename, const char *labels_filename, gzFile *images, gzFile *labels,
+                         int *num_samples)
+{
+    uint32_t image_dimensions[3], label_dimensions[1];
+    *images = open_IDX(images_filename, IDX_IMAGES_MAGIC, image_dimensions, 3);
+    if (*images == NULL)
+    {
+        return 0;
+    }
+    *labels = open_IDX(labels_filename, IDX_LABELS_MAGIC, label_dimensions, 1);
+    if (*labels == NULL)
+    {
+        gzclose(*images);
+        return 0;
+    }
+
+    if (image_dimensions[1] * image_dimensions[2] != (uint32_t)(MAX_COLUMNS - 1))
+    {
+        fprintf(stderr, "Error: %s holds %ux%u images, expected %d pixels per image\n",
+                images_filename, image_dimensions[1], image_dimensions[2], MAX_COLUMNS - 1);
+        gzclose(*images);
+        gzclose(*labels);
+        return 0;
+    }
+    // the shorter file decides, the sizes in the header are at most INT_MAX in any real data set
+    uint32_t count = image_dimensions[0] < label_dimensions[0] ? image_dimensions[0] : label_dimensions[0];
+    *num_samples = count > INT_MAX ? INT_MAX : (int)count;
+    return 1;
+}
+
+/* --------------------------------------------------- */
+int check_MNIST_IDX(const char *images_filename, const char *labels_filename)
+{
+    gzFile images, labels;
+    int num_samples;
+    if (!open_IDX_pair(images_filename, labels_filename, &images, &labels, &num_samples))
+    {
+        return 0;
+    }
+    gzclose(images);
+    gzclose(labels);
+    return 1;
+}
+
+/* --------------------------------------------------- */
+struct Data parse_MNIST_IDX(const char *images_filename, const char *labels_filename, int num_rows, int num_classes)
+{
+    gzFile images, labels;
+    int num_samples;
+    if (!open_IDX_pair(images_filename, labels_filename, &images, &labels, &num_samples))
+    {
+        exit(EXIT_FAILURE);
+    }
+    // shorter files give fewer samples, like a short CSV file
+    if (num_rows > num_samples)
+    {
+        num_rows = num_samples;
+    }
+
+    // Read all raw bytes at once straight into the dataset, there is no text to parse
+    int num_pixels = MAX_COLUMNS - 1;
+    struct Data dataset = init_Data(num_rows, num_pixels, num_classes);
+    read_IDX_bytes(images, images_filename, dataset.pixels, (size_t)num_rows * num_pixels);
+    read_IDX_bytes(labels, labels_filename, dataset.labels, num_rows);
+    gzclose(images);
+    gzclose(labels);
 
-    // Normalize the data to [0, 1] range
-    normalize_data(dataset.values, num_rows, MAX_COLUMNS - 1, 255.0, 0.0);
+    for (int row = 0; row < num_rows; row++)
+    {
+        if (dataset.labels[row] >= num_classes)
+        {
+            fprintf(stderr, "Error: label %d of sample %d in %s is out of range\n", dataset.labels[row], row, labels_filename);
+            exit(EXIT_FAILURE);
+        }
+    }
 
     return dataset;
 }
 
 /* --------------------------------------------------- */
-void normalize_data(double **x, int rows, int cols, double max, double min) {
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            //double original_value = x[i][j];
-            x[i][j] = (x[i][j] - min) / (max - min);
-            //printf("Original: %lf, Normalized: %lf (row: %d, col: %d)\n", original_value, x[i][j], i, j);
+/**
+ * @brief Fill the part of a cache header that identifies the source files
+ * @return 1 on success, 0 if a source file can not be accessed
+ */
+static int stat_Sources(const char **sources, int num_sources, struct Data_Cache_Header *header)
+{
+    if (num_sources < 1 || num_sources > DATA_CACHE_MAX_SOURCES)
+    {
+        return 0;
+    }
+    header->num_Sources = num_sources;
+    for (int i = 0; i < num_sources; i++)
+    {
+        struct stat source;
+        if (stat(sources[i], &source) != 0)
+        {
+            return 0;
+        }
+        header->source_Size[i] = source.st_size;
+        header->source_Mtime_Sec[i] = source.st_mtim.tv_sec;
+        header->source_Mtime_Nsec[i] = source.st_mtim.tv_nsec;
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+int load_Data_Cache(const char *cache_filename, const char **sources, int num_sources, int num_rows,
+                    int num_classes, double norm_max, double norm_min, struct Data *dataset)
+{
+    struct Data_Cache_Header expected = {0};
+    if (!stat_Sources(sources, num_sources, &expected))
+    {
+        return 0;
+    }
+
+    int fd = open(cache_filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    struct stat cache;
+    if (fstat(fd, &cache) != 0 || (size_t)cache.st_size < sizeof(struct Data_Cache_Header))
+    {
+        close(fd);
+        return 0;
+    }
+    size_t size = cache.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping stays valid
+    if (mapping == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    const struct Data_Cache_Header *header = mapping;
+    int valid = header->magic == DATA_CACHE_MAGIC && header->version == DATA_CACHE_VERSION &&
+                (header->num_Rows >= num_rows || header->num_Rows < header->num_Requested) &&
+                header->num_Classes == num_classes &&
+                header->norm_Max == norm_max && header->norm_Min == norm_min &&
+                header->num_Sources == num_sources &&
+                header->pixels_Offset + (uint64_t)header->num_Rows * header->num_Features <= header->labels_Offset &&
+                header->labels_Offset + (uint64_t)header->num_Rows <= size;
+    for (int i = 0; valid && i < num_sources; i++)
+    {
+        valid = header->source_Size[i] == expected.source_Size[i] &&
+                header->source_Mtime_Sec[i] == expected.source_Mtime_Sec[i] &&
+                header->source_Mtime_Nsec[i] == expected.source_Mtime_Nsec[i];
+    }
+    if (!valid)
+    {
+        munmap(mapping, size);
+        return 0;
+    }
+
+    dataset->pixels = (uint8_t *)mapping + header->pixels_Offset;
+    dataset->labels = (uint8_t *)mapping + header->labels_Offset;
+    dataset->num_Rows = num_rows < header->num_Rows ? num_rows : header->num_Rows;
+    dataset->num_Features = header->num_Features;
+    dataset->num_Classes = header->num_Classes;
+    dataset->norm_Max = header->norm_Max;
+    dataset->norm_Min = header->norm_Min;
+    dataset->mapping = mapping;
+    dataset->mapping_Size = size;
+    return 1;
+}
+
+/* --------------------------------------------------- */
+int write_Data_Cache(const char *cache_filename, const char **sources, int num_sources, const struct Data *dataset,
+                     int num_requested)
+{
+    struct Data_Cache_Header header = {0};
+    if (!stat_Sources(sources, num_sources, &header))
+    {
+        fprintf(stderr, "Warning: could not access the sources of %s, not caching the dataset\n", cache_filename);
+        return 0;
+    }
+    size_t num_pixels = (size_t)dataset->num_Rows * dataset->num_Features;
+    header.magic = DATA_CACHE_MAGIC;
+    header.version = DATA_CACHE_VERSION;
+    header.num_Rows = dataset->num_Rows;
+    header.num_Requested = num_requested;
+    header.num_Features = dataset->num_Features;
+    header.num_Classes = dataset->num_Classes;
+    header.norm_Max = dataset->norm_Max;
+    header.norm_Min = dataset->norm_Min;
+    // Start the pixels on a cache line boundary of the mapping
+    header.pixels_Offset = (sizeof(header) + 63) & ~(uint64_t)63;
+    header.labels_Offset = header.pixels_Offset + num_pixels;
+
+    // Concurrent runs each write their own file, the rename replaces the cache atomically
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", cache_filename, (long)getpid());
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Warning: could not create %s, not caching the dataset\n", temporary);
+        return 0;
+    }
+    static const char padding[64] = {0};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(padding, 1, header.pixels_Offset - sizeof(header), file) == header.pixels_Offset - sizeof(header) &&
+             fwrite(dataset->pixels, 1, num_pixels, file) == num_pixels &&
+             fwrite(dataset->labels, 1, dataset->num_Rows, file) == (size_t)dataset->num_Rows;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(temporary, cache_filename) != 0)
+    {
+        fprintf(stderr, "Warning: could not write %s, not caching the dataset\n", cache_filename);
+        remove(temporary);
+        return 0;
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+void normalize_data(const uint8_t *x, real *normalized, int size, double max, double min) {
+    real scale = 1.0 / (max - min);
+    real offset = min;
+    for (int i = 0; i < size; i++) {
+        normalized[i] = (x[i] - offset) * scale;
+    }
+}
+
+/* --------------------------------------------------- */
+void get_Sample(const struct Data *dataset, int row, real *values, real *labels)
+{
+    if (values != NULL)
+    {
+        normalize_data(dataset->pixels + (size_t)row * dataset->num_Features, values, dataset->num_Features,
+                       dataset->norm_Max, dataset->norm_Min);
+    }
+    if (labels != NULL)
+    {
+        for (int i = 0; i < dataset->num_Classes; i++)
+        {
+            labels[i] = (i == dataset->labels[row]) ? 1.0 : 0.0;
+        }
+    }
+}
+
+/* --------------------------------------------------- */
+void get_Samples(const struct Data *dataset, const int *order, int first, int count,
+                 real *values, int ld_Values, real *labels, int ld_Labels)
+{
+    size_t row_Size = (size_t)dataset->num_Features;
+    for (int s = 0; s < count; ++s)
+    {
+        if (s + 1 < count)
+        {
+            int next = (order != NULL) ? order[first + s + 1] : first + s + 1;
+            const uint8_t *next_Row = dataset->pixels + next * row_Size;
+            for (size_t offset = 0; offset < row_Size; offset += PREFETCH_STRIDE)
+            {
+                __builtin_prefetch(next_Row + offset, 0, 0);
+            }
         }
+        int sample = (order != NULL) ? order[first + s] : first + s;
+        get_Sample(dataset, sample, values + (size_t)s * ld_Values, labels + (size_t)s * ld_Labels);
     }
 }
 
 /* --------------------------------------------------- */
-void free_Data(struct Data *dataset, int max_rows)
+void free_Data(struct Data *dataset)
 {
-    for (int i = 0; i < max_rows; i++)
+    if (dataset->mapping != NULL)
     {
-        free(dataset->values[i]);
-        free(dataset->labels[i]);
+        munmap(dataset->mapping, dataset->mapping_Size);
+        dataset->mapping = NULL;
+        return;
     }
-    free(dataset->values);
+    free(dataset->pixels);
     free(dataset->labels);
 }
 
@@ -10,62 +10,196 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include "net_parameters.h"
 
 /* --------------------------------------------------- */
 #define MAX_COLUMNS 785
 #define MAX_ROWS_TRAIN 60000
 #define MAX_ROWS_TEST 10000
+#define IDX_IMAGES_MAGIC 0x00000803 // unsigned byte data with 3 dimensions
+#define IDX_LABELS_MAGIC 0x00000801 // unsigned byte data with 1 dimension
+#define NORM_MAX 255.0                 // raw value normalized to 1
+#define NORM_MIN 0.0                   // raw value normalized to 0
+#define DATA_CACHE_MAGIC 0x4e4e4443    // "NNDC" in native byte order
+#define DATA_CACHE_VERSION 2
+#define DATA_CACHE_MAX_SOURCES 2       // images and labels file
+#define PREFETCH_STRIDE 64             // bytes covered by one prefetch, a cache line
 
 /**
  * @brief Struct to store MNIST dataset values and labels.
  *
- * This struct holds pointers to two-dimensional arrays:
- * - `values`: The input data (features).
- * - `labels`: The corresponding labels (outputs).
+ * The dataset is kept in its compact raw form:
+ * - `pixels`: One contiguous row-major block of `num_Rows` x `num_Features` raw bytes.
+ * - `labels`: One class index per sample.
+ *
+ * The values are normalized with `norm_Max` / `norm_Min` and the labels are one-hot
+ * encoded only when a sample is read with get_Sample(), e.g. when a batch is staged.
+ *
+ * When the dataset is loaded from a cache file, `pixels` and `labels` point into a
+ * read-only mapping of that file instead of allocated memory.
  */
 struct Data
 {
-    double **values; /**< Pointer to the 2D array storing the feature values */
-    double **labels; /**< Pointer to the 2D array storing the labels */
+    uint8_t *pixels;    /**< Raw feature values, num_Rows x num_Features */
+    uint8_t *labels;    /**< Class index of each sample */
+    int num_Rows;       /**< Number of samples */
+    int num_Features;   /**< Number of feature values per sample */
+    int num_Classes;    /**< Number of classes (length of the one-hot labels) */
+    double norm_Max;  /**< Raw value that is normalized to 1 */
+    double norm_Min;  /**< Raw value that is normalized to 0 */
+    void *mapping;      /**< Mapped cache file, or NULL if the arrays are allocated */
+    size_t mapping_Size; /**< Length of the mapping in bytes */
 };
 
 /**
- * @brief Parse and normalize MNIST data from a CSV file.
+ * @brief Allocate an empty dataset
+ *
+ * The pixels and labels are left uninitialized and the normalization range is set to [NORM_MIN, NORM_MAX].
+ *
+ * @param num_rows The number of rows (samples).
+ * @param num_features The number of feature values per sample.
+ * @param num_classes The number of classes (labels) in the dataset.
+ * @return A `Data` struct with room for the samples.
+ */
+struct Data init_Data(int num_rows, int num_features, int num_classes);
+
+/**
+ * @brief Parse MNIST data from a CSV file.
  *
- * This function reads MNIST data from a CSV file, normalizes the data,
- * and stores it in the `Data` struct. The function expects the CSV to 
- * contain image data and labels in a format suitable for MNIST.
+ * This function reads MNIST data from a CSV file and stores it in the `Data` struct.
+ * The function expects the CSV to contain one sample per line, the label followed by
+ * the pixel values, as written by data/mnist2csv.py.
  *
  * @param filename The path to the CSV file containing the MNIST data.
- * @param num_rows The number of rows (samples) to read from the file.
+ * @param num_rows The maximum number of rows (samples) to read from the file.
+ * @param num_classes The number of classes (labels) in the dataset.
+ * @return A `Data` struct containing the raw values and labels, its `num_Rows` is the number
+ * of samples read, which is less than `num_rows` if the file is shorter.
+ */
+struct Data parse_MNIST_CSV(const char *filename, int num_rows, int num_classes);
+
+/**
+ * @brief Parse MNIST data from a pair of IDX files.
+ *
+ * This function reads the images and labels in the binary IDX format the MNIST dataset
+ * is distributed in, either gzip compressed (e.g. train-images-idx3-ubyte.gz) or decompressed.
+ * The magic numbers and dimensions are validated: the images have to be 28x28 pixels.
+ * The pixel bytes are stored as they are.
+ *
+ * @param images_filename The path to the IDX file with the images.
+ * @param labels_filename The path to the IDX file with the labels.
+ * @param num_rows The maximum number of rows (samples) to read from the files.
  * @param num_classes The number of classes (labels) in the dataset.
- * @return A `Data` struct containing the normalized values and labels.
+ * @return A `Data` struct containing the raw values and labels, its `num_Rows` is the number
+ * of samples read, fewer than `num_rows` if the files are shorter.
+ */
+struct Data parse_MNIST_IDX(const char *images_filename, const char *labels_filename, int num_rows, int num_classes);
+
+/**
+ * @brief Check the headers of a pair of IDX files without reading the samples.
+ *
+ * parse_MNIST_IDX() exits on files it can not read, this allows to fall back to other files first.
+ *
+ * @param images_filename The path to the IDX file with the images.
+ * @param labels_filename The path to the IDX file with the labels.
+ * @return 1 if parse_MNIST_IDX() accepts the headers, 0 (with an error message) otherwise.
+ */
+int check_MNIST_IDX(const char *images_filename, const char *labels_filename);
+
+/**
+ * @brief Map a dataset cache file written by write_Data_Cache().
+ *
+ * The cache is only used if it was written for the same source files, i.e. their size
+ * and modification time are unchanged, and for the same number of classes and normalization
+ * range, and if it holds at least `num_rows` samples or all samples of the sources. The arrays
+ * of the returned dataset point into the read-only mapping of the file, nothing is copied.
+ * Its `num_Rows` is `num_rows`, or fewer if the sources hold fewer samples.
+ *
+ * @param cache_filename The path to the cache file.
+ * @param sources The paths to the files the dataset was parsed from.
+ * @param num_sources The number of source files.
+ * @param num_rows The number of rows (samples) needed.
+ * @param num_classes The number of classes (labels) in the dataset.
+ * @param norm_max The raw value that has to be normalized to 1.
+ * @param norm_min The raw value that has to be normalized to 0.
+ * @param dataset Receives the mapped dataset on success.
+ * @return 1 if the cache was mapped, 0 if it is missing or stale.
+ */
+int load_Data_Cache(const char *cache_filename, const char **sources, int num_sources, int num_rows,
+                    int num_classes, double norm_max, double norm_min, struct Data *dataset);
+
+/**
+ * @brief Write a dataset to a cache file next to its sources.
+ *
+ * The file holds a header with the dimensions, normalization range and the size and
+ * modification time of every source file, followed by the pixel and label arrays.
+ * It is written to a temporary file that is renamed, so concurrent runs never map a
+ * partially written cache. Failing to write the cache is reported but not fatal.
+ *
+ * @param cache_filename The path to the cache file.
+ * @param sources The paths to the files the dataset was parsed from.
+ * @param num_sources The number of source files.
+ * @param dataset Pointer to the `Data` struct to cache.
+ * @param num_requested The number of rows that were requested from the sources, if the dataset
+ * holds fewer the sources are exhausted and the cache serves any larger request too.
+ * @return 1 if the cache was written, 0 otherwise.
+ */
+int write_Data_Cache(const char *cache_filename, const char **sources, int num_sources, const struct Data *dataset,
+                     int num_requested);
+
+/**
+ * @brief Normalize raw data to a given range.
+ *
+ * This function maps the raw values from the range defined by `min` and `max` to [0, 1].
+ * Typically, MNIST data is normalized from [0, 255] to [0, 1].
+ *
+ * @param x Pointer to the raw values.
+ * @param normalized Pointer to the array receiving the normalized values.
+ * @param size The number of values.
+ * @param max The raw value that is mapped to 1.
+ * @param min The raw value that is mapped to 0.
+ */
+void normalize_data(const uint8_t *x, real *normalized, int size, double max, double min);
+
+/**
+ * @brief Read one normalized sample and its one-hot encoded label.
+ *
+ * @param dataset Pointer to the `Data` struct.
+ * @param row The index of the sample.
+ * @param values Array of `num_Features` values receiving the normalized sample, or NULL.
+ * @param labels Array of `num_Classes` values receiving the one-hot label, or NULL.
  */
-struct Data parse_MNIST_CSV_and_normalize(const char *filename, int num_rows, int num_classes);
+void get_Sample(const struct Data *dataset, int row, real *values, real *labels);
 
 /**
- * @brief Normalize the data to a given range.
+ * @brief Gather a run of samples into row-major matrices.
  *
- * This function normalizes the input data to a specified range defined by `min` and `max`.
- * Typically, MNIST data is normalized to a range of 0 to 1 or -1 to 1.
+ * Row s receives sample `order[first + s]`, or sample `first + s` without an order. While a
+ * row is normalized the raw bytes of the next one are prefetched, shuffled samples are
+ * scattered over the dataset where the hardware prefetcher cannot follow them.
  *
- * @param x Pointer to the 2D array of data to be normalized.
- * @param rows The number of rows (samples) in the data.
- * @param cols The number of columns (features) in the data.
- * @param max The maximum value in the target normalization range.
- * @param min The minimum value in the target normalization range.
+ * @param dataset Pointer to the `Data` struct.
+ * @param order Indices of the samples, or NULL for file order.
+ * @param first Position of the first sample in the order.
+ * @param count The number of samples.
+ * @param values Matrix receiving the normalized samples, one per row.
+ * @param ld_Values Leading dimension (row stride) of `values`.
+ * @param labels Matrix receiving the one-hot labels, one per row.
+ * @param ld_Labels Leading dimension (row stride) of `labels`.
  */
-void normalize_data(double **x, int rows, int cols, double max, double min);
+void get_Samples(const struct Data *dataset, const int *order, int first, int count,
+                 real *values, int ld_Values, real *labels, int ld_Labels);
 
 /**
  * @brief Free the memory allocated for the MNIST dataset.
  *
- * This function frees the memory allocated for the `values` and `labels` in a `Data` struct.
+ * This function frees the memory allocated for the `pixels` and `labels` in a `Data` struct,
+ * or unmaps the cache file they point into.
  *
  * @param dataset Pointer to the `Data` struct containing the MNIST dataset.
- * @param max_rows The maximum number of rows (samples) in the dataset.
  */
-void free_Data(struct Data *dataset, int max_rows);
+void free_Data(struct Data *dataset);
 
 /* --------------------------------------------------- */
 
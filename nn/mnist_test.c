@@ -0,0 +1,252 @@
+/**
+ * @brief Test for functions in mnist.c
+ */
+/* Includes ------------------------------------------ */
+#include "mnist.c"
+#include <assert.h>
+
+/* Tolerance for results computed in a different order, float only keeps about 7 digits */
+#define EPSILON (sizeof(real) == sizeof(float) ? 1e-4 : 1e-12)
+#include <math.h>
+/* --------------------------------------------------- */
+static void test_parse_MNIST_IDX();
+static void test_parse_MNIST_IDX_gzip();
+static void test_Data_Cache();
+static void test_Data_Cache_short();
+static void test_parse_MNIST_CSV_short();
+static void test_parse_MNIST_IDX_short();
+static void test_check_MNIST_IDX();
+/* --------------------------------------------------- */
+
+#define TEST_IMAGES "/tmp/nn_mnist_test-images-idx3-ubyte"
+#define TEST_LABELS "/tmp/nn_mnist_test-labels-idx1-ubyte"
+#define TEST_CSV "/tmp/nn_mnist_test.csv"
+
+/**
+ * @brief Write three 28x28 test images and their labels in the IDX format
+ *
+ * Pixel j of image i has the value (i + j) % 256 and image i has label 3 * i.
+ */
+static void write_test_files(const char *images_filename, const char *labels_filename, int compress)
+{
+    unsigned char images_header[] = {0, 0, 8, 3, 0, 0, 0, 3, 0, 0, 0, 28, 0, 0, 0, 28};
+    unsigned char labels_header[] = {0, 0, 8, 1, 0, 0, 0, 3};
+    unsigned char pixels[3 * 784];
+    unsigned char labels[] = {0, 3, 6};
+    for (int i = 0; i < 3 * 784; ++i)
+    {
+        pixels[i] = (i / 784 + i % 784) % 256;
+    }
+
+    gzFile images = gzopen(images_filename, compress ? "wb" : "wbT");
+    gzFile label_file = gzopen(labels_filename, compress ? "wb" : "wbT");
+    assert(images != NULL && label_file != NULL);
+    gzwrite(images, images_header, sizeof(images_header));
+    gzwrite(images, pixels, sizeof(pixels));
+    gzwrite(label_file, labels_header, sizeof(labels_header));
+    gzwrite(label_file, labels, sizeof(labels));
+    gzclose(images);
+    gzclose(label_file);
+}
+
+/* --------------------------------------------------- */
+static void check_dataset(struct Data *dataset)
+{
+    real values[784];
+    real labels[10];
+    for (int i = 0; i < 3; ++i)
+    {
+        assert(dataset->labels[i] == 3 * i);
+        get_Sample(dataset, i, values, labels);
+        for (int j = 0; j < 784; ++j)
+        {
+            assert(dataset->pixels[i * 784 + j] == (i + j) % 256);
+            assert(fabs(values[j] - ((i + j) % 256) / 255.0) < EPSILON);
+        }
+        for (int c = 0; c < 10; ++c)
+        {
+            assert(labels[c] == ((c == 3 * i) ? 1.0 : 0.0));
+        }
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test reading decompressed IDX files
+ */
+static void test_parse_MNIST_IDX()
+{
+    write_test_files(TEST_IMAGES, TEST_LABELS, 0);
+    struct Data dataset = parse_MNIST_IDX(TEST_IMAGES, TEST_LABELS, 3, 10);
+    check_dataset(&dataset);
+    free_Data(&dataset);
+    remove(TEST_IMAGES);
+    remove(TEST_LABELS);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test reading gzip compressed IDX files
+ */
+static void test_parse_MNIST_IDX_gzip()
+{
+    write_test_files(TEST_IMAGES ".gz", TEST_LABELS ".gz", 1);
+    struct Data dataset = parse_MNIST_IDX(TEST_IMAGES ".gz", TEST_LABELS ".gz", 3, 10);
+    check_dataset(&dataset);
+    free_Data(&dataset);
+    remove(TEST_IMAGES ".gz");
+    remove(TEST_LABELS ".gz");
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test writing, mapping and invalidating the dataset cache
+ */
+static void test_Data_Cache()
+{
+    const char *cache = TEST_IMAGES ".cache";
+    const char *sources[] = {TEST_IMAGES, TEST_LABELS};
+    write_test_files(TEST_IMAGES, TEST_LABELS, 0);
+    remove(cache);
+
+    struct Data dataset;
+    assert(!load_Data_Cache(cache, sources, 2, 3, 10, NORM_MAX, NORM_MIN, &dataset));
+    struct Data parsed = parse_MNIST_IDX(TEST_IMAGES, TEST_LABELS, 3, 10);
+    assert(write_Data_Cache(cache, sources, 2, &parsed, 3));
+    free_Data(&parsed);
+
+    // A valid cache is mapped, also when fewer rows are needed
+    assert(load_Data_Cache(cache, sources, 2, 3, 10, NORM_MAX, NORM_MIN, &dataset));
+    assert(dataset.mapping != NULL);
+    check_dataset(&dataset);
+    free_Data(&dataset);
+    assert(load_Data_Cache(cache, sources, 2, 2, 10, NORM_MAX, NORM_MIN, &dataset));
+    assert(dataset.num_Rows == 2);
+    free_Data(&dataset);
+
+    // Different parameters or a changed source invalidate it, as do more rows than it was written for
+    assert(!load_Data_Cache(cache, sources, 2, 4, 10, NORM_MAX, NORM_MIN, &dataset));
+    assert(!load_Data_Cache(cache, sources, 2, 3, 12, NORM_MAX, NORM_MIN, &dataset));
+    assert(!load_Data_Cache(cache, sources, 2, 3, 10, 127.5, NORM_MIN, &dataset));
+    assert(!load_Data_Cache(cache, sources, 1, 3, 10, NORM_MAX, NORM_MIN, &dataset));
+    FILE *labels = fopen(TEST_LABELS, "ab");
+    fputc(0, labels);
+    fclose(labels);
+    assert(!load_Data_Cache(cache, sources, 2, 3, 10, NORM_MAX, NORM_MIN, &dataset));
+
+    remove(cache);
+    remove(TEST_IMAGES);
+    remove(TEST_LABELS);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that the cache of sources shorter than requested serves every larger request
+ */
+static void test_Data_Cache_short()
+{
+    const char *cache = TEST_IMAGES ".cache";
+    const char *sources[] = {TEST_IMAGES, TEST_LABELS};
+    write_test_files(TEST_IMAGES, TEST_LABELS, 0);
+    remove(cache);
+
+    struct Data parsed = parse_MNIST_IDX(TEST_IMAGES, TEST_LABELS, 5, 10);
+    assert(write_Data_Cache(cache, sources, 2, &parsed, 5));
+    free_Data(&parsed);
+
+    struct Data dataset;
+    assert(load_Data_Cache(cache, sources, 2, 5, 10, NORM_MAX, NORM_MIN, &dataset));
+    assert(dataset.num_Rows == 3);
+    check_dataset(&dataset);
+    free_Data(&dataset);
+    assert(load_Data_Cache(cache, sources, 2, 60000, 10, NORM_MAX, NORM_MIN, &dataset));
+    assert(dataset.num_Rows == 3);
+    free_Data(&dataset);
+    assert(load_Data_Cache(cache, sources, 2, 2, 10, NORM_MAX, NORM_MIN, &dataset));
+    assert(dataset.num_Rows == 2);
+    free_Data(&dataset);
+
+    remove(cache);
+    remove(TEST_IMAGES);
+    remove(TEST_LABELS);
+}
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that a CSV file with fewer rows than requested gives fewer samples
+ */
+static void test_parse_MNIST_CSV_short()
+{
+    FILE *file = fopen(TEST_CSV, "w");
+    assert(file != NULL);
+    for (int i = 0; i < 3; ++i)
+    {
+        fprintf(file, "%d", 3 * i);
+        for (int j = 0; j < 784; ++j)
+        {
+            fprintf(file, ",%d", (i + j) % 256);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+
+    struct Data dataset = parse_MNIST_CSV(TEST_CSV, 5, 10);
+    assert(dataset.num_Rows == 3);
+    check_dataset(&dataset);
+    free_Data(&dataset);
+    remove(TEST_CSV);
+}
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that IDX files with fewer samples than requested give fewer samples
+ */
+static void test_parse_MNIST_IDX_short()
+{
+    write_test_files(TEST_IMAGES, TEST_LABELS, 0);
+    struct Data dataset = parse_MNIST_IDX(TEST_IMAGES, TEST_LABELS, 5, 10);
+    assert(dataset.num_Rows == 3);
+    check_dataset(&dataset);
+    free_Data(&dataset);
+    remove(TEST_IMAGES);
+    remove(TEST_LABELS);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that invalid IDX files are reported instead of ending the program
+ */
+static void test_check_MNIST_IDX()
+{
+    write_test_files(TEST_IMAGES ".gz", TEST_LABELS ".gz", 1);
+    assert(check_MNIST_IDX(TEST_IMAGES ".gz", TEST_LABELS ".gz"));
+    // images and labels swapped, the magic numbers do not match
+    assert(!check_MNIST_IDX(TEST_LABELS ".gz", TEST_IMAGES ".gz"));
+    assert(!check_MNIST_IDX(TEST_IMAGES, TEST_LABELS));
+
+    // a readable file that is not an IDX file
+    FILE *file = fopen(TEST_IMAGES, "w");
+    assert(file != NULL);
+    fprintf(file, "not an IDX file\n");
+    fclose(file);
+    assert(!check_MNIST_IDX(TEST_IMAGES, TEST_LABELS ".gz"));
+
+    remove(TEST_IMAGES);
+    remove(TEST_IMAGES ".gz");
+    remove(TEST_LABELS ".gz");
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_parse_MNIST_IDX();
+    test_parse_MNIST_IDX_gzip();
+    test_Data_Cache();
+    test_Data_Cache_short();
+    test_parse_MNIST_CSV_short();
+    test_parse_MNIST_IDX_short();
+    test_check_MNIST_IDX();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
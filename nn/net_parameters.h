@@ -7,19 +7,57 @@
 #define NN_NET_PARAMETERS_H
 
 /* Defines- ------------------------------------------ */ 
+// numeric type of the weights, activations and staged samples, float with -DFLOAT32 (make compile-float)
+#ifdef FLOAT32
+typedef float real;
+#define REAL_EXP expf
+#define REAL_SQRT sqrtf
+#else
+typedef double real;
+#define REAL_EXP exp
+#define REAL_SQRT sqrt
+#endif
+
 // net structure
 #define INPUT_LAYER_SIZE 784
 #define OUTPUT_LAYER_SIZE 10
 #define NUMBER_HIDDEN_LAYERS 1
 #define HIDDEN_LAYER_SIZE {10};
 #define MAX_HIDDEN_LAYERS 10  // Define a reasonable maximum of possible number of hidden layers
+#define HIDDEN_ACTIVATION ACTIVATION_SIGMOID // activation of the hidden layers, see enum Activation in mathfunctions.h
+#define OUTPUT_ACTIVATION ACTIVATION_SIGMOID // activation of the output layer, ACTIVATION_SOFTMAX trains with cross-entropy
+#define LEAKY_RELU_SLOPE 0.01 // slope of ACTIVATION_LEAKY_RELU for negative inputs
+// SPECIALIZE=784,128,10 (make SPECIALIZE=...) compiles forward kernels for one topology, see specialized.h
 
 
 // for training
 #define LOG 1 // output logging info e.g. 0=no logs, 1=accuracy each epoch, 2= accuracy + weights before and after training
+#ifndef INSTRUMENT
+#define INSTRUMENT 0            // 1 logs the phase times and hardware counters of every epoch as JSON (make INSTRUMENT=1), 0 compiles them out
+#endif
 #define EPOCHS 4
 #define L_RATE 0.001
 #define BATCH_SIZE 32 // Size of mini-batches
+#define EVAL_BATCH_SIZE 256 // Samples per inference batch when the accuracy is calculated
 #define EARLY_STOPPING_PATIENCE 5// Number of epochs to wait for improvement
+#define SHUFFLE 1               // visit the training samples in a new random order every epoch, 0 for file order
+#define SHUFFLE_SEED 1          // seed of the random order, the same seed gives the same epochs
+#ifndef PIPELINE_SLOTS
+#define PIPELINE_SLOTS 3        // batches a producer thread stages ahead of training, 0 stages each batch in turn
+#endif
+#define OPTIMIZER OPTIMIZER_SGD // update rule, see enum Optimizer in mathfunctions.h
+#define MOMENTUM 0.9            // decay of the velocity of OPTIMIZER_MOMENTUM
+#define RMSPROP_DECAY 0.9       // decay of the mean square of OPTIMIZER_RMSPROP
+#define ADAM_BETA1 0.9          // decay of the mean of OPTIMIZER_ADAM
+#define ADAM_BETA2 0.999        // decay of the mean square of OPTIMIZER_ADAM
+#define OPTIMIZER_EPSILON 1e-8  // keeps the steps of RMSProp and Adam finite
+
+// how the parallel version shares a mini-batch between threads
+#define TRAIN_NEURON_PARALLEL 0 // the threads split the neurons of every layer
+#define TRAIN_DATA_PARALLEL 1   // every thread trains on its own shard of the batch, the gradients are reduced before one update
+#define TRAIN_HOGWILD 2         // every thread trains on its own range of samples and updates the weights without synchronization
+#ifndef TRAIN_MODE
+#define TRAIN_MODE TRAIN_NEURON_PARALLEL
+#endif
 
 #endif //NN_NET_PARAMETERS_H
\ No newline at end of file
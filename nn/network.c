@@ -5,11 +5,59 @@
 
 /* Includes ------------------------------------------ */
 #include "network.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+/* --------------------------------------------------- */
+
+/**
+ * @brief Header of a model file, followed by one Network_File_Layer per weighted layer
+ */
+struct Network_File_Header {
+    char magic[8];              /**< NETWORK_FILE_MAGIC */
+    uint32_t version;           /**< NETWORK_FILE_VERSION */
+    uint32_t endian_Tag;        /**< NETWORK_FILE_ENDIAN_TAG in the byte order of the writer */
+    uint32_t scalar_Size;       /**< sizeof the weights */
+    int32_t input_Size;         /**< Number of neurons in the input layer */
+    int32_t output_Size;        /**< Number of neurons in the output layer */
+    int32_t num_Hidden_Layers;  /**< Number of hidden layers */
+};
+
+/**
+ * @brief Description of one hidden layer or the output layer in a model file
+ */
+struct Network_File_Layer {
+    int32_t num_Neurons;
+    int32_t num_Inputs;
+    int32_t stride;
+    int32_t activation;
+};
+
+/* --------------------------------------------------- */
+/**
+ * @brief Offset of the first weight matrix in a model file, rounded up to WEIGHT_ALIGNMENT
+ */
+static long get_Weights_Offset(int num_Hidden_Layers){
+    long size = sizeof(struct Network_File_Header) + (num_Hidden_Layers + 1) * sizeof(struct Network_File_Layer);
+    return (size + WEIGHT_ALIGNMENT - 1) / WEIGHT_ALIGNMENT * WEIGHT_ALIGNMENT;
+}
 /* --------------------------------------------------- */
 
 void init_Network(struct Network *network, int input_Size, int *hidden_Sizes, int num_Hidden_Layers, int output_Size){
-    network->hidden_Sizes = hidden_Sizes;
+    /* keep a copy, the caller's array may not outlive the network */
+    network->hidden_Sizes = (int *)malloc((num_Hidden_Layers > 0 ? num_Hidden_Layers : 1) * sizeof(int));
+    if (network->hidden_Sizes == NULL){
+        fprintf(stderr, "Could not allocate network->hidden_Sizes!");
+        exit(-1);
+    }
+    for (int i = 0; i < num_Hidden_Layers; ++i) {
+        network->hidden_Sizes[i] = hidden_Sizes[i];
+    }
     network->num_Hidden_Layers = num_Hidden_Layers;
+    network->mapping = NULL;
+    network->mapping_Size = 0;
+    network->optimizer = OPTIMIZER_SGD;
+    network->optimizer_Steps = 0;
 
     /* initializes input layer */
     init_Layer(&network->input_Layer, input_Size, 0);
@@ -52,13 +100,207 @@ void free_Network(struct Network *network){
                "exiting program!\n");
         return;
     }
+    // Weights in a mapped model file are released with the mapping, so are the biases unless it predates them
+    if (network->mapping != NULL){
+        for (int l = 0; l < get_Num_Weighted_Layers(network); ++l) {
+            struct Layer *layer = get_Layer(network, l);
+            layer->weights = NULL;
+            if ((char *)layer->biases >= (char *)network->mapping &&
+                (char *)layer->biases < (char *)network->mapping + network->mapping_Size){
+                layer->biases = NULL;
+            }
+        }
+        munmap(network->mapping, network->mapping_Size);
+        network->mapping = NULL;
+    }
     free_Layer(&network->input_Layer);
     // Free hidden layers
     for (int i = 0; i < network->num_Hidden_Layers; ++i) {
         free_Layer(&network->hidden_Layer[i]);
     }
     free(network->hidden_Layer);
+    free(network->hidden_Sizes);
 
     free_Layer(&network->output_Layer);
 }
+/* --------------------------------------------------- */
+
+int set_Network_Activations(struct Network *network, enum Activation hidden_Activation, enum Activation output_Activation){
+    if (hidden_Activation == ACTIVATION_SOFTMAX){
+        fprintf(stderr, "Error: softmax is only supported in the output layer\n");
+        return 0;
+    }
+    for (int i = 0; i < network->num_Hidden_Layers; ++i) {
+        set_Layer_Activation(&network->hidden_Layer[i], hidden_Activation);
+    }
+    set_Layer_Activation(&network->output_Layer, output_Activation);
+    return 1;
+}
+/* --------------------------------------------------- */
+
+void set_Network_Optimizer(struct Network *network, enum Optimizer optimizer){
+    for (int l = 0; l < get_Num_Weighted_Layers(network); ++l) {
+        set_Layer_Optimizer(get_Layer(network, l), optimizer);
+    }
+    network->optimizer = optimizer;
+    network->optimizer_Steps = 0;
+}
+/* --------------------------------------------------- */
+
+int save_Network(const struct Network *network, const char *filename){
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL){
+        fprintf(stderr, "Error: Could not create model file %s\n", filename);
+        return 0;
+    }
+
+    struct Network_File_Header header = {NETWORK_FILE_MAGIC, NETWORK_FILE_VERSION, NETWORK_FILE_ENDIAN_TAG, sizeof(real),
+                                         network->input_Layer.num_Neurons, network->output_Layer.num_Neurons,
+                                         network->num_Hidden_Layers};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    int num_Layers = network->num_Hidden_Layers + 1;
+    for (int l = 0; l < num_Layers; ++l) {
+        const struct Layer *layer = get_Const_Layer(network, l);
+        struct Network_File_Layer description = {layer->num_Neurons, layer->num_Inputs, layer->stride, layer->activation};
+        ok = ok && fwrite(&description, sizeof(description), 1, file) == 1;
+    }
+
+    /* pad up to the first weight matrix */
+    static const char padding[WEIGHT_ALIGNMENT] = {0};
+    size_t padding_Size = get_Weights_Offset(network->num_Hidden_Layers) - ftell(file);
+    ok = ok && fwrite(padding, 1, padding_Size, file) == padding_Size;
+
+    /* the matrices are written with their padding, so each one stays aligned */
+    for (int l = 0; l < num_Layers; ++l) {
+        const struct Layer *layer = get_Const_Layer(network, l);
+        size_t num_Weights = (size_t)layer->num_Neurons * layer->stride;
+        ok = ok && fwrite(layer->weights, sizeof(real), num_Weights, file) == num_Weights;
+    }
+    for (int l = 0; l < num_Layers; ++l) {
+        const struct Layer *layer = get_Const_Layer(network, l);
+        ok = ok && fwrite(layer->biases, sizeof(real), layer->num_Neurons, file) == (size_t)layer->num_Neurons;
+    }
+
+    ok = (fclose(file) == 0) && ok;
+    if (!ok){
+        fprintf(stderr, "Error: Could not write model file %s\n", filename);
+    }
+    return ok;
+}
+/* --------------------------------------------------- */
+
+int load_Network(struct Network *network, const char *filename, int use_Mmap){
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL){
+        fprintf(stderr, "Error: Could not open model file %s\n", filename);
+        return 0;
+    }
+
+    /* validate the header before anything is allocated */
+    struct Network_File_Header header;
+    struct Network_File_Layer descriptions[MAX_HIDDEN_LAYERS + 1];
+    const char *error = NULL;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, NETWORK_FILE_MAGIC, sizeof(header.magic)) != 0){
+        error = "not a model file";
+    } else if (header.endian_Tag != NETWORK_FILE_ENDIAN_TAG){
+        error = "written on a machine with a different byte order";
+    } else if (header.version != NETWORK_FILE_VERSION && header.version != 1){
+        error = "unsupported version";
+    } else if (header.scalar_Size != sizeof(real)){
+        error = "weights are stored with a different precision";
+    } else if (header.input_Size <= 0 || header.output_Size <= 0){
+        error = "invalid layer sizes";
+    } else if (header.num_Hidden_Layers < 1 || header.num_Hidden_Layers > MAX_HIDDEN_LAYERS){
+        /* training and forward_propagate() need a hidden layer */
+        error = "invalid number of hidden layers";
+    } else if (fread(descriptions, sizeof(struct Network_File_Layer), header.num_Hidden_Layers + 1, file) != (size_t)header.num_Hidden_Layers + 1){
+        error = "file is truncated";
+    }
+    int hidden_Sizes[MAX_HIDDEN_LAYERS];
+    for (int i = 0; i < header.num_Hidden_Layers && error == NULL; ++i) {
+        hidden_Sizes[i] = descriptions[i].num_Neurons;
+        if (hidden_Sizes[i] <= 0){
+            error = "invalid layer sizes";
+        }
+    }
+    if (error != NULL){
+        fprintf(stderr, "Error: Could not load model file %s: %s\n", filename, error);
+        fclose(file);
+        return 0;
+    }
+    init_Network(network, header.input_Size, hidden_Sizes, header.num_Hidden_Layers, header.output_Size);
+
+    /* the weights have to be stored in the layout of this build */
+    size_t weights_Size = 0;
+    size_t biases_Size = 0;
+    for (int l = 0; l < get_Num_Weighted_Layers(network) && error == NULL; ++l) {
+        struct Layer *layer = get_Layer(network, l);
+        if (descriptions[l].num_Neurons != layer->num_Neurons || descriptions[l].num_Inputs != layer->num_Inputs ||
+            descriptions[l].stride != layer->stride){
+            error = "inconsistent layer sizes";
+        } else if (descriptions[l].activation < 0 || descriptions[l].activation >= NUM_ACTIVATIONS ||
+                   (descriptions[l].activation == ACTIVATION_SOFTMAX && layer != &network->output_Layer)){
+            error = "unknown activation function";
+        }
+        layer->activation = (enum Activation)descriptions[l].activation;
+        weights_Size += (size_t)layer->num_Neurons * layer->stride * sizeof(real);
+        if (header.version >= 2){
+            biases_Size += (size_t)layer->num_Neurons * sizeof(real);
+        }
+    }
+
+    long offset = get_Weights_Offset(network->num_Hidden_Layers);
+    struct stat info;
+    if (error == NULL && (fstat(fileno(file), &info) != 0 || (size_t)info.st_size < offset + weights_Size + biases_Size)){
+        error = "file is truncated";
+    }
+
+    if (error == NULL && use_Mmap){
+        /* private mapping: training the loaded network never writes back to the file */
+        void *mapping = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+        if (mapping == MAP_FAILED){
+            error = "mmap failed";
+        } else {
+            network->mapping = mapping;
+            network->mapping_Size = info.st_size;
+            for (int l = 0; l < get_Num_Weighted_Layers(network); ++l) {
+                struct Layer *layer = get_Layer(network, l);
+                free(layer->weights);
+                layer->weights = (real *)((char *)mapping + offset);
+                offset += (long)layer->num_Neurons * layer->stride * sizeof(real);
+            }
+            /* older files have no biases, the layers keep their zero biases */
+            for (int l = 0; l < get_Num_Weighted_Layers(network) && biases_Size > 0; ++l) {
+                struct Layer *layer = get_Layer(network, l);
+                free(layer->biases);
+                layer->biases = (real *)((char *)mapping + offset);
+                offset += (long)layer->num_Neurons * sizeof(real);
+            }
+        }
+    } else if (error == NULL){
+        fseek(file, offset, SEEK_SET);
+        for (int l = 0; l < get_Num_Weighted_Layers(network) && error == NULL; ++l) {
+            struct Layer *layer = get_Layer(network, l);
+            size_t num_Weights = (size_t)layer->num_Neurons * layer->stride;
+            if (fread(layer->weights, sizeof(real), num_Weights, file) != num_Weights){
+                error = "file is truncated";
+            }
+        }
+        for (int l = 0; l < get_Num_Weighted_Layers(network) && error == NULL && biases_Size > 0; ++l) {
+            struct Layer *layer = get_Layer(network, l);
+            if (fread(layer->biases, sizeof(real), layer->num_Neurons, file) != (size_t)layer->num_Neurons){
+                error = "file is truncated";
+            }
+        }
+    }
+
+    fclose(file);
+    if (error != NULL){
+        fprintf(stderr, "Error: Could not load model file %s: %s\n", filename, error);
+        free_Network(network);
+        return 0;
+    }
+    return 1;
+}
 /* --------------------------------------------------- */
\ No newline at end of file
@@ -8,6 +8,13 @@
 
 /* Includes ------------------------------------------ */
 #include "layer.h"
+#include <stdint.h>
+/* --------------------------------------------------- */
+
+/* Defines- ------------------------------------------ */
+#define NETWORK_FILE_MAGIC "NNMODEL"     // 8 bytes including the terminating 0
+#define NETWORK_FILE_VERSION 2         // version 1 files have no biases and still load, with zero biases
+#define NETWORK_FILE_ENDIAN_TAG 0x01020304 // reads as 0x04030201 with the other byte order
 /* --------------------------------------------------- */
 
 /**
@@ -18,6 +25,8 @@
  * - `hidden_Sizes` array that contains the number of neurons of each hidden layer
  * - `num_Hidden_Layers` total number of hidden layers
  * - `output_Layer` A struct from type Layer that represents the output layer
+ * - `mapping` the mapped model file the weights point into, if the network was loaded with mmap
+ * - `optimizer` the update rule of training, `optimizer_Steps` the number of updates made with it
  */
 struct Network {
     struct Layer input_Layer;       /**< Input layer of the network */
@@ -25,6 +34,10 @@ struct Network {
     int *hidden_Sizes;              /**< Array representing the number of neurons in each hidden layer */
     int num_Hidden_Layers;          /**< Total number of hidden layers in the network */
     struct Layer output_Layer;      /**< Output layer of the network */
+    void *mapping;                  /**< Mapped model file holding the weights, or NULL */
+    size_t mapping_Size;            /**< Length of the mapping in bytes */
+    enum Optimizer optimizer;       /**< Update rule used in training */
+    long optimizer_Steps;           /**< Number of updates since the optimizer was selected */
 };
 /* --------------------------------------------------- */
 
@@ -32,7 +45,7 @@ struct Network {
   * @brief Initializes an artificial neuronal network
   * @param network pointer to the network struct that is going to be initialize
   * @param input_Size the number of neurons in the input layer
-  * @param hidden_Sizes array containing the different sizes of each layer
+  * @param hidden_Sizes array containing the different sizes of each layer, the network keeps a copy
   * @param num_Hidden_Layers the number of neurons in the hidden layer
   * @param output_Size the number of neurons in the output layer
   */
@@ -40,11 +53,102 @@ void init_Network(struct Network *network, int input_Size, int *hidden_Sizes, in
 
 /* --------------------------------------------------- */
 
+/**
+ * @brief Select the activation functions of a network and draw weights suited to them
+ * @param network pointer to the network struct
+ * @param hidden_Activation activation of every hidden layer, softmax is not allowed
+ * @param output_Activation activation of the output layer
+ * @return 1 on success, 0 if the combination is not supported
+ */
+int set_Network_Activations(struct Network *network, enum Activation hidden_Activation, enum Activation output_Activation);
+
+/* --------------------------------------------------- */
+
+/**
+ * @brief Select the optimizer a network is trained with
+ *
+ * The optimizer state of every weighted layer is allocated and starts at 0.0, as does the
+ * step count. A new network trains with plain SGD.
+ *
+ * @param network pointer to the network struct
+ * @param optimizer the update rule
+ */
+void set_Network_Optimizer(struct Network *network, enum Optimizer optimizer);
+
+/* --------------------------------------------------- */
+
 /**
  * @brief Delete the network struct previously initialized
  * @param network pointer to the network struct that is going to be deleted
  */
 void free_Network(struct Network *network);
 
+/* --------------------------------------------------- */
+
+/**
+ * @brief Save the topology and weights of a network to a model file
+ *
+ * The file starts with a header holding NETWORK_FILE_MAGIC, NETWORK_FILE_VERSION,
+ * NETWORK_FILE_ENDIAN_TAG and sizeof(real), followed by the layer sizes and the activation
+ * of every layer. Then the weight matrix of each hidden layer and of the output layer follows
+ * in the same padded layout as in memory, every matrix starting on a WEIGHT_ALIGNMENT boundary.
+ * The biases of all layers follow the last matrix, layer by layer.
+ *
+ * @param network pointer to the network struct that is saved
+ * @param filename path of the model file
+ * @return 1 on success, 0 if the file could not be written
+ */
+int save_Network(const struct Network *network, const char *filename);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Initialize a network from a model file written by save_Network
+ *
+ * With `use_Mmap` the file is mapped copy-on-write and the weights and biases point into the mapping,
+ * so loading does not copy them and the pages are shared between processes using the same
+ * model. The network can still be trained, changed pages are copied privately.
+ *
+ * @param network pointer to the network struct that is going to be initialized
+ * @param filename path of the model file
+ * @param use_Mmap 1 to map the weights, 0 to read them into allocated memory
+ * @return 1 on success, 0 if the file is missing, truncated or of an unsupported version,
+ * byte order or scalar type, the network is not initialized then
+ */
+int load_Network(struct Network *network, const char *filename, int use_Mmap);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the number of layers that own weights (hidden layers and output layer)
+ * @param network pointer to the network struct
+ * @return num_Hidden_Layers + 1
+ */
+static inline int get_Num_Weighted_Layers(const struct Network *network)
+{
+    return network->num_Hidden_Layers + 1;
+}
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get a layer that owns weights by its position after the input layer
+ * @param network pointer to the network struct
+ * @param index 0 .. num_Hidden_Layers - 1 for the hidden layers, num_Hidden_Layers for the output layer
+ * @return pointer to the layer
+ */
+static inline struct Layer *get_Layer(struct Network *network, int index)
+{
+    return (index < network->num_Hidden_Layers) ? &network->hidden_Layer[index] : &network->output_Layer;
+}
+/* --------------------------------------------------- */
+
+/**
+ * @brief Read-only variant of get_Layer() for networks that must not be changed
+ * @param network pointer to the network struct
+ * @param index 0 .. num_Hidden_Layers - 1 for the hidden layers, num_Hidden_Layers for the output layer
+ * @return pointer to the layer
+ */
+static inline const struct Layer *get_Const_Layer(const struct Network *network, int index)
+{
+    return (index < network->num_Hidden_Layers) ? &network->hidden_Layer[index] : &network->output_Layer;
+}
 /* --------------------------------------------------- */
 #endif //NN_NETWORK_H
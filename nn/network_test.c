@@ -5,8 +5,11 @@
 #include "layer.c"
 #include "network.c"
 #include <assert.h>
+#include <stddef.h>
+#include <unistd.h>
 /* --------------------------------------------------- */
 static void test_init_Network();
+static void test_save_load_Network();
 /* --------------------------------------------------- */
 
 /**
@@ -35,32 +38,136 @@ static void test_init_Network(){
     assert(network.output_Layer.num_Neurons == output_Size);
 
     /* Asserting outputs and weights initialisation */
-    /* For input layer */
+    /* For input layer, which has no incoming connections */
     for (int i = 0; i < network.input_Layer.num_Neurons; ++i) {
         assert(network.input_Layer.outputs[i] == 0.0);
-        for (int j = 0; j < input_Size; ++j) {
-            assert(network.input_Layer.weights[i][j] >= 0.0 && network.input_Layer.weights[i][j] <= 1.0);
-        }
     }
+    assert(network.input_Layer.num_Inputs == 0);
 
     /* For hidden layers */
     for (int i = 0; i < num_Hidden_Layers; ++i) {
+        int num_Inputs = (i > 0) ? hidden_Sizes[i - 1] : input_Size;
+        assert(network.hidden_Layer[i].num_Inputs == num_Inputs);
         for (int j = 0; j < network.hidden_Layer[i].num_Neurons; ++j) {
-            assert(network.hidden_Layer[j].outputs[j] == 0.0);
-            for (int k = 0; k < hidden_Sizes[i - 1]; ++k) {
-                assert(network.hidden_Layer[j].weights[j][k] >= 0.0 && network.hidden_Layer[j].weights[j][k] <= 1.0);
+            assert(network.hidden_Layer[i].outputs[j] == 0.0);
+            const real *row = get_Weight_Row(&network.hidden_Layer[i], j);
+            for (int k = 0; k < num_Inputs; ++k) {
+                assert(row[k] >= 0.0 && row[k] <= 1.0);
             }
         }
     }
 
     /* For output layer */
+    assert(network.output_Layer.num_Inputs == hidden_Sizes[num_Hidden_Layers - 1]);
     for (int i = 0; i < network.output_Layer.num_Neurons; ++i) {
         assert(network.output_Layer.outputs[i] == 0.0);
-        for (int j = 0; j < output_Size; ++j) {
-            assert(network.output_Layer.weights[i][j] >= 0.0 && network.output_Layer.weights[i][j] <= 1.0);
+        const real *row = get_Weight_Row(&network.output_Layer, i);
+        for (int j = 0; j < network.output_Layer.num_Inputs; ++j) {
+            assert(row[j] >= 0.0 && row[j] <= 1.0);
+        }
+    }
+
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+
+#define TEST_MODEL "/tmp/nn_network_test.model"
+
+/**
+ * @brief Function to test saving a network and loading it again, read and mapped
+ *
+ * The loaded networks must have the topology and bit for bit the weights and biases of the saved one.
+ * Files that are truncated or not written by save_Network are rejected.
+ */
+static void test_save_load_Network(){
+    struct Network network;
+    int hidden_Sizes[] = {5, 3};
+    srand(1);
+    init_Network(&network, 6, hidden_Sizes, 2, 4);
+    /* softmax only fits the output layer, the activations are stored with the weights */
+    assert(!set_Network_Activations(&network, ACTIVATION_SOFTMAX, ACTIVATION_SIGMOID));
+    assert(set_Network_Activations(&network, ACTIVATION_RELU, ACTIVATION_SOFTMAX));
+    size_t biases_Size = 0;
+    for (int l = 0; l < get_Num_Weighted_Layers(&network); ++l) {
+        struct Layer *layer = get_Layer(&network, l);
+        for (int j = 0; j < layer->num_Neurons; ++j) {
+            layer->biases[j] = (real)rand() / RAND_MAX - 0.5;
+        }
+        biases_Size += layer->num_Neurons * sizeof(real);
+    }
+    assert(save_Network(&network, TEST_MODEL));
+
+    for (int use_Mmap = 0; use_Mmap <= 1; ++use_Mmap) {
+        struct Network loaded;
+        assert(load_Network(&loaded, TEST_MODEL, use_Mmap));
+        assert((loaded.mapping != NULL) == use_Mmap);
+        assert(loaded.input_Layer.num_Neurons == 6);
+        assert(loaded.num_Hidden_Layers == 2);
+        assert(loaded.hidden_Sizes[0] == 5 && loaded.hidden_Sizes[1] == 3);
+        assert(loaded.output_Layer.num_Neurons == 4);
+        assert(loaded.hidden_Layer[0].activation == ACTIVATION_RELU && loaded.output_Layer.activation == ACTIVATION_SOFTMAX);
+        for (int l = 0; l < get_Num_Weighted_Layers(&network); ++l) {
+            struct Layer *expected = get_Layer(&network, l);
+            struct Layer *actual = get_Layer(&loaded, l);
+            assert(actual->num_Inputs == expected->num_Inputs && actual->stride == expected->stride);
+            assert(actual->activation == expected->activation);
+            assert((uintptr_t)actual->weights % WEIGHT_ALIGNMENT == 0);
+            assert(memcmp(actual->weights, expected->weights, (size_t)expected->num_Neurons * expected->stride * sizeof(real)) == 0);
+            assert(memcmp(actual->biases, expected->biases, expected->num_Neurons * sizeof(real)) == 0);
+        }
+        /* a mapped network can still be changed, the file is not */
+        get_Weight_Row(&loaded.output_Layer, 0)[0] = 42.0;
+        free_Network(&loaded);
+    }
+
+    /* truncated file */
+    FILE *file = fopen(TEST_MODEL, "r+b");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    assert(truncate(TEST_MODEL, size - 1) == 0);
+    struct Network rejected;
+    assert(!load_Network(&rejected, TEST_MODEL, 0));
+    assert(!load_Network(&rejected, TEST_MODEL, 1));
+
+    /* a version 1 file, without biases, loads with zero biases */
+    assert(truncate(TEST_MODEL, size - biases_Size) == 0);
+    file = fopen(TEST_MODEL, "r+b");
+    uint32_t version = 1;
+    fseek(file, offsetof(struct Network_File_Header, version), SEEK_SET);
+    fwrite(&version, sizeof(version), 1, file);
+    fclose(file);
+    for (int use_Mmap = 0; use_Mmap <= 1; ++use_Mmap) {
+        struct Network loaded;
+        assert(load_Network(&loaded, TEST_MODEL, use_Mmap));
+        assert(memcmp(loaded.output_Layer.weights, network.output_Layer.weights,
+                      (size_t)network.output_Layer.num_Neurons * network.output_Layer.stride * sizeof(real)) == 0);
+        for (int l = 0; l < get_Num_Weighted_Layers(&loaded); ++l) {
+            for (int j = 0; j < get_Layer(&loaded, l)->num_Neurons; ++j) {
+                assert(get_Layer(&loaded, l)->biases[j] == 0.0);
+            }
         }
+        free_Network(&loaded);
     }
 
+    /* no hidden layer */
+    assert(save_Network(&network, TEST_MODEL));
+    file = fopen(TEST_MODEL, "r+b");
+    int32_t num_Hidden_Layers = 0;
+    fseek(file, offsetof(struct Network_File_Header, num_Hidden_Layers), SEEK_SET);
+    fwrite(&num_Hidden_Layers, sizeof(num_Hidden_Layers), 1, file);
+    fclose(file);
+    assert(!load_Network(&rejected, TEST_MODEL, 0));
+    assert(!load_Network(&rejected, TEST_MODEL, 1));
+
+    /* not a model file */
+    file = fopen(TEST_MODEL, "wb");
+    fputs("input_size=784\n", file);
+    fclose(file);
+    assert(!load_Network(&rejected, TEST_MODEL, 0));
+
+    remove(TEST_MODEL);
     free_Network(&network);
 }
 
@@ -73,6 +180,7 @@ int main(int argc, char **argv)
 {
 
     test_init_Network();
+    test_save_load_Network();
     return 0;
 }
 /* -------------------- EOF -------------------------- */
\ No newline at end of file
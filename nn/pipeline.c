@@ -0,0 +1,143 @@
+/**
+ * @file Pipeline source file
+ * @brief Pipeline function definitions
+ */
+
+/* Includes ------------------------------------------ */
+#include "pipeline.h"
+#include <sched.h>
+/* --------------------------------------------------- */
+
+/* Checks of an empty or full ring before the waiting side gives up its time slice */
+#define PIPELINE_SPINS 64
+
+/* --------------------------------------------------- */
+/**
+ * @brief Wait until a counter of the other side passes a value
+ * @return 1 once `*counter > value`, 0 if the pipeline was stopped first
+ */
+static int wait_for(struct Batch_Pipeline *pipeline, atomic_ulong *counter, unsigned long value)
+{
+    for (int spin = 0; atomic_load_explicit(counter, memory_order_acquire) <= value; ++spin){
+        if (atomic_load_explicit(&pipeline->stop, memory_order_relaxed)){
+            return 0;
+        }
+        // a core may be shared with the other side, let it run
+        if (spin >= PIPELINE_SPINS){
+            sched_yield();
+        }
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Producer thread, stages the batches of one epoch in order
+ */
+static void *produce_Batches(void *argument)
+{
+    struct Batch_Pipeline *pipeline = (struct Batch_Pipeline *)argument;
+    int num_Batches = (pipeline->num_Samples + pipeline->max_Batch - 1) / pipeline->max_Batch;
+
+    for (unsigned long batch = 0; batch < (unsigned long)num_Batches; ++batch){
+        // the slot is free once the training thread has taken the batch num_Slots before
+        if (batch >= (unsigned long)pipeline->num_Slots &&
+            !wait_for(pipeline, &pipeline->consumed, batch - pipeline->num_Slots)){
+            break;
+        }
+        struct Batch_Slot *slot = &pipeline->slots[batch % pipeline->num_Slots];
+        int first = (int)batch * pipeline->max_Batch;
+        int remaining = pipeline->num_Samples - first;
+        slot->batch_Size = (remaining < pipeline->max_Batch) ? remaining : pipeline->max_Batch;
+        get_Samples(pipeline->data, pipeline->order, first, slot->batch_Size,
+                    slot->inputs, pipeline->ld_Inputs, slot->targets, pipeline->ld_Targets);
+        atomic_store_explicit(&pipeline->produced, batch + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+/* --------------------------------------------------- */
+void init_Batch_Pipeline(struct Batch_Pipeline *pipeline, const struct Workspace *workspace, int num_Slots){
+    pipeline->num_Slots = num_Slots;
+    pipeline->max_Batch = workspace->max_Batch;
+    pipeline->ld_Inputs = workspace->ld[0];
+    pipeline->ld_Targets = workspace->ld[workspace->num_Layers];
+    pipeline->data = NULL;
+    pipeline->order = NULL;
+    pipeline->num_Samples = 0;
+    atomic_init(&pipeline->produced, 0);
+    atomic_init(&pipeline->consumed, 0);
+    atomic_init(&pipeline->stop, 0);
+    pipeline->running = 0;
+
+    pipeline->slots = (struct Batch_Slot *)malloc(num_Slots * sizeof(struct Batch_Slot));
+    if (pipeline->slots == NULL){
+        fprintf(stderr, "Could not allocate pipeline->slots!");
+        exit(-1);
+    }
+    for (int i = 0; i < num_Slots; ++i){
+        pipeline->slots[i].inputs = alloc_Matrix(pipeline->max_Batch, pipeline->ld_Inputs);
+        pipeline->slots[i].targets = alloc_Matrix(pipeline->max_Batch, pipeline->ld_Targets);
+        pipeline->slots[i].batch_Size = 0;
+    }
+}
+
+/* --------------------------------------------------- */
+void start_Batch_Pipeline(struct Batch_Pipeline *pipeline, const struct Data *data, const int *order, int num_Samples){
+    pipeline->data = data;
+    pipeline->order = order;
+    pipeline->num_Samples = num_Samples;
+    atomic_store(&pipeline->produced, 0);
+    atomic_store(&pipeline->consumed, 0);
+    atomic_store(&pipeline->stop, 0);
+    if (pthread_create(&pipeline->producer, NULL, produce_Batches, pipeline) != 0){
+        fprintf(stderr, "Could not start the batch producer thread!");
+        exit(-1);
+    }
+    pipeline->running = 1;
+}
+
+/* --------------------------------------------------- */
+int next_Batch(struct Batch_Pipeline *pipeline, struct Workspace *workspace){
+    unsigned long batch = atomic_load_explicit(&pipeline->consumed, memory_order_relaxed);
+    int num_Batches = (pipeline->num_Samples + pipeline->max_Batch - 1) / pipeline->max_Batch;
+    if (batch >= (unsigned long)num_Batches){
+        if (pipeline->running){
+            pthread_join(pipeline->producer, NULL);
+            pipeline->running = 0;
+        }
+        return 0;
+    }
+    wait_for(pipeline, &pipeline->produced, batch);
+
+    // the staged buffers change owner, the workspace's old ones are staged into next
+    struct Batch_Slot *slot = &pipeline->slots[batch % pipeline->num_Slots];
+    real *inputs = workspace->activations[0];
+    real *targets = workspace->targets;
+    workspace->activations[0] = slot->inputs;
+    workspace->targets = slot->targets;
+    slot->inputs = inputs;
+    slot->targets = targets;
+    int batch_Size = slot->batch_Size;
+    atomic_store_explicit(&pipeline->consumed, batch + 1, memory_order_release);
+    return batch_Size;
+}
+
+/* --------------------------------------------------- */
+void free_Batch_Pipeline(struct Batch_Pipeline *pipeline){
+    if (pipeline == NULL){
+        fprintf(stderr, "Pipeline does not exist!\n");
+        return;
+    }
+    if (pipeline->running){
+        atomic_store(&pipeline->stop, 1);
+        pthread_join(pipeline->producer, NULL);
+        pipeline->running = 0;
+    }
+    for (int i = 0; i < pipeline->num_Slots; ++i){
+        free(pipeline->slots[i].inputs);
+        free(pipeline->slots[i].targets);
+    }
+    free(pipeline->slots);
+}
+/* --------------------------------------------------- */
@@ -0,0 +1,96 @@
+/**
+ * @file Pipeline header file
+ * @brief Batches staged by a producer thread while the previous ones are trained on
+ */
+#ifndef NN_PIPELINE_H
+#define NN_PIPELINE_H
+
+/* Includes ------------------------------------------ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include "workspace.h"
+#include "mnist.h"
+/* --------------------------------------------------- */
+
+/**
+ * @struct Batch_Slot
+ * @brief One staged batch in the ring of a pipeline
+ */
+struct Batch_Slot {
+    real *inputs;       /**< Normalized samples (max_Batch x ld_Inputs) */
+    real *targets;      /**< One-hot labels (max_Batch x ld_Targets) */
+    int batch_Size;     /**< Number of samples in the batch */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @struct Batch_Pipeline
+ * @brief Ring of staged batches between a producer thread and the training thread
+ *
+ * The producer gathers and normalizes the batches of an epoch in order into the free slots
+ * of the ring, the training thread takes them one by one. The ring is a single producer,
+ * single consumer queue without locks: each side only writes its own counter, the slot a
+ * counter points to belongs to the other side once the counter is published.
+ * Taking a batch swaps the buffers of the slot with the staging buffers of the workspace,
+ * so nothing is copied.
+ */
+struct Batch_Pipeline {
+    struct Batch_Slot *slots;       /**< Ring of num_Slots staged batches */
+    int num_Slots;                  /**< Number of batches that can be staged ahead */
+    int max_Batch;                  /**< Samples per batch, the last batch of an epoch may be smaller */
+    int ld_Inputs;                  /**< Leading dimension of the staged inputs */
+    int ld_Targets;                 /**< Leading dimension of the staged targets */
+    const struct Data *data;        /**< Data set of the current epoch */
+    const int *order;               /**< Order of the samples in the current epoch, or NULL */
+    int num_Samples;                /**< Number of samples of the current epoch */
+    atomic_ulong produced;          /**< Batches staged in this epoch, written by the producer */
+    atomic_ulong consumed;          /**< Batches taken in this epoch, written by the training thread */
+    atomic_int stop;                /**< Set to make the producer give up */
+    pthread_t producer;             /**< Producer thread of the current epoch */
+    int running;                    /**< Whether the producer thread has to be joined */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Allocate the ring of a pipeline
+ * @param pipeline pointer to the pipeline struct that is going to be initialized
+ * @param workspace workspace the batches are trained in, the slots are sized like its staging buffers
+ * @param num_Slots number of batches that can be staged ahead, at least 1
+ */
+void init_Batch_Pipeline(struct Batch_Pipeline *pipeline, const struct Workspace *workspace, int num_Slots);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Start the producer thread for one epoch
+ *
+ * The batches are max_Batch consecutive positions of the order, the last one holds the rest.
+ *
+ * @param pipeline pointer to the pipeline struct
+ * @param data the data set, it must not change until the epoch is consumed
+ * @param order indices of the samples in the order they are trained on, or NULL for file order
+ * @param num_Samples number of samples of the epoch
+ */
+void start_Batch_Pipeline(struct Batch_Pipeline *pipeline, const struct Data *data, const int *order, int num_Samples);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Take the next staged batch of the epoch, waiting for the producer if needed
+ *
+ * The staged inputs and targets of the workspace are swapped with the buffers of the batch.
+ * After the last batch the producer thread is joined.
+ *
+ * @param pipeline pointer to the pipeline struct
+ * @param workspace workspace receiving the batch in activations[0] and targets
+ * @return number of samples of the batch, 0 if the epoch is consumed
+ */
+int next_Batch(struct Batch_Pipeline *pipeline, struct Workspace *workspace);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Stop the producer and delete the pipeline struct previously initialized
+ * @param pipeline pointer to the pipeline struct that is going to be deleted
+ */
+void free_Batch_Pipeline(struct Batch_Pipeline *pipeline);
+/* --------------------------------------------------- */
+
+#endif //NN_PIPELINE_H
@@ -0,0 +1,117 @@
+/**
+ * @brief Test for functions in pipeline.c
+ */
+/* Includes ------------------------------------------ */
+#include "layer.c"
+#include "network.c"
+#include "mathfunctions.c"
+#include "workspace.c"
+#include "mnist.c"
+#include "sampler.c"
+#include "pipeline.c"
+#include <assert.h>
+/* --------------------------------------------------- */
+static void test_Batch_Pipeline();
+static void test_free_Batch_Pipeline_early();
+/* --------------------------------------------------- */
+
+#define NUM_SAMPLES 23
+#define NUM_FEATURES 5
+#define BATCH 4
+
+/* Random samples with 5 features and one of 3 classes */
+static struct Data init_random_data()
+{
+    struct Data data = init_Data(NUM_SAMPLES, NUM_FEATURES, 3);
+    for (int s = 0; s < NUM_SAMPLES; ++s)
+    {
+        for (int i = 0; i < NUM_FEATURES; ++i) data.pixels[s * NUM_FEATURES + i] = rand() % 256;
+        data.labels[s] = s % 3;
+    }
+    return data;
+}
+
+/**
+ * @brief Function to test that the pipeline hands out every batch of an epoch in order
+ *
+ * With rings of 1 to 3 slots and over several shuffled epochs, every batch equals the samples
+ * staged directly from the order, and the last batch holds the remaining 3 samples.
+ */
+static void test_Batch_Pipeline(){
+    int hidden_Sizes[] = {6};
+    struct Network network;
+    init_Network(&network, NUM_FEATURES, hidden_Sizes, 1, 3);
+    struct Workspace workspace;
+    init_Workspace(&workspace, &network, BATCH);
+    struct Data data = init_random_data();
+    struct Sampler sampler;
+    init_Sampler(&sampler, NUM_SAMPLES, 11);
+
+    int ld_In = workspace.ld[0], ld_Out = workspace.ld[workspace.num_Layers];
+    real *values = alloc_Matrix(BATCH, ld_In);
+    real *labels = alloc_Matrix(BATCH, ld_Out);
+    for (int num_Slots = 1; num_Slots <= 3; ++num_Slots){
+        struct Batch_Pipeline pipeline;
+        init_Batch_Pipeline(&pipeline, &workspace, num_Slots);
+        for (int epoch = 0; epoch < 3; ++epoch){
+            shuffle_Sampler(&sampler);
+            start_Batch_Pipeline(&pipeline, &data, sampler.order, NUM_SAMPLES);
+            for (int first = 0; first < NUM_SAMPLES; first += BATCH){
+                int batch_Size = next_Batch(&pipeline, &workspace);
+                assert(batch_Size == ((NUM_SAMPLES - first < BATCH) ? NUM_SAMPLES - first : BATCH));
+                get_Samples(&data, sampler.order, first, batch_Size, values, ld_In, labels, ld_Out);
+                for (int s = 0; s < batch_Size; ++s){
+                    assert(memcmp(workspace.activations[0] + s * ld_In, values + s * ld_In, NUM_FEATURES * sizeof(real)) == 0);
+                    assert(memcmp(workspace.targets + s * ld_Out, labels + s * ld_Out, 3 * sizeof(real)) == 0);
+                }
+                assert((uintptr_t)workspace.activations[0] % WEIGHT_ALIGNMENT == 0);
+            }
+            // the epoch is consumed and the producer joined
+            assert(next_Batch(&pipeline, &workspace) == 0);
+            assert(!pipeline.running);
+        }
+        free_Batch_Pipeline(&pipeline);
+    }
+
+    free(values);
+    free(labels);
+    free_Sampler(&sampler);
+    free_Data(&data);
+    free_Workspace(&workspace);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that a producer waiting for a free slot is stopped
+ */
+static void test_free_Batch_Pipeline_early(){
+    int hidden_Sizes[] = {6};
+    struct Network network;
+    init_Network(&network, NUM_FEATURES, hidden_Sizes, 1, 3);
+    struct Workspace workspace;
+    init_Workspace(&workspace, &network, BATCH);
+    struct Data data = init_random_data();
+
+    struct Batch_Pipeline pipeline;
+    init_Batch_Pipeline(&pipeline, &workspace, 1);
+    start_Batch_Pipeline(&pipeline, &data, NULL, NUM_SAMPLES);
+    assert(next_Batch(&pipeline, &workspace) == BATCH);
+    free_Batch_Pipeline(&pipeline);
+
+    free_Data(&data);
+    free_Workspace(&workspace);
+    free_Network(&network);
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_Batch_Pipeline();
+    test_free_Batch_Pipeline_early();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
@@ -0,0 +1,59 @@
+/**
+ * @file Sampler source file
+ * @brief Sampler function definitions
+ */
+
+/* Includes ------------------------------------------ */
+#include "sampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+/* --------------------------------------------------- */
+
+void init_Sampler(struct Sampler *sampler, int num_Samples, uint64_t seed){
+    sampler->num_Samples = num_Samples;
+    sampler->state = seed;
+    sampler->order = (int *)malloc((num_Samples > 0 ? num_Samples : 1) * sizeof(int));
+    if (sampler->order == NULL){
+        fprintf(stderr, "Could not allocate sampler->order!");
+        exit(-1);
+    }
+    for (int i = 0; i < num_Samples; ++i){
+        sampler->order[i] = i;
+    }
+}
+
+/* --------------------------------------------------- */
+void shuffle_Sampler(struct Sampler *sampler){
+    // Shuffling the previous permutation again keeps every permutation equally likely
+    for (int i = sampler->num_Samples - 1; i > 0; --i){
+        int j = random_Below(&sampler->state, i + 1);
+        int swap = sampler->order[i];
+        sampler->order[i] = sampler->order[j];
+        sampler->order[j] = swap;
+    }
+}
+
+/* --------------------------------------------------- */
+void free_Sampler(struct Sampler *sampler){
+    if (sampler == NULL){
+        fprintf(stderr, "Sampler does not exist!\n");
+        return;
+    }
+    free(sampler->order);
+    sampler->order = NULL;
+}
+
+/* --------------------------------------------------- */
+uint64_t next_Random(uint64_t *state){
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* --------------------------------------------------- */
+int random_Below(uint64_t *state, int bound){
+    // the upper 32 bits scaled to [0, bound) by a multiplication
+    return (int)(((next_Random(state) >> 32) * (uint64_t)bound) >> 32);
+}
+/* --------------------------------------------------- */
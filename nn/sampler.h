@@ -0,0 +1,69 @@
+/**
+ * @file Sampler header file
+ * @brief Order in which the training samples are visited
+ */
+#ifndef NN_SAMPLER_H
+#define NN_SAMPLER_H
+
+/* Includes ------------------------------------------ */
+#include <stdint.h>
+#include "net_parameters.h"
+/* --------------------------------------------------- */
+
+/**
+ * @struct Sampler
+ * @brief Permutation of the sample indices of a data set, drawn again every epoch
+ *
+ * Only the indices are shuffled, the data set itself is never copied or moved. The
+ * batches read the samples through `order`, batch b being `order[b * batch_Size ...]`.
+ * The permutations come from a SplitMix64 generator, so a seed gives the same sequence
+ * of epochs on every machine.
+ */
+struct Sampler {
+    int *order;         /**< Index of the sample visited at each position of the epoch */
+    int num_Samples;    /**< Number of samples, length of `order` */
+    uint64_t state;     /**< State of the random number generator */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Initialize a sampler with the samples in file order
+ * @param sampler pointer to the sampler struct that is going to be initialized
+ * @param num_Samples number of samples to permute
+ * @param seed seed of the random number generator
+ */
+void init_Sampler(struct Sampler *sampler, int num_Samples, uint64_t seed);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Draw a new permutation of the samples (Fisher-Yates)
+ * @param sampler pointer to the sampler struct
+ */
+void shuffle_Sampler(struct Sampler *sampler);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Delete the sampler struct previously initialized
+ * @param sampler pointer to the sampler struct that is going to be deleted
+ */
+void free_Sampler(struct Sampler *sampler);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the next 64 random bits of a SplitMix64 generator
+ * @param state state of the generator, advanced by the call
+ * @return uniformly distributed random bits
+ */
+uint64_t next_Random(uint64_t *state);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get a random number in [0, bound) without a division
+ * @param state state of the generator, advanced by the call
+ * @param bound number of possible results, greater than 0
+ * @return uniformly distributed number below bound, the bias is below bound / 2^32
+ */
+int random_Below(uint64_t *state, int bound);
+/* --------------------------------------------------- */
+
+#endif //NN_SAMPLER_H
@@ -0,0 +1,84 @@
+/**
+ * @brief Test for functions in sampler.c
+ */
+/* Includes ------------------------------------------ */
+#include "sampler.c"
+#include <assert.h>
+#include <string.h>
+/* --------------------------------------------------- */
+static void test_shuffle_Sampler();
+static void test_random_Below();
+/* --------------------------------------------------- */
+
+#define NUM_SAMPLES 1000
+
+/**
+ * @brief Function to test that every epoch visits every sample once and that the seed fixes the order
+ */
+static void test_shuffle_Sampler(){
+    struct Sampler sampler, same_Seed, other_Seed;
+    init_Sampler(&sampler, NUM_SAMPLES, 7);
+    init_Sampler(&same_Seed, NUM_SAMPLES, 7);
+    init_Sampler(&other_Seed, NUM_SAMPLES, 8);
+    for (int i = 0; i < NUM_SAMPLES; ++i){
+        assert(sampler.order[i] == i);
+    }
+
+    int previous[NUM_SAMPLES];
+    memcpy(previous, sampler.order, sizeof(previous));
+    for (int epoch = 0; epoch < 3; ++epoch){
+        shuffle_Sampler(&sampler);
+        shuffle_Sampler(&same_Seed);
+        shuffle_Sampler(&other_Seed);
+
+        int seen[NUM_SAMPLES] = {0};
+        int moved = 0;
+        for (int i = 0; i < NUM_SAMPLES; ++i){
+            assert(sampler.order[i] >= 0 && sampler.order[i] < NUM_SAMPLES);
+            seen[sampler.order[i]]++;
+            moved += sampler.order[i] != previous[i];
+        }
+        for (int i = 0; i < NUM_SAMPLES; ++i){
+            assert(seen[i] == 1);
+        }
+        // every epoch gets a new order
+        assert(moved > NUM_SAMPLES / 2);
+        assert(memcmp(sampler.order, same_Seed.order, sizeof(previous)) == 0);
+        assert(memcmp(sampler.order, other_Seed.order, sizeof(previous)) != 0);
+        memcpy(previous, sampler.order, sizeof(previous));
+    }
+
+    free_Sampler(&sampler);
+    free_Sampler(&same_Seed);
+    free_Sampler(&other_Seed);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test the range and the rough uniformity of random_Below()
+ */
+static void test_random_Below(){
+    uint64_t state = 1;
+    int counts[10] = {0};
+    for (int i = 0; i < 100000; ++i){
+        int value = random_Below(&state, 10);
+        assert(value >= 0 && value < 10);
+        counts[value]++;
+    }
+    for (int i = 0; i < 10; ++i){
+        assert(counts[i] > 9000 && counts[i] < 11000);
+    }
+    assert(random_Below(&state, 1) == 0);
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_shuffle_Sampler();
+    test_random_Below();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
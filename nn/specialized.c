@@ -0,0 +1,198 @@
+/**
+ * @file Specialized source file
+ * @brief Specialized function definitions
+ */
+
+/* Includes ------------------------------------------ */
+#include "specialized.h"
+/* --------------------------------------------------- */
+
+#if SPECIALIZED
+
+#if SPECIALIZED_NUM_LAYERS < 2 || SPECIALIZED_NUM_LAYERS > MAX_HIDDEN_LAYERS + 1
+#error "SPECIALIZE needs the input size, 1 to MAX_HIDDEN_LAYERS hidden sizes and the output size"
+#endif
+
+#define SPECIALIZED_STRING_(...) #__VA_ARGS__
+#define SPECIALIZED_STRING(...) SPECIALIZED_STRING_(__VA_ARGS__)
+
+static const int specialized_Sizes[] = {SPECIALIZE};
+
+/* Neurons whose sums are accumulated together, every input loaded is used for all of them */
+#define SPECIALIZED_TILE 4
+
+/* --------------------------------------------------- */
+/**
+ * @brief Weighted sums of one layer, the sizes are constants at every call
+ *
+ * Every row of weights starts on a WEIGHT_ALIGNMENT boundary (see struct Layer), so
+ * the rows are loaded aligned. The biases are added by the activation.
+ */
+static inline __attribute__((always_inline)) void weighted_sums(const real *restrict weights, const real *restrict inputs,
+                                                                real *restrict outputs, int num_Inputs, int num_Neurons)
+{
+    const int elements_Per_Line = WEIGHT_ALIGNMENT / sizeof(real);
+    const int stride = (num_Inputs + elements_Per_Line - 1) / elements_Per_Line * elements_Per_Line;
+
+    int j = 0;
+    for (; j + SPECIALIZED_TILE <= num_Neurons; j += SPECIALIZED_TILE){
+        const real *w0 = __builtin_assume_aligned(weights + (size_t)j * stride, WEIGHT_ALIGNMENT);
+        const real *w1 = __builtin_assume_aligned(w0 + stride, WEIGHT_ALIGNMENT);
+        const real *w2 = __builtin_assume_aligned(w1 + stride, WEIGHT_ALIGNMENT);
+        const real *w3 = __builtin_assume_aligned(w2 + stride, WEIGHT_ALIGNMENT);
+        real sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+        #pragma omp simd reduction(+:sum0, sum1, sum2, sum3)
+        for (int k = 0; k < num_Inputs; ++k){
+            sum0 += w0[k] * inputs[k];
+            sum1 += w1[k] * inputs[k];
+            sum2 += w2[k] * inputs[k];
+            sum3 += w3[k] * inputs[k];
+        }
+        outputs[j] = sum0;
+        outputs[j + 1] = sum1;
+        outputs[j + 2] = sum2;
+        outputs[j + 3] = sum3;
+    }
+    // the last neurons that do not fill a tile, their number is known at compile time too
+    for (; j < num_Neurons; ++j){
+        const real *w = __builtin_assume_aligned(weights + (size_t)j * stride, WEIGHT_ALIGNMENT);
+        real sum = 0.0;
+        #pragma omp simd reduction(+:sum)
+        for (int k = 0; k < num_Inputs; ++k){
+            sum += w[k] * inputs[k];
+        }
+        outputs[j] = sum;
+    }
+}
+
+/* --------------------------------------------------- */
+/* Weighted layer l, whose inputs are the outputs of the layer before */
+#define SPECIALIZED_LAYER(l, next)                                                                      \
+    {                                                                                                   \
+        const struct Layer *layer = get_Const_Layer(network, l);                                        \
+        weighted_sums(layer->weights, previous, outputs[l], SPECIALIZED_SIZE(l), SPECIALIZED_SIZE(next)); \
+        activation_vec(layer->activation, outputs[l], layer->biases, outputs[l], SPECIALIZED_SIZE(next)); \
+        previous = outputs[l];                                                                          \
+    }
+
+/**
+ * @brief All layers of the forward pass, instantiated once per instruction set
+ */
+static inline __attribute__((always_inline)) void forward_body(const struct Network *network, const real *inputs,
+                                                               real *const *outputs)
+{
+    const real *previous = inputs;
+    SPECIALIZED_LAYER(0, 1)
+#if SPECIALIZED_NUM_LAYERS > 1
+    SPECIALIZED_LAYER(1, 2)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 2
+    SPECIALIZED_LAYER(2, 3)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 3
+    SPECIALIZED_LAYER(3, 4)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 4
+    SPECIALIZED_LAYER(4, 5)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 5
+    SPECIALIZED_LAYER(5, 6)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 6
+    SPECIALIZED_LAYER(6, 7)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 7
+    SPECIALIZED_LAYER(7, 8)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 8
+    SPECIALIZED_LAYER(8, 9)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 9
+    SPECIALIZED_LAYER(9, 10)
+#endif
+#if SPECIALIZED_NUM_LAYERS > 10
+    SPECIALIZED_LAYER(10, 11)
+#endif
+}
+
+/* --------------------------------------------------- */
+#if defined(SIMD)
+/* Like the kernels in mathfunctions.c, the instruction set selected by set_Cpu_Level() is used */
+static void forward_sse2(const struct Network *network, const real *inputs, real *const *outputs)
+{
+    forward_body(network, inputs, outputs);
+}
+
+static __attribute__((target("avx2,fma"))) void forward_avx2(const struct Network *network, const real *inputs,
+                                                             real *const *outputs)
+{
+    forward_body(network, inputs, outputs);
+}
+
+static __attribute__((target("avx512f"))) void forward_avx512(const struct Network *network, const real *inputs,
+                                                              real *const *outputs)
+{
+    forward_body(network, inputs, outputs);
+}
+
+void forward_Specialized(const struct Network *network, const real *inputs, real *const *outputs){
+    switch (get_Cpu_Level()){
+        case CPU_LEVEL_AVX512:
+            forward_avx512(network, inputs, outputs);
+            break;
+        case CPU_LEVEL_AVX2_FMA:
+            forward_avx2(network, inputs, outputs);
+            break;
+        default:
+            forward_sse2(network, inputs, outputs);
+            break;
+    }
+}
+#else
+void forward_Specialized(const struct Network *network, const real *inputs, real *const *outputs){
+    forward_body(network, inputs, outputs);
+}
+#endif
+
+/* --------------------------------------------------- */
+int is_Specialized_Network(const struct Network *network){
+    if (network->num_Hidden_Layers != SPECIALIZED_NUM_LAYERS - 1 ||
+        network->input_Layer.num_Neurons != specialized_Sizes[0]){
+        return 0;
+    }
+    for (int l = 0; l < SPECIALIZED_NUM_LAYERS; ++l){
+        const struct Layer *layer = get_Const_Layer(network, l);
+        if (layer->num_Inputs != specialized_Sizes[l] || layer->num_Neurons != specialized_Sizes[l + 1]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+const char *get_Specialized_Topology(void){
+    return SPECIALIZED_STRING(SPECIALIZE);
+}
+
+#else  // not specialized, every network takes the generic kernels
+
+int is_Specialized_Network(const struct Network *network){
+    (void)network;
+    return 0;
+}
+
+/* --------------------------------------------------- */
+void forward_Specialized(const struct Network *network, const real *inputs, real *const *outputs){
+    (void)network;
+    (void)inputs;
+    (void)outputs;
+    fprintf(stderr, "The kernels are not specialized, build with SPECIALIZE=<sizes>!\n");
+    exit(-1);
+}
+
+/* --------------------------------------------------- */
+const char *get_Specialized_Topology(void){
+    return NULL;
+}
+#endif
+/* --------------------------------------------------- */
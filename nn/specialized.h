@@ -0,0 +1,83 @@
+/**
+ * @file Specialized header file
+ * @brief Forward kernels with the layer sizes of one topology compiled in, built with SPECIALIZE=<sizes>
+ */
+#ifndef NN_SPECIALIZED_H
+#define NN_SPECIALIZED_H
+
+/* Includes ------------------------------------------ */
+#include "network.h"
+/* --------------------------------------------------- */
+
+/*
+ * SPECIALIZE lists the neurons of every layer, input layer first, e.g. -DSPECIALIZE=784,128,10
+ * (make SPECIALIZE=784,128,10). The kernels are instantiated with these sizes as constants,
+ * so the compiler unrolls the inner loops completely and needs no remainder loops or size
+ * checks. Networks of any other topology keep the generic kernels.
+ */
+#ifdef SPECIALIZE
+#define SPECIALIZED 1
+#else
+#define SPECIALIZED 0
+#endif
+
+/* Batches up to this size are inferred one sample after the other with the specialized kernels,
+   larger ones go through gemm(), which reuses every weight it loads across the batch */
+#define SPECIALIZED_MAX_BATCH 8
+/* --------------------------------------------------- */
+
+#if SPECIALIZED
+/* Number of entries of SPECIALIZE, up to MAX_HIDDEN_LAYERS + 2 */
+#define SPECIALIZED_COUNT(...) SPECIALIZED_COUNT_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define SPECIALIZED_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+
+/* Number of weighted layers (hidden layers + output layer) of the specialized topology */
+#define SPECIALIZED_NUM_LAYERS (SPECIALIZED_COUNT(SPECIALIZE) - 1)
+
+/* Entry n of SPECIALIZE as an integer constant, n has to be a literal */
+#define SPECIALIZED_SIZE(n) SPECIALIZED_SIZE_(n, SPECIALIZE)
+#define SPECIALIZED_SIZE_(n, ...) SPECIALIZED_PICK_##n(__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)
+#define SPECIALIZED_PICK_0(a, ...) a
+#define SPECIALIZED_PICK_1(a, ...) SPECIALIZED_PICK_0(__VA_ARGS__)
+#define SPECIALIZED_PICK_2(a, ...) SPECIALIZED_PICK_1(__VA_ARGS__)
+#define SPECIALIZED_PICK_3(a, ...) SPECIALIZED_PICK_2(__VA_ARGS__)
+#define SPECIALIZED_PICK_4(a, ...) SPECIALIZED_PICK_3(__VA_ARGS__)
+#define SPECIALIZED_PICK_5(a, ...) SPECIALIZED_PICK_4(__VA_ARGS__)
+#define SPECIALIZED_PICK_6(a, ...) SPECIALIZED_PICK_5(__VA_ARGS__)
+#define SPECIALIZED_PICK_7(a, ...) SPECIALIZED_PICK_6(__VA_ARGS__)
+#define SPECIALIZED_PICK_8(a, ...) SPECIALIZED_PICK_7(__VA_ARGS__)
+#define SPECIALIZED_PICK_9(a, ...) SPECIALIZED_PICK_8(__VA_ARGS__)
+#define SPECIALIZED_PICK_10(a, ...) SPECIALIZED_PICK_9(__VA_ARGS__)
+#define SPECIALIZED_PICK_11(a, ...) SPECIALIZED_PICK_10(__VA_ARGS__)
+#endif
+/* --------------------------------------------------- */
+
+/**
+ * @brief Check whether the specialized kernels can run a network
+ * @param network pointer to the network struct
+ * @return 1 if the build is specialized and the network has exactly the compiled topology, 0 otherwise
+ */
+int is_Specialized_Network(const struct Network *network);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Forward propagate one sample with the specialized kernels
+ *
+ * Computes the same outputs as forward_propagate(), up to the rounding of a different
+ * summation order. The network is not changed.
+ *
+ * @param network pointer to a network accepted by is_Specialized_Network()
+ * @param inputs the inputs of the sample
+ * @param outputs outputs[l] receives the outputs of weighted layer l
+ */
+void forward_Specialized(const struct Network *network, const real *inputs, real *const *outputs);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the topology the kernels are specialized for
+ * @return e.g. "784,128,10", or NULL if the build is not specialized
+ */
+const char *get_Specialized_Topology(void);
+/* --------------------------------------------------- */
+
+#endif //NN_SPECIALIZED_H
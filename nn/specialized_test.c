@@ -0,0 +1,201 @@
+/**
+ * @brief Test for functions in specialized.c
+ */
+/* Includes ------------------------------------------ */
+#ifndef SPECIALIZE
+#define SPECIALIZE 37,19,6,3 // no layer fills whole registers or tiles
+#endif
+#include "layer.c"
+#include "network.c"
+#include "mathfunctions.c"
+#include "workspace.c"
+#include "specialized.c"
+#include "inference.c"
+#include <assert.h>
+
+/* Tolerance for results computed in a different order, float only keeps about 7 digits */
+#define EPSILON (sizeof(real) == sizeof(float) ? 1e-4 : 1e-12)
+/* --------------------------------------------------- */
+static void test_is_Specialized_Network();
+static void test_forward_Specialized();
+static void test_infer_Batch_specialized();
+/* --------------------------------------------------- */
+
+#define NUM_SAMPLES (SPECIALIZED_MAX_BATCH + 1)
+
+/**
+ * @brief Initialize a network with the specialized topology, random weights and biases
+ */
+static void init_Specialized_Network(struct Network *network, enum Activation hidden, enum Activation output)
+{
+    init_Network(network, specialized_Sizes[0], (int *)&specialized_Sizes[1], SPECIALIZED_NUM_LAYERS - 1,
+                 specialized_Sizes[SPECIALIZED_NUM_LAYERS]);
+    assert(set_Network_Activations(network, hidden, output));
+    for (int l = 0; l < get_Num_Weighted_Layers(network); ++l)
+    {
+        struct Layer *layer = get_Layer(network, l);
+        for (int j = 0; j < layer->num_Neurons; ++j) layer->biases[j] = (double)rand() / RAND_MAX - 0.5;
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Forward pass of one sample with the generic kernels
+ */
+static void reference_forward(const struct Network *network, const real *inputs, real **outputs)
+{
+    const real *previous = inputs;
+    for (int l = 0; l < get_Num_Weighted_Layers(network); ++l)
+    {
+        const struct Layer *layer = get_Const_Layer(network, l);
+        for (int j = 0; j < layer->num_Neurons; ++j)
+        {
+            outputs[l][j] = dotp(previous, layer->weights + (size_t)j * layer->stride, layer->num_Inputs);
+        }
+        activation_vec(layer->activation, outputs[l], layer->biases, outputs[l], layer->num_Neurons);
+        previous = outputs[l];
+    }
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that only networks of the compiled topology are specialized
+ */
+static void test_is_Specialized_Network()
+{
+    struct Network network;
+    srand(1);
+    init_Specialized_Network(&network, ACTIVATION_SIGMOID, ACTIVATION_SIGMOID);
+    assert(is_Specialized_Network(&network));
+    free_Network(&network);
+
+    int hidden_Sizes[MAX_HIDDEN_LAYERS + 1];
+    for (int l = 0; l < SPECIALIZED_NUM_LAYERS - 1; ++l) hidden_Sizes[l] = specialized_Sizes[l + 1];
+    hidden_Sizes[0] += 1;
+    init_Network(&network, specialized_Sizes[0], hidden_Sizes, SPECIALIZED_NUM_LAYERS - 1,
+                 specialized_Sizes[SPECIALIZED_NUM_LAYERS]);
+    assert(!is_Specialized_Network(&network));
+    free_Network(&network);
+
+    // the same sizes, but one hidden layer more
+    hidden_Sizes[0] -= 1;
+    hidden_Sizes[SPECIALIZED_NUM_LAYERS - 1] = specialized_Sizes[SPECIALIZED_NUM_LAYERS];
+    init_Network(&network, specialized_Sizes[0], hidden_Sizes, SPECIALIZED_NUM_LAYERS,
+                 specialized_Sizes[SPECIALIZED_NUM_LAYERS]);
+    assert(!is_Specialized_Network(&network));
+    free_Network(&network);
+
+    assert(strcmp(get_Specialized_Topology(), SPECIALIZED_STRING(SPECIALIZE)) == 0);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that the specialized kernels compute the outputs of the generic ones
+ *
+ * Every activation is checked, in the SIMD versions with every instruction set of the CPU.
+ */
+static void test_forward_Specialized()
+{
+    const enum Activation hidden[] = {ACTIVATION_SIGMOID, ACTIVATION_RELU, ACTIVATION_LEAKY_RELU, ACTIVATION_TANH};
+    const enum Activation output[] = {ACTIVATION_SIGMOID, ACTIVATION_SOFTMAX, ACTIVATION_TANH, ACTIVATION_RELU};
+    real *expected[MAX_HIDDEN_LAYERS + 1];
+    real *outputs[MAX_HIDDEN_LAYERS + 1];
+    for (int l = 0; l < SPECIALIZED_NUM_LAYERS; ++l)
+    {
+        expected[l] = alloc_Matrix(1, specialized_Sizes[l + 1]);
+        outputs[l] = alloc_Matrix(1, specialized_Sizes[l + 1]);
+    }
+    real *inputs = alloc_Matrix(1, specialized_Sizes[0]);
+
+#ifdef SIMD
+    enum Cpu_Level initial = get_Cpu_Level();
+    for (int level = CPU_LEVEL_SSE2; level <= detect_Cpu_Level(); ++level)
+    {
+        assert(set_Cpu_Level((enum Cpu_Level)level));
+#endif
+        for (int a = 0; a < 4; ++a)
+        {
+            struct Network network;
+            srand(2 + a);
+            init_Specialized_Network(&network, hidden[a], output[a]);
+            for (int i = 0; i < specialized_Sizes[0]; ++i) inputs[i] = (double)rand() / RAND_MAX;
+
+            reference_forward(&network, inputs, expected);
+            forward_Specialized(&network, inputs, outputs);
+            for (int l = 0; l < SPECIALIZED_NUM_LAYERS; ++l)
+            {
+                for (int j = 0; j < specialized_Sizes[l + 1]; ++j)
+                {
+                    assert(fabs(outputs[l][j] - expected[l][j]) < EPSILON);
+                }
+            }
+            free_Network(&network);
+        }
+#ifdef SIMD
+    }
+    set_Cpu_Level(initial);
+#endif
+
+    for (int l = 0; l < SPECIALIZED_NUM_LAYERS; ++l)
+    {
+        free(expected[l]);
+        free(outputs[l]);
+    }
+    free(inputs);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that small batches, which infer_Batch() runs specialized, match larger ones
+ */
+static void test_infer_Batch_specialized()
+{
+    struct Network network;
+    srand(7);
+    init_Specialized_Network(&network, ACTIVATION_RELU, ACTIVATION_SOFTMAX);
+
+    struct Inference_Scratch scratch;
+    init_Inference_Scratch(&scratch, &network, NUM_SAMPLES);
+    int ld_In = scratch.ld[0];
+    int ld_Out = scratch.ld[scratch.num_Layers];
+    int num_Outputs = specialized_Sizes[SPECIALIZED_NUM_LAYERS];
+    real *inputs = alloc_Matrix(NUM_SAMPLES, ld_In);
+    real *expected = alloc_Matrix(NUM_SAMPLES, ld_Out);
+    for (int s = 0; s < NUM_SAMPLES; ++s)
+    {
+        for (int i = 0; i < specialized_Sizes[0]; ++i) inputs[(size_t)s * ld_In + i] = (double)rand() / RAND_MAX;
+    }
+
+    // too many samples for the specialized kernels, this goes through gemm()
+    memcpy(expected, infer_Batch(&network, &scratch, inputs, ld_In, NUM_SAMPLES), sizeof(real) * NUM_SAMPLES * ld_Out);
+
+    for (int batch_Size = 1; batch_Size <= SPECIALIZED_MAX_BATCH; ++batch_Size)
+    {
+        const real *outputs = infer_Batch(&network, &scratch, inputs, ld_In, batch_Size);
+        for (int s = 0; s < batch_Size; ++s)
+        {
+            for (int i = 0; i < num_Outputs; ++i)
+            {
+                assert(fabs(outputs[(size_t)s * ld_Out + i] - expected[(size_t)s * ld_Out + i]) < EPSILON);
+            }
+        }
+    }
+
+    free(inputs);
+    free(expected);
+    free_Inference_Scratch(&scratch);
+    free_Network(&network);
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_is_Specialized_Network();
+    test_forward_Specialized();
+    test_infer_Batch_specialized();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */
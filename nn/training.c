@@ -5,9 +5,72 @@
 
 /* Includes ------------------------------------------ */
 #include "training.h"
+#include <omp.h>
+
+/* Defines- ------------------------------------------ */
+// Only the parallel version opens parallel regions, the others run the same code on one thread
+#if defined(PARALLEL)
+#define USE_THREADS 1
+#else
+#define USE_THREADS 0
+#endif
+
+// Neurons are split between threads in blocks of one cache line of outputs, so no two threads write the same line
+#define NEURON_BLOCK (WEIGHT_ALIGNMENT / (int)sizeof(real))
+
+static int log_Level = LOG;
+
+/* --------------------------------------------------- */
+void init_Training_Config(struct Training_Config *config)
+{
+    config->epochs = EPOCHS;
+    config->learning_rate = L_RATE;
+    config->batch_Size = BATCH_SIZE;
+    config->patience = EARLY_STOPPING_PATIENCE;
+    config->shuffle = SHUFFLE;
+    config->seed = SHUFFLE_SEED;
+    config->pipeline_Slots = PIPELINE_SLOTS;
+}
+
+/* --------------------------------------------------- */
+void set_Log_Level(int level)
+{
+    log_Level = level;
+}
+
+/* --------------------------------------------------- */
+int get_Log_Level(void)
+{
+    return log_Level;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Get the contiguous range of neurons the calling thread works on
+ *
+ * Outside of a parallel region the calling thread gets all neurons.
+ *
+ * @param num_Neurons number of neurons to split
+ * @param first first neuron of the calling thread
+ * @param count number of neurons of the calling thread, may be 0
+ */
+static void get_thread_range(int num_Neurons, int *first, int *count)
+{
+    int num_Threads = omp_get_num_threads();
+    int thread = omp_get_thread_num();
+    int num_Blocks = (num_Neurons + NEURON_BLOCK - 1) / NEURON_BLOCK;
+    int blocks_Per_Thread = (num_Blocks + num_Threads - 1) / num_Threads;
+
+    int begin = thread * blocks_Per_Thread * NEURON_BLOCK;
+    int end = (thread + 1) * blocks_Per_Thread * NEURON_BLOCK;
+    begin = (begin < num_Neurons) ? begin : num_Neurons;
+    end = (end < num_Neurons) ? end : num_Neurons;
+    *first = begin;
+    *count = end - begin;
+}
 
 /* --------------------------------------------------- */
-void forward_propagate(struct Network *network, double *inputs)
+void forward_propagate(struct Network *network, real *inputs)
 {
     /* Set inputs and outputs of input layer */
     for (int i = 0; i < network->input_Layer.num_Neurons; ++i)
@@ -28,145 +91,621 @@ void forward_propagate(struct Network *network, double *inputs)
         network->output_Layer.errors[i] = 0.0;
     }
 
+    if (SPECIALIZED && is_Specialized_Network(network))
+    {
+        real *outputs[MAX_HIDDEN_LAYERS + 1];
+        for (int l = 0; l < get_Num_Weighted_Layers(network); ++l)
+        {
+            outputs[l] = get_Layer(network, l)->outputs;
+        }
+        forward_Specialized(network, network->input_Layer.outputs, outputs);
+        return;
+    }
+
     /* Forward propagate through hidden layers */
     for (int i = 0; i < network->num_Hidden_Layers; ++i)
     {
-        for (int j = 0; j < network->hidden_Sizes[i]; ++j)
+        struct Layer *layer = &network->hidden_Layer[i];
+        const real *prev_outputs = (i > 0) ? network->hidden_Layer[i - 1].outputs : network->input_Layer.outputs;
+        /* rows are stored back to back, so the weight matrix is streamed from front to back */
+        const real *row = layer->weights;
+        for (int j = 0; j < layer->num_Neurons; ++j, row += layer->stride)
         {
-            double sum = 0.0;
-            if (i > 0)
-            {
-                sum = dotp(network->hidden_Layer[i - 1].outputs, network->hidden_Layer[i].weights[j], network->hidden_Sizes[i - 1]);
-            }
-            else
-            {
-                sum = dotp(network->input_Layer.outputs, network->hidden_Layer[i].weights[j], network->input_Layer.num_Neurons);
-            }
-            network->hidden_Layer[i].outputs[j] = sigmoid(sum);
+            layer->outputs[j] = dotp(prev_outputs, row, layer->num_Inputs);
         }
+        activation_vec(layer->activation, layer->outputs, layer->biases, layer->outputs, layer->num_Neurons);
     }
 
     /* Forward propagate through output layer */
-    for (int i = 0; i < network->output_Layer.num_Neurons; ++i)
+    const real *last_outputs = network->hidden_Layer[network->num_Hidden_Layers - 1].outputs;
+    const real *row = network->output_Layer.weights;
+    for (int i = 0; i < network->output_Layer.num_Neurons; ++i, row += network->output_Layer.stride)
     {
-        double sum;
-        sum = dotp(network->hidden_Layer[network->num_Hidden_Layers - 1].outputs, network->output_Layer.weights[i], network->hidden_Layer[network->num_Hidden_Layers - 1].num_Neurons);
-        network->output_Layer.outputs[i] = sigmoid(sum);
+        network->output_Layer.outputs[i] = dotp(last_outputs, row, network->output_Layer.num_Inputs);
     }
+    activation_vec(network->output_Layer.activation, network->output_Layer.outputs, network->output_Layer.biases,
+                   network->output_Layer.outputs, network->output_Layer.num_Neurons);
 }
 
 
 /* --------------------------------------------------- */
-void calculate_errors(struct Network *network, double *expected_output)
+void calculate_errors(struct Network *network, real *expected_output)
 {
     // Calculate output layer errors
     for (int i = 0; i < network->output_Layer.num_Neurons; ++i)
     {
-        double output = network->output_Layer.outputs[i];
-        double error = expected_output[i] - output;
-        network->output_Layer.errors[i] = error * d_sigmoid(output);
+        network->output_Layer.errors[i] = expected_output[i] - network->output_Layer.outputs[i];
     }
+    d_activation_vec(network->output_Layer.activation, network->output_Layer.outputs, network->output_Layer.errors,
+                     network->output_Layer.num_Neurons);
 
     // Calculate hidden layer errors
     for (int i = network->num_Hidden_Layers - 1; i >= 0; --i)
     {
-        for (int j = 0; j < network->hidden_Layer[i].num_Neurons; ++j)
+        struct Layer *layer = &network->hidden_Layer[i];
+        const struct Layer *next = (i == network->num_Hidden_Layers - 1) ? &network->output_Layer : &network->hidden_Layer[i + 1];
+
+        // Accumulate the weighted errors row by row instead of walking down the columns of the next layer
+        for (int j = 0; j < layer->num_Neurons; ++j)
+        {
+            layer->errors[j] = 0.0;
+        }
+        const real *row = next->weights;
+        for (int k = 0; k < next->num_Neurons; ++k, row += next->stride)
         {
-            double error = 0.0;
-            if (i == network->num_Hidden_Layers - 1)
+            real next_error = next->errors[k];
+            for (int j = 0; j < layer->num_Neurons; ++j)
             {
-                for (int k = 0; k < network->output_Layer.num_Neurons; ++k)
-                {
-                    error += network->output_Layer.errors[k] * network->output_Layer.weights[k][j];
-                }
+                layer->errors[j] += next_error * row[j];
             }
-            else
+        }
+
+        d_activation_vec(layer->activation, layer->outputs, layer->errors, layer->num_Neurons);
+    }
+}
+
+/* --------------------------------------------------- */
+void update_weights(struct Network *network, real learning_rate)
+{
+    // One optimizer step per sample
+    network->optimizer_Steps++;
+    struct Optimizer_Step step = get_Optimizer_Step(network->optimizer, learning_rate, network->optimizer_Steps);
+
+    for (int l = get_Num_Weighted_Layers(network) - 1; l >= 0; --l)
+    {
+        struct Layer *layer = get_Layer(network, l);
+        const real *prev_outputs = (l > 0) ? get_Layer(network, l - 1)->outputs : network->input_Layer.outputs;
+
+        // The gradients of the weights of a neuron are its error times the outputs of the previous layer
+        for (int j = 0; j < layer->num_Neurons; ++j)
+        {
+            optimizer_update_vec(&step, get_Weight_Row(layer, j), get_Moment_Row(layer, layer->first_Moments, j),
+                                 get_Moment_Row(layer, layer->second_Moments, j), prev_outputs, layer->errors[j],
+                                 layer->num_Inputs);
+        }
+        optimizer_update_vec(&step, layer->biases, get_Bias_Moments(layer, layer->first_Moments),
+                             get_Bias_Moments(layer, layer->second_Moments), layer->errors, 1.0, layer->num_Neurons);
+    }
+}
+
+/* --------------------------------------------------- */
+void backward_propagate(struct Network *network, real *expected_output, real learning_rate)
+{
+    // Calculate errors
+    calculate_errors(network, expected_output);
+
+    // Update weights
+    update_weights(network, learning_rate);
+}
+
+/* --------------------------------------------------- */
+void stage_Batch(struct Network *network, struct Workspace *workspace, const struct Data *data, const int *order,
+                 int first, int batch_Size)
+{
+    int ld_In = workspace->ld[0];
+    int ld_Out = workspace->ld[workspace->num_Layers];
+
+    // The raw samples are normalized and the labels one-hot encoded while they are staged,
+    // every thread gathers a contiguous run of rows
+    int num_Threads = omp_get_num_threads();
+    int per_Thread = (batch_Size + num_Threads - 1) / num_Threads;
+    int begin = omp_get_thread_num() * per_Thread;
+    begin = (begin < batch_Size) ? begin : batch_Size;
+    int end = (begin + per_Thread < batch_Size) ? begin + per_Thread : batch_Size;
+    get_Samples(data, order, first + begin, end - begin, workspace->activations[0] + (size_t)begin * ld_In, ld_In,
+                workspace->targets + (size_t)begin * ld_Out, ld_Out);
+    #pragma omp barrier
+}
+
+/* --------------------------------------------------- */
+void forward_propagate_batch(struct Network *network, struct Workspace *workspace, int batch_Size)
+{
+    for (int l = 0; l < workspace->num_Layers; ++l)
+    {
+        struct Layer *layer = get_Layer(network, l);
+        real *outputs = workspace->activations[l + 1];
+        int ld = workspace->ld[l + 1];
+
+        // Every thread computes the outputs of its own neurons for the whole batch
+        int first, count;
+        get_thread_range(layer->num_Neurons, &first, &count);
+        if (count > 0)
+        {
+            // outputs (batch x neurons) = previous activations (batch x inputs) * weights^T (inputs x neurons)
+            gemm(NO_TRANSPOSE, TRANSPOSE, batch_Size, count, layer->num_Inputs,
+                 1.0, workspace->activations[l], workspace->ld[l], get_Weight_Row(layer, first), layer->stride,
+                 0.0, outputs + first, ld);
+
+            // Softmax normalizes whole rows, it has to wait for the outputs of all threads
+            if (layer->activation != ACTIVATION_SOFTMAX)
             {
-                for (int k = 0; k < network->hidden_Layer[i + 1].num_Neurons; ++k)
+                for (int s = 0; s < batch_Size; ++s)
                 {
-                    error += network->hidden_Layer[i + 1].errors[k] * network->hidden_Layer[i + 1].weights[k][j];
+                    real *row = outputs + (size_t)s * ld + first;
+                    activation_vec(layer->activation, row, layer->biases + first, row, count);
                 }
             }
-            network->hidden_Layer[i].errors[j] = error * d_sigmoid(network->hidden_Layer[i].outputs[j]);
+        }
+        // The next layer reads the outputs of all neurons
+        #pragma omp barrier
+        if (layer->activation == ACTIVATION_SOFTMAX)
+        {
+            #pragma omp for schedule(static)
+            for (int s = 0; s < batch_Size; ++s)
+            {
+                real *row = outputs + (size_t)s * ld;
+                activation_vec(ACTIVATION_SOFTMAX, row, layer->biases, row, layer->num_Neurons);
+            }
         }
     }
 }
 
 /* --------------------------------------------------- */
-void update_weights(struct Network *network, double learning_rate)
+void calculate_errors_batch(struct Network *network, struct Workspace *workspace, int batch_Size)
 {
-    // Update output layer weights
-    for (int i = 0; i < network->output_Layer.num_Neurons; ++i)
+    int last = workspace->num_Layers - 1;
+
+    // Calculate output layer errors
+    int num_Outputs = network->output_Layer.num_Neurons;
+    int ld_Out = workspace->ld[last + 1];
+    #pragma omp for schedule(static)
+    for (int s = 0; s < batch_Size; ++s)
     {
-        for (int j = 0; j < network->hidden_Layer[network->num_Hidden_Layers - 1].num_Neurons; ++j)
+        const real *outputs = workspace->activations[last + 1] + (size_t)s * ld_Out;
+        const real *targets = workspace->targets + (size_t)s * ld_Out;
+        real *errors = workspace->errors[last] + (size_t)s * ld_Out;
+        for (int i = 0; i < num_Outputs; ++i)
         {
-            network->output_Layer.weights[i][j] += learning_rate * network->output_Layer.errors[i] * network->hidden_Layer[network->num_Hidden_Layers - 1].outputs[j];
+            errors[i] = targets[i] - outputs[i];
         }
+        d_activation_vec(network->output_Layer.activation, outputs, errors, num_Outputs);
     }
 
-    // Update hidden layer weights
-    for (int i = network->num_Hidden_Layers - 1; i >= 0; --i)
+    // Calculate hidden layer errors
+    for (int l = last - 1; l >= 0; --l)
     {
-        for (int j = 0; j < network->hidden_Layer[i].num_Neurons; ++j)
+        struct Layer *layer = get_Layer(network, l);
+        struct Layer *next = get_Layer(network, l + 1);
+        int ld = workspace->ld[l + 1];
+
+        int first, count;
+        get_thread_range(layer->num_Neurons, &first, &count);
+        if (count > 0)
         {
-            for (int k = 0; k < ((i > 0) ? network->hidden_Layer[i - 1].num_Neurons : network->input_Layer.num_Neurons); ++k)
+            // errors (batch x neurons) = next errors (batch x next neurons) * next weights (next neurons x neurons)
+            gemm(NO_TRANSPOSE, NO_TRANSPOSE, batch_Size, count, next->num_Neurons,
+                 1.0, workspace->errors[l + 1], workspace->ld[l + 2], next->weights + first, next->stride,
+                 0.0, workspace->errors[l] + first, ld);
+
+            for (int s = 0; s < batch_Size; ++s)
             {
-                network->hidden_Layer[i].weights[j][k] += learning_rate * network->hidden_Layer[i].errors[j] * ((i > 0) ? network->hidden_Layer[i - 1].outputs[k] : network->input_Layer.outputs[k]);
+                const real *outputs = workspace->activations[l + 1] + (size_t)s * ld;
+                real *errors = workspace->errors[l] + (size_t)s * ld;
+                d_activation_vec(layer->activation, outputs + first, errors + first, count);
             }
         }
+        // The previous layer reads the errors of all neurons
+        #pragma omp barrier
     }
 }
 
 /* --------------------------------------------------- */
-void backward_propagate(struct Network *network, double *expected_output, double learning_rate)
+void calculate_gradients_batch(struct Network *network, struct Workspace *workspace, int batch_Size)
 {
-    // Calculate errors
-    calculate_errors(network, expected_output);
+    for (int l = 0; l < workspace->num_Layers; ++l)
+    {
+        struct Layer *layer = get_Layer(network, l);
 
-    // Update weights
-    update_weights(network, learning_rate);
+        // Every thread computes the gradient rows of its neurons, the layers do not depend on each other
+        int first, count;
+        get_thread_range(layer->num_Neurons, &first, &count);
+        if (count == 0)
+        {
+            continue;
+        }
+
+        // gradients (neurons x inputs) = errors^T (neurons x batch) * previous activations (batch x inputs)
+        gemm(TRANSPOSE, NO_TRANSPOSE, count, layer->num_Inputs, batch_Size,
+             1.0, workspace->errors[l] + first, workspace->ld[l + 1], workspace->activations[l], workspace->ld[l],
+             0.0, workspace->gradients[l] + (size_t)first * layer->stride, layer->stride);
+
+        // bias gradients = errors summed over the batch
+        real *bias_Gradients = workspace->bias_Gradients[l];
+        for (int j = first; j < first + count; ++j)
+        {
+            bias_Gradients[j] = 0.0;
+        }
+        for (int s = 0; s < batch_Size; ++s)
+        {
+            const real *errors = workspace->errors[l] + (size_t)s * workspace->ld[l + 1];
+            for (int j = first; j < first + count; ++j)
+            {
+                bias_Gradients[j] += errors[j];
+            }
+        }
+    }
+    #pragma omp barrier
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Update the weights and biases with the summed gradients of one or more workspaces
+ *
+ * Every thread updates the weight rows and biases of its own range of neurons. The gradients
+ * of the other workspaces are added to the first one in workspace order, so the result only
+ * depends on the number of workspaces. The rows of a thread are contiguous, so the optimizer
+ * passes over them once; the padding has zero gradients and stays 0.
+ *
+ * @param network Pointer to the network struct
+ * @param workspaces Array of workspaces holding the gradients
+ * @param num_Workspaces Number of workspaces
+ * @param learning_rate The learning rate used for updating the weights
+ */
+static void apply_gradients(struct Network *network, struct Workspace *workspaces, int num_Workspaces, real learning_rate)
+{
+    struct Optimizer_Step step = get_Optimizer_Step(network->optimizer, learning_rate, network->optimizer_Steps + 1);
+    for (int l = 0; l < workspaces[0].num_Layers; ++l)
+    {
+        struct Layer *layer = get_Layer(network, l);
+        int first, count;
+        get_thread_range(layer->num_Neurons, &first, &count);
+        if (count == 0)
+        {
+            continue;
+        }
+
+        size_t offset = (size_t)first * layer->stride;
+        int size = count * layer->stride;
+        real *gradients = workspaces[0].gradients[l] + offset;
+        real *bias_Gradients = workspaces[0].bias_Gradients[l] + first;
+        for (int w = 1; w < num_Workspaces; ++w)
+        {
+            const real *other = workspaces[w].gradients[l] + offset;
+            for (int i = 0; i < size; ++i)
+            {
+                gradients[i] += other[i];
+            }
+            const real *other_Biases = workspaces[w].bias_Gradients[l] + first;
+            for (int j = 0; j < count; ++j)
+            {
+                bias_Gradients[j] += other_Biases[j];
+            }
+        }
+
+        optimizer_update_vec(&step, get_Weight_Row(layer, first), get_Moment_Row(layer, layer->first_Moments, first),
+                             get_Moment_Row(layer, layer->second_Moments, first), gradients, 1.0, size);
+        real *first_Moments = get_Bias_Moments(layer, layer->first_Moments);
+        real *second_Moments = get_Bias_Moments(layer, layer->second_Moments);
+        optimizer_update_vec(&step, layer->biases + first, first_Moments ? first_Moments + first : NULL,
+                             second_Moments ? second_Moments + first : NULL, bias_Gradients, 1.0, count);
+    }
+    // Every thread has taken the step number, the next batch reads the updated weights
+    #pragma omp barrier
+    #pragma omp single
+    {
+        // Hogwild threads count their steps in teams of one
+        #pragma omp atomic
+        network->optimizer_Steps++;
+    }
 }
 
 /* --------------------------------------------------- */
-void training(struct Network *network, int epochs, double learning_rate, double **input_data, double **output_data, int num_samples)
+void update_weights_batch(struct Network *network, struct Workspace *workspace, int batch_Size, real learning_rate)
 {
+    calculate_gradients_batch(network, workspace, batch_Size);
+    // One update per batch with the gradients summed over all samples
+    apply_gradients(network, workspace, 1, learning_rate);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Count the samples of a forward propagated batch whose largest output matches the target
+ * @param workspace Pointer to the workspace holding the batch outputs and targets
+ * @param num_Outputs Number of output neurons
+ * @param batch_Size Number of samples in the batch
+ * @return number of correct predictions among the samples of the calling thread
+ */
+static int count_correct(struct Workspace *workspace, int num_Outputs, int batch_Size)
+{
+    const real *outputs = workspace->activations[workspace->num_Layers];
+    int ld_Out = workspace->ld[workspace->num_Layers];
+    int num_correct = 0;
+
+    #pragma omp for schedule(static)
+    for (int s = 0; s < batch_Size; ++s)
+    {
+        int predicted_label = get_max_index(outputs + (size_t)s * ld_Out, num_Outputs);
+        int true_label = get_max_index(workspace->targets + (size_t)s * ld_Out, num_Outputs);
+        if (predicted_label == true_label)
+        {
+            num_correct++;
+        }
+    }
+    return num_correct;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Train on one mini-batch, in the parallel version with the neurons of every layer split between threads
+ *
+ * Without a data set the batch has to be staged in the workspace already, e.g. by a pipeline.
+ *
+ * @return number of correct predictions in the batch before the update
+ */
+static int train_batch_neuron_parallel(struct Network *network, struct Workspace *workspace, const struct Data *data,
+                                       const int *order, int first, int batch_Size, real learning_rate)
+{
+    int num_correct = 0;
+    #pragma omp parallel if(USE_THREADS) reduction(+:num_correct)
+    {
+        if (data != NULL)
+        {
+            INSTRUMENT_BEGIN(PHASE_STAGING);
+            stage_Batch(network, workspace, data, order, first, batch_Size);
+            INSTRUMENT_END(PHASE_STAGING);
+        }
+        INSTRUMENT_BEGIN(PHASE_FORWARD);
+        forward_propagate_batch(network, workspace, batch_Size);
+        num_correct += count_correct(workspace, network->output_Layer.num_Neurons, batch_Size);
+        INSTRUMENT_END(PHASE_FORWARD);
+        INSTRUMENT_BEGIN(PHASE_ERRORS);
+        calculate_errors_batch(network, workspace, batch_Size);
+        INSTRUMENT_END(PHASE_ERRORS);
+        INSTRUMENT_BEGIN(PHASE_UPDATE);
+        update_weights_batch(network, workspace, batch_Size, learning_rate);
+        INSTRUMENT_END(PHASE_UPDATE);
+    }
+    return num_correct;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Train on one mini-batch with one shard of the batch and one workspace per thread
+ *
+ * Every thread stages, propagates and computes the gradients of its own shard in its own
+ * workspace. The gradients are then reduced row by row, each thread summing its range of
+ * neurons over all workspaces in a fixed order, and added to the weights in a single update.
+ *
+ * @return number of correct predictions in the batch before the update
+ */
+static int train_batch_data_parallel(struct Network *network, struct Workspace *workspaces, int num_Workspaces,
+                                     const struct Data *data, const int *order, int first, int batch_Size, real learning_rate)
+{
+    int num_correct = 0;
+    int shard_Size = (batch_Size + num_Workspaces - 1) / num_Workspaces;
+
+    #pragma omp parallel num_threads(num_Workspaces) reduction(+:num_correct)
+    {
+        int thread = omp_get_thread_num();
+        struct Workspace *workspace = &workspaces[thread];
+        int shard_First = thread * shard_Size < batch_Size ? thread * shard_Size : batch_Size;
+        int shard_End = shard_First + shard_Size < batch_Size ? shard_First + shard_Size : batch_Size;
+        int shard = shard_End - shard_First;
+
+        // The shard belongs to this thread alone, so the batched passes run in a team of one.
+        // An empty shard still produces zero gradients.
+        #pragma omp parallel num_threads(1)
+        {
+            INSTRUMENT_BEGIN(PHASE_STAGING);
+            stage_Batch(network, workspace, data, order, first + shard_First, shard);
+            INSTRUMENT_END(PHASE_STAGING);
+            INSTRUMENT_BEGIN(PHASE_FORWARD);
+            forward_propagate_batch(network, workspace, shard);
+            num_correct += count_correct(workspace, network->output_Layer.num_Neurons, shard);
+            INSTRUMENT_END(PHASE_FORWARD);
+            INSTRUMENT_BEGIN(PHASE_ERRORS);
+            calculate_errors_batch(network, workspace, shard);
+            INSTRUMENT_END(PHASE_ERRORS);
+            INSTRUMENT_BEGIN(PHASE_UPDATE);
+            calculate_gradients_batch(network, workspace, shard);
+        }
+
+        // All gradients have to be complete before they are reduced
+        #pragma omp barrier
+        apply_gradients(network, workspaces, num_Workspaces, learning_rate);
+        INSTRUMENT_END(PHASE_UPDATE);
+    }
+    return num_correct;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Train one epoch asynchronously (Hogwild)
+ *
+ * Every thread takes a contiguous range of the samples and trains on it in mini-batches
+ * with its own workspace. The weight updates are written to the shared network without any
+ * locking, so a thread may read weights another thread is updating. Aligned real values are
+ * read and written as a whole on x86-64, so this only loses or delays some updates.
+ * Results are not reproducible with more than one thread.
+ *
+ * @return number of correct predictions over the epoch, each taken before the update of its batch
+ */
+static int train_epoch_hogwild(struct Network *network, struct Workspace *workspaces, int num_Workspaces,
+                               const struct Data *data, const int *order, int num_samples, real learning_rate)
+{
+    int num_correct = 0;
+    int range_Size = (num_samples + num_Workspaces - 1) / num_Workspaces;
+
+    #pragma omp parallel num_threads(num_Workspaces) reduction(+:num_correct)
+    {
+        int thread = omp_get_thread_num();
+        struct Workspace *workspace = &workspaces[thread];
+        int range_First = thread * range_Size < num_samples ? thread * range_Size : num_samples;
+        int range_End = range_First + range_Size < num_samples ? range_First + range_Size : num_samples;
+
+        // The range belongs to this thread alone, so the batched passes run in a team of one
+        #pragma omp parallel num_threads(1)
+        {
+            for (int batch_start = range_First; batch_start < range_End; batch_start += workspace->max_Batch)
+            {
+                int batch_Size = batch_start + workspace->max_Batch < range_End ? workspace->max_Batch : range_End - batch_start;
+
+                INSTRUMENT_BEGIN(PHASE_STAGING);
+                stage_Batch(network, workspace, data, order, batch_start, batch_Size);
+                INSTRUMENT_END(PHASE_STAGING);
+                INSTRUMENT_BEGIN(PHASE_FORWARD);
+                forward_propagate_batch(network, workspace, batch_Size);
+                num_correct += count_correct(workspace, network->output_Layer.num_Neurons, batch_Size);
+                INSTRUMENT_END(PHASE_FORWARD);
+                INSTRUMENT_BEGIN(PHASE_ERRORS);
+                calculate_errors_batch(network, workspace, batch_Size);
+                INSTRUMENT_END(PHASE_ERRORS);
+                INSTRUMENT_BEGIN(PHASE_UPDATE);
+                update_weights_batch(network, workspace, batch_Size, learning_rate);
+                INSTRUMENT_END(PHASE_UPDATE);
+            }
+        }
+    }
+    return num_correct;
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Check that the samples of a data set fit the input and output layer of a network
+ *
+ * The samples are staged into buffers sized by the network, so a data set of another width
+ * would be written past their rows.
+ *
+ * @param network Pointer to the network struct
+ * @param data The data set
+ * @return 1 if the network has one input per feature and one output per class, 0 otherwise
+ */
+static int check_data_shape(const struct Network *network, const struct Data *data)
+{
+    if (network->input_Layer.num_Neurons != data->num_Features)
+    {
+        fprintf(stderr, "Error: the network has %d inputs, but the data set has %d features\n",
+                network->input_Layer.num_Neurons, data->num_Features);
+        return 0;
+    }
+    if (network->output_Layer.num_Neurons != data->num_Classes)
+    {
+        fprintf(stderr, "Error: the network has %d outputs, but the data set has %d classes\n",
+                network->output_Layer.num_Neurons, data->num_Classes);
+        return 0;
+    }
+    return 1;
+}
+
+/* --------------------------------------------------- */
+int training(struct Network *network, const struct Training_Config *config, const struct Data *train_data, int num_samples)
+{
+    if (!check_data_shape(network, train_data))
+    {
+        return -1;
+    }
+    int max_Batch = config->batch_Size;
+    real learning_rate = config->learning_rate;
     int max_num_correct = 0;
     int patience = 0;
+
+    // The data parallel and Hogwild modes need one workspace per thread
+    int num_Workspaces = 1;
+#if defined(PARALLEL) && (TRAIN_MODE == TRAIN_DATA_PARALLEL || TRAIN_MODE == TRAIN_HOGWILD)
+    num_Workspaces = omp_get_max_threads();
+#endif
+    // Data parallel threads share a batch, Hogwild threads work on whole batches of their own
+    int shard_Size = (TRAIN_MODE == TRAIN_HOGWILD) ? max_Batch : (max_Batch + num_Workspaces - 1) / num_Workspaces;
+    struct Workspace *workspaces = (struct Workspace *)malloc(num_Workspaces * sizeof(struct Workspace));
+    if (workspaces == NULL)
+    {
+        fprintf(stderr, "Could not allocate workspaces!");
+        exit(-1);
+    }
+    for (int w = 0; w < num_Workspaces; ++w)
+    {
+        init_Workspace(&workspaces[w], network, shard_Size);
+    }
+    // The batches read the samples through the order of the sampler, the data set stays where it is
+    struct Sampler sampler;
+    init_Sampler(&sampler, num_samples, config->seed);
+    // With a single workspace a producer thread stages the next batches while one is trained on
+    int use_Pipeline = config->pipeline_Slots > 0 && num_Workspaces == 1;
+    struct Batch_Pipeline pipeline;
+    if (use_Pipeline)
+    {
+        init_Batch_Pipeline(&pipeline, &workspaces[0], config->pipeline_Slots);
+    }
+
     // Iterate through epochs
-    for (int epoch = 0; epoch < epochs; epoch++)
+    for (int epoch = 0; epoch < config->epochs; epoch++)
     {
+        if (config->shuffle)
+        {
+            shuffle_Sampler(&sampler);
+        }
         // Log epoch information
         // printf("Epoch %d\n", epoch);
+        struct Instrument_Interval interval;
+        if (INSTRUMENT)
+        {
+            start_Instrument_Interval(&interval);
+        }
         int num_correct = 0;
-        // Iterate through all samples, processing in mini-batches
-        for (int batch_start = 0; batch_start < num_samples; batch_start += BATCH_SIZE)
+        if (TRAIN_MODE == TRAIN_HOGWILD && num_Workspaces > 1)
         {
-            int batch_end = batch_start + BATCH_SIZE < num_samples ? batch_start + BATCH_SIZE : num_samples;
-
-            // Process each mini-batch
-            for (int i = batch_start; i < batch_end; i++)
+            num_correct = train_epoch_hogwild(network, workspaces, num_Workspaces, train_data, sampler.order, num_samples,
+                                              learning_rate);
+        }
+        else
+        {
+            if (use_Pipeline)
             {
-                forward_propagate(network, input_data[i]);
-                backward_propagate(network, output_data[i], learning_rate);
-
-                // Calculate accuracy on-the-fly for each epoch (with training data) in order to stop training if no improvement
-                int predictedlabel = get_predicted_label(network);
+                start_Batch_Pipeline(&pipeline, train_data, sampler.order, num_samples);
+            }
+            // Iterate through all samples, processing in mini-batches
+            for (int batch_start = 0; batch_start < num_samples; batch_start += max_Batch)
+            {
+                int batch_end = batch_start + max_Batch < num_samples ? batch_start + max_Batch : num_samples;
+                int batch_Size = batch_end - batch_start;
 
-                int true_label = 0;
-                for (int j = 0; j < network->output_Layer.num_Neurons; j++)
+                // Process the whole mini-batch at once, in the parallel version with one team of threads per batch.
+                // The accuracy is calculated on-the-fly for each epoch (with training data) in order to stop training if no improvement
+                if (num_Workspaces > 1)
                 {
-                    if (output_data[i][j] == 1.0)
-                    {
-                        true_label = j;
-                        break;
-                    }
+                    num_correct += train_batch_data_parallel(network, workspaces, num_Workspaces, train_data, sampler.order,
+                                                             batch_start, batch_Size, learning_rate);
                 }
-
-                if (predictedlabel == true_label)
+                else if (use_Pipeline)
                 {
-                    num_correct++;
+                    // the producer stages the same batches in the same order, staging is the wait for it
+                    INSTRUMENT_BEGIN(PHASE_STAGING);
+                    next_Batch(&pipeline, workspaces);
+                    INSTRUMENT_END(PHASE_STAGING);
+                    num_correct += train_batch_neuron_parallel(network, workspaces, NULL, NULL, batch_start, batch_Size,
+                                                               learning_rate);
+                }
+                else
+                {
+                    num_correct += train_batch_neuron_parallel(network, workspaces, train_data, sampler.order, batch_start,
+                                                               batch_Size, learning_rate);
                 }
             }
+            if (use_Pipeline)
+            {
+                // joins the producer of the epoch
+                next_Batch(&pipeline, workspaces);
+            }
         }
         // Calculate and log accuracy after each epoch
         double accuracy = ((double)num_correct / num_samples) * 100.0;
@@ -178,85 +717,158 @@ void training(struct Network *network, int epochs, double learning_rate, double
         else
         {
             patience++;
-            if (LOG >= 1)
+            if (log_Level >= 1)
             {
                 fprintf(stdout, "Max Num Correct = %d \nPatience = %d\n", max_num_correct, patience);
             }
         }
 
-        if (LOG >= 1)
+        if (INSTRUMENT)
+        {
+            // the record of the epoch replaces the accuracy line
+            log_Instrument_Interval(&interval, "epoch", epoch, num_samples, num_correct);
+        }
+        else if (log_Level >= 1)
         {
             printf("Accuracy after epoch %d: %.2f%% (%d/%d)\n", epoch, accuracy, num_correct, num_samples);
         }
-        if (patience > EARLY_STOPPING_PATIENCE)
+        if (patience > config->patience)
         {   
             fprintf(stdout, "==============================\n");
-            fprintf(stdout, "No progress after %d consecutive Epochs - Stopping training at epoch %d\n", EARLY_STOPPING_PATIENCE, epoch);
+            fprintf(stdout, "No progress after %d consecutive Epochs - Stopping training at epoch %d\n", config->patience, epoch);
             break;
         }
     }
+
+    for (int w = 0; w < num_Workspaces; ++w)
+    {
+        free_Workspace(&workspaces[w]);
+    }
+    if (use_Pipeline)
+    {
+        free_Batch_Pipeline(&pipeline);
+    }
+    free(workspaces);
+    free_Sampler(&sampler);
+    return 0;
 }
 
 /* --------------------------------------------------- */
-void calculate_accuracy(struct Network *network, double **values, double **labels)
+double calculate_accuracy(struct Network *network, const struct Data *test_data, int num_samples, int *confusion)
 {
+    int num_Classes = test_data->num_Classes;
+    // the samples are staged into scratch sized by the network and the predictions index the confusion matrix
+    if (!check_data_shape(network, test_data))
+    {
+        return -1.0;
+    }
+    if (num_samples > test_data->num_Rows)
+    {
+        num_samples = test_data->num_Rows;
+    }
+    if (num_samples <= 0)
+    {
+        fprintf(stderr, "Error: there are no samples to evaluate\n");
+        return -1.0;
+    }
+    int num_Cells = num_Classes * num_Classes;
+    int *counts = (int *)calloc(num_Cells, sizeof(int));
+    if (counts == NULL)
+    {
+        fprintf(stderr, "Could not allocate confusion matrix!");
+        exit(-1);
+    }
     int num_correct = 0;
-
-    for (int i = 0; i < MAX_ROWS_TEST; i++)
+    struct Instrument_Interval interval;
+    if (INSTRUMENT)
     {
-        forward_propagate(network, values[i]);
+        start_Instrument_Interval(&interval);
+    }
+    INSTRUMENT_BEGIN(PHASE_EVAL);
 
-        int predicted_label = get_predicted_label(network);
+    // Every thread evaluates whole batches with its own scratch, the counts are summed at the end
+    #pragma omp parallel if(USE_THREADS) reduction(+:num_correct, counts[:num_Cells])
+    {
+        struct Inference_Scratch scratch;
+        init_Inference_Scratch(&scratch, network, EVAL_BATCH_SIZE);
+        int predicted[EVAL_BATCH_SIZE];
 
-        int true_label = 0;
-        for (int j = 0; j < network->output_Layer.num_Neurons; j++)
+        #pragma omp for schedule(static)
+        for (int batch_start = 0; batch_start < num_samples; batch_start += EVAL_BATCH_SIZE)
         {
-            if (labels[i][j] == 1.0)
+            int batch_Size = (batch_start + EVAL_BATCH_SIZE < num_samples) ? EVAL_BATCH_SIZE : num_samples - batch_start;
+            for (int s = 0; s < batch_Size; ++s)
             {
-                true_label = j;
-                break;
+                get_Sample(test_data, batch_start + s, scratch.activations[0] + (size_t)s * scratch.ld[0], NULL);
+            }
+            predict_Batch(network, &scratch, scratch.activations[0], scratch.ld[0], batch_Size, predicted);
+
+            for (int s = 0; s < batch_Size; ++s)
+            {
+                int true_label = test_data->labels[batch_start + s];
+                if (true_label >= num_Classes)
+                {
+                    continue; // the loaders reject such labels, a sample that has one is never correct
+                }
+                counts[true_label * num_Classes + predicted[s]]++;
+                if (predicted[s] == true_label)
+                {
+                    num_correct++;
+                }
             }
         }
+        free_Inference_Scratch(&scratch);
+    }
+    INSTRUMENT_END(PHASE_EVAL);
+    if (INSTRUMENT)
+    {
+        log_Instrument_Interval(&interval, "eval", -1, num_samples, num_correct);
+    }
+
+    fprintf(stdout, "Total number of correct predictions with unseen data = %d/%d\n", num_correct, num_samples);
+    double accuracy = ((double)num_correct / num_samples) * 100.0;
+    printf("Final Accuracy [with unseen data]: %.2f%%\n", accuracy);
 
-        // Log the prediction details
-        if (LOG >= 2)
+    if (log_Level >= 1)
+    {
+        // Row c of the confusion matrix holds the predictions for the samples of class c
+        printf("Accuracy per class:");
+        for (int c = 0; c < num_Classes; c++)
         {
-            printf("Sample %d:\n", i);
-            printf("Predicted Label: %d, True Label: %d\n", predicted_label, true_label);
-            printf("Network Outputs: ");
-            for (int j = 0; j < network->output_Layer.num_Neurons; j++)
+            int num_Class_Samples = 0;
+            for (int p = 0; p < num_Classes; p++)
             {
-                printf("%f ", network->output_Layer.outputs[j]);
+                num_Class_Samples += counts[c * num_Classes + p];
             }
-            printf("\n");
+            printf(" %d: %.2f%%", c, num_Class_Samples > 0 ? 100.0 * counts[c * num_Classes + c] / num_Class_Samples : 0.0);
         }
-
-        if (predicted_label == true_label)
+        printf("\n");
+    }
+    if (log_Level >= 2)
+    {
+        printf("Confusion matrix (rows: true label, columns: predicted label):\n");
+        for (int c = 0; c < num_Classes; c++)
         {
-            num_correct++;
+            for (int p = 0; p < num_Classes; p++)
+            {
+                printf("%6d", counts[c * num_Classes + p]);
+            }
+            printf("\n");
         }
     }
-    fprintf(stdout, "Total number of correct predictions with unseen data = %d/%d\n", num_correct, MAX_ROWS_TEST);
-    double accuracy = ((double)num_correct / MAX_ROWS_TEST) * 100.0;
-    printf("Final Accuracy [with unseen data]: %.2f%%\n", accuracy);
+
+    if (confusion != NULL)
+    {
+        memcpy(confusion, counts, num_Cells * sizeof(int));
+    }
+    free(counts);
+    return accuracy;
 }
 
 /* --------------------------------------------------- */
 int get_predicted_label(struct Network *network)
 {
-    int max_index = 0;
-    double max_output = network->output_Layer.outputs[0];
-
-    for (int i = 1; i < network->output_Layer.num_Neurons; ++i)
-    {
-        if (network->output_Layer.outputs[i] > max_output)
-        {
-            max_output = network->output_Layer.outputs[i];
-            max_index = i;
-        }
-    }
-
-    return max_index;
+    return get_max_index(network->output_Layer.outputs, network->output_Layer.num_Neurons);
 }
 
 /* --------------------------------------------------- */
@@ -264,10 +876,11 @@ void print_layer_weights(struct Layer *layer)
 {
     for (int i = 0; i < layer->num_Neurons; ++i)
     {
+        const real *row = get_Weight_Row(layer, i);
         fprintf(stdout, "Neuron %d Weights: ", i + 1);
-        for (int j = 0; j < layer->num_Neurons; ++j)
+        for (int j = 0; j < layer->num_Inputs; ++j)
         {
-            fprintf(stdout, "%f ", layer->weights[i][j]);
+            fprintf(stdout, "%f ", row[j]);
         }
         fprintf(stdout, "\n");
     }
@@ -8,20 +8,66 @@
 /* Includes ------------------------------------------ */
 #include "mathfunctions.h"
 #include "network.h"
+#include "workspace.h"
+#include "inference.h"
 #include "mnist.h"
+#include "sampler.h"
+#include "pipeline.h"
+#include "instrument.h"
+#include "specialized.h"
 /* --------------------------------------------------- */
 
+/**
+ * @struct Training_Config
+ * @brief Hyperparameters of training() that are chosen at runtime
+ *
+ * init_Training_Config() fills in the defaults of net_parameters.h, main.c overrides them
+ * from the config file and the command line.
+ */
+struct Training_Config {
+    int epochs;             /**< Maximum number of epochs */
+    double learning_rate;   /**< Step size of the optimizer */
+    int batch_Size;         /**< Samples per mini-batch */
+    int patience;           /**< Epochs without improvement before training stops early */
+    int shuffle;            /**< Whether the samples are visited in a new random order every epoch */
+    uint64_t seed;          /**< Seed of the random order, the same seed gives the same epochs */
+    int pipeline_Slots;     /**< Batches a producer thread stages ahead of training, 0 for none */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Fill a training configuration with the defaults of net_parameters.h
+ * @param config pointer to the configuration
+ */
+void init_Training_Config(struct Training_Config *config);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Set how much training() and calculate_accuracy() print
+ * @param level 0 = no logs, 1 = accuracy each epoch, 2 = accuracy + weights before and after training
+ */
+void set_Log_Level(int level);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Get the log level, LOG of net_parameters.h unless it was set
+ * @return the log level
+ */
+int get_Log_Level(void);
+/* --------------------------------------------------- */
 
 /**
  * @brief Predict output data with given input data
  *
  * This function defines the forward propagation or inference,
  * which is the 1st step of training an artificial neuronal network.
+ * A network with the topology the build is specialized for (see specialized.h)
+ * runs the specialized kernels.
  *
  * @param network Pointer to the network struct
  * @param inputs The data set that is going to be input in the network
  */
-void forward_propagate(struct Network *network, double *inputs);
+void forward_propagate(struct Network *network, real *inputs);
 /* --------------------------------------------------- */
 
 /**
@@ -35,23 +81,112 @@ void forward_propagate(struct Network *network, double *inputs);
  * @param expected_output The expected output data set
  * @param learning_rate The learning rate used for weight updates
  */
-void backward_propagate(struct Network *network, double *expected_output, double learning_rate);
+void backward_propagate(struct Network *network, real *expected_output, real learning_rate);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Copy a mini-batch of samples into the workspace
+ *
+ * Row s of the staged input matrix receives the normalized values of sample `order[first + s]`,
+ * or of sample `first + s` without an order, and row s of the target matrix its one-hot encoded
+ * label. The samples are gathered from anywhere in the data set into the dense, aligned input
+ * matrix the GEMM kernels read.
+ *
+ * @param network Pointer to the network struct
+ * @param workspace Pointer to the workspace the batch is staged in
+ * @param data The data set
+ * @param order Indices of the samples in the order they are trained on, e.g. a Sampler's, or NULL for file order
+ * @param first Position of the first sample of the batch in the order
+ * @param batch_Size Number of samples in the batch, at most workspace->max_Batch
+ *
+ * The batched functions can be called by every thread of a parallel region, in which case
+ * the threads share the work and synchronize before returning.
+ */
+void stage_Batch(struct Network *network, struct Workspace *workspace, const struct Data *data, const int *order,
+                 int first, int batch_Size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Forward propagate a staged mini-batch
+ *
+ * Each layer computes the outputs of all samples with one matrix-matrix product
+ * of the previous activations and its transposed weights. Inside a parallel region
+ * every thread computes the outputs of its own range of neurons.
+ *
+ * @param network Pointer to the network struct
+ * @param workspace Pointer to the workspace holding the staged batch
+ * @param batch_Size Number of samples in the batch
+ */
+void forward_propagate_batch(struct Network *network, struct Workspace *workspace, int batch_Size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Calculate the errors of every layer for a forward propagated mini-batch
+ *
+ * @param network Pointer to the network struct
+ * @param workspace Pointer to the workspace holding the batch activations and targets
+ * @param batch_Size Number of samples in the batch
+ */
+void calculate_errors_batch(struct Network *network, struct Workspace *workspace, int batch_Size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Calculate the weight gradients of a mini-batch
+ *
+ * The gradient of every layer is the product of its transposed errors and the
+ * activations of the previous layer, summed over all samples of the batch, and is
+ * stored in workspace->gradients. The summed errors are the gradients of the biases.
+ *
+ * @param network Pointer to the network struct
+ * @param workspace Pointer to the workspace holding the batch activations and errors
+ * @param batch_Size Number of samples in the batch, 0 gives zero gradients
+ */
+void calculate_gradients_batch(struct Network *network, struct Workspace *workspace, int batch_Size);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Accumulate the weight gradients over a mini-batch and update the weights once
+ *
+ * The gradient of every layer is the product of its transposed errors and the
+ * activations of the previous layer, summed over all samples of the batch.
+ * The weights and biases are updated with the optimizer of the network.
+ * Inside a parallel region every thread updates the weight rows of its own range of neurons.
+ *
+ * @param network Pointer to the network struct
+ * @param workspace Pointer to the workspace holding the batch activations and errors
+ * @param batch_Size Number of samples in the batch
+ * @param learning_rate The learning rate used for updating the weights
+ */
+void update_weights_batch(struct Network *network, struct Workspace *workspace, int batch_Size, real learning_rate);
 /* --------------------------------------------------- */
 
 /**
  * @brief Train the neural network
  *
- * This function trains the neural network over a specified number of epochs,
- * using the given input and output data sets, and a specified learning rate.
+ * This function trains the neural network over at most config->epochs epochs
+ * on the given data set, with the learning rate of the configuration.
+ * The samples are processed in mini-batches of config->batch_Size samples and the weights
+ * are updated once per mini-batch. The parallel version opens one parallel region
+ * per mini-batch. With TRAIN_MODE == TRAIN_NEURON_PARALLEL the threads split the neurons
+ * of every layer. With TRAIN_MODE == TRAIN_DATA_PARALLEL every thread processes its own
+ * shard of the batch in a private workspace and the gradients are reduced in a fixed
+ * order before the single update, so results are deterministic for a fixed thread count.
+ * With TRAIN_MODE == TRAIN_HOGWILD every thread trains on its own range of the samples
+ * and updates the shared weights without synchronization.
+ * With config->shuffle the samples are visited in a new random order every epoch, drawn from
+ * config->seed, otherwise in file order.
+ * With a single workspace and config->pipeline_Slots > 0 a producer thread stages up to that many
+ * batches ahead while the current one is trained on.
+ * Training stops early after config->patience epochs without an improvement of the accuracy.
  *
  * @param network Pointer to the network struct
- * @param epochs The number of training epochs
- * @param learning_rate The learning rate used for training
- * @param input_data The input data set for training
- * @param output_data The output data set for training
- * @param num_samples The number of samples in the data sets
+ * @param config The hyperparameters of the training
+ * @param train_data The data set for training
+ * @param num_samples The number of samples of the data set to train on
+ * @return 0 on success, -1 if the network does not have one input per feature and one output
+ * per class of the data set, nothing is trained then
  */
-void training(struct Network *network, int epochs, double learning_rate, double **input_data, double **output_data, int num_samples);
+int training(struct Network *network, const struct Training_Config *config, const struct Data *train_data, int num_samples);
 /* --------------------------------------------------- */
 
 /**
@@ -70,13 +205,20 @@ int get_predicted_label(struct Network *network);
  * @brief Calculate the accuracy of the network
  *
  * This function calculates the accuracy of the network by comparing the
- * network's predicted outputs with the true labels.
+ * network's predicted outputs with the true labels. The samples are evaluated in
+ * batches of EVAL_BATCH_SIZE with the read-only inference API, in the parallel
+ * version the batches are shared between the threads. The confusion matrix and the
+ * accuracy of every class are gathered in the same pass.
  *
- * @param network Pointer to the network struct
- * @param values The input data set for testing
- * @param labels The true labels for the input data set
+ * @param network Pointer to the network struct, it is not changed
+ * @param test_data The data set for testing
+ * @param num_samples The number of samples of the data set to evaluate, at most its number of rows
+ * @param confusion Array of num_Classes x num_Classes counts receiving the confusion matrix,
+ * row = true label, column = predicted label, or NULL
+ * @return The accuracy in percent, or -1.0 if the network does not have one input per feature
+ * and one output per class of the data set or there are no samples, nothing is evaluated then
  */
-void calculate_accuracy(struct Network *network, double **values, double **labels);
+double calculate_accuracy(struct Network *network, const struct Data *test_data, int num_samples, int *confusion);
 /* --------------------------------------------------- */
 
 /**
@@ -90,20 +232,20 @@ void calculate_accuracy(struct Network *network, double **values, double **label
  * @param network Pointer to the network struct
  * @param expected_output The expected output data set
  */
-void calculate_errors(struct Network *network, double *expected_output);
+void calculate_errors(struct Network *network, real *expected_output);
 /* --------------------------------------------------- */
 
 /**
  * @brief Update the network's weights during training
  *
  * This function updates the weights of the neural network during the
- * training process. The weights are adjusted based on the calculated
- * errors and the learning rate.
+ * training process. The weights and biases are adjusted based on the calculated
+ * errors and the learning rate, with one step of the optimizer of the network.
  *
  * @param network Pointer to the network struct
  * @param learning_rate The learning rate used for updating the weights
  */
-void update_weights(struct Network *network, double learning_rate);
+void update_weights(struct Network *network, real learning_rate);
 /* --------------------------------------------------- */
 
 /**
@@ -5,9 +5,19 @@
 #include "layer.c"
 #include "network.c"
 #include "mathfunctions.c"
+#include "workspace.c"
+#include "mnist.c"
+#include "sampler.c"
+#include "pipeline.c"
+#include "instrument.c"
+#include "specialized.c"
 #include "training.c"
+#include "inference.c"
 #include <assert.h>
 
+/* Tolerance for results computed in a different order, float only keeps about 7 digits */
+#define EPSILON (sizeof(real) == sizeof(float) ? 1e-4 : 1e-12)
+
 #define EPOCH 100
 #define L_RATE 0.001
 
@@ -15,6 +25,69 @@
 void test_forward_propagation();
 void test_back_propagation();
 void test_training();
+void test_forward_propagate_batch();
+void test_stage_Batch_shuffled();
+void test_update_weights_batch();
+void test_batch_in_parallel_region();
+void test_train_batch_data_parallel();
+void test_train_epoch_hogwild();
+void test_calculate_accuracy();
+void test_calculate_accuracy_mismatch();
+void test_activations_batch();
+void test_optimizers();
+void test_training_config();
+void test_training_mismatch();
+
+/* --------------------------------------------------- */
+/* Topology shared by the batch tests: 3 inputs, hidden layers of 4 and 3 neurons, 2 outputs */
+static int batch_hidden_Sizes[] = {4, 3};
+static uint8_t batch_pixels[5][3] = {
+    {25, 230, 76},
+    {128, 51, 204},
+    {0, 255, 0},
+    {179, 102, 153},
+    {51, 76, 230}
+};
+static uint8_t batch_labels[5] = {0, 1, 0, 1, 1};
+
+static struct Data init_batch_data()
+{
+    struct Data data = init_Data(5, 3, 2);
+    memcpy(data.pixels, batch_pixels, sizeof(batch_pixels));
+    memcpy(data.labels, batch_labels, sizeof(batch_labels));
+    return data;
+}
+
+/* Random samples with 6 features and one of 3 classes */
+static struct Data init_random_data(int num_rows)
+{
+    struct Data data = init_Data(num_rows, 6, 3);
+    for (int s = 0; s < num_rows; ++s)
+    {
+        for (int i = 0; i < 6; ++i) data.pixels[s * 6 + i] = rand() % 256;
+        data.labels[s] = s % 3;
+    }
+    return data;
+}
+
+static void init_batch_network(struct Network *network)
+{
+    srand(42); // identical weights for every call
+    init_Network(network, 3, batch_hidden_Sizes, 2, 2);
+    // start away from saturation so the errors are not vanishingly small
+    for (int l = 0; l < get_Num_Weighted_Layers(network); ++l)
+    {
+        struct Layer *layer = get_Layer(network, l);
+        for (int j = 0; j < layer->num_Neurons; ++j)
+        {
+            for (int k = 0; k < layer->num_Inputs; ++k)
+            {
+                get_Weight_Row(layer, j)[k] -= 0.5;
+            }
+            layer->biases[j] = 0.1 * (j + 1) * ((l % 2 == 0) ? 1 : -1);
+        }
+    }
+}
 
 /* --------------------------------------------------- */
 void test_forward_propagation()
@@ -27,32 +100,32 @@ void test_forward_propagation()
 
     init_Network(&network, input_Size, hidden_Sizes, num_Hidden_Layers, output_Size);
 
-    double inputs[4][3] = {
+    real inputs[4][3] = {
         {0.0, 0.0, 1.0},
         {0.0, 1.0, 1.0},
         {1.0, 0.0, 1.0},
         {1.0, 1.0, 1.0}
     };
-    double expected_outputs[] = {0.0, 1.0, 1.0, 0.0};
+    real expected_outputs[] = {0.0, 1.0, 1.0, 0.0};
 
     // Setting weights manually
-    network.hidden_Layer[0].weights[0][0] = 2.0;
-    network.hidden_Layer[0].weights[0][1] = 2.0;
-    network.hidden_Layer[0].weights[0][2] = -3.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[0] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[1] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[2] = -3.0;
 
-    network.hidden_Layer[0].weights[1][0] = -2.0;
-    network.hidden_Layer[0].weights[1][1] = -2.0;
-    network.hidden_Layer[0].weights[1][2] = 3.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[0] = -2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[1] = -2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[2] = 3.0;
 
-    network.output_Layer.weights[0][0] = 2.0;
-    network.output_Layer.weights[0][1] = -3.0;
-    network.output_Layer.weights[0][2] = 2.0;
+    get_Weight_Row(&network.output_Layer, 0)[0] = 2.0;
+    get_Weight_Row(&network.output_Layer, 0)[1] = -3.0;
+    get_Weight_Row(&network.output_Layer, 0)[2] = 2.0;
 
     for (int i = 0; i < 4; ++i)
     {
         forward_propagate(&network, inputs[i]);
 
-        double output = network.output_Layer.outputs[0];
+        real output = network.output_Layer.outputs[0];
         printf("Test Case %d: Input: %f, %f -> Predicted: %f, Expected: %f\n",
                i + 1, inputs[i][0], inputs[i][1], output, expected_outputs[i]);
     }
@@ -70,26 +143,26 @@ void test_back_propagation()
 
     init_Network(&network, input_Size, hidden_Sizes, num_Hidden_Layers, output_Size);
 
-    double inputs[4][3] = {
+    real inputs[4][3] = {
         {0.0, 0.0, 1.0}, // Adding bias
         {0.0, 1.0, 1.0}, // Adding bias
         {1.0, 0.0, 1.0}, // Adding bias
         {1.0, 1.0, 1.0}  // Adding bias
     };
-    double expected_outputs[] = {0.0, 1.0, 1.0, 0.0};
+    real expected_outputs[] = {0.0, 1.0, 1.0, 0.0};
 
     // Setting weights manually
-    network.hidden_Layer[0].weights[0][0] = 2.0;
-    network.hidden_Layer[0].weights[0][1] = 2.0;
-    network.hidden_Layer[0].weights[0][2] = -3.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[0] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[1] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[2] = -3.0;
 
-    network.hidden_Layer[0].weights[1][0] = -2.0;
-    network.hidden_Layer[0].weights[1][1] = -2.0;
-    network.hidden_Layer[0].weights[1][2] = 3.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[0] = -2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[1] = -2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[2] = 3.0;
 
-    network.output_Layer.weights[0][0] = 2.0;
-    network.output_Layer.weights[0][1] = -3.0;
-    network.output_Layer.weights[0][2] = 2.0;
+    get_Weight_Row(&network.output_Layer, 0)[0] = 2.0;
+    get_Weight_Row(&network.output_Layer, 0)[1] = -3.0;
+    get_Weight_Row(&network.output_Layer, 0)[2] = 2.0;
 
     // Training XOR with backpropagation
     for (int epoch = 0; epoch < EPOCH; ++epoch)
@@ -106,7 +179,7 @@ void test_back_propagation()
     {
         forward_propagate(&network, inputs[i]);
 
-        double output = network.output_Layer.outputs[0];
+        real output = network.output_Layer.outputs[0];
         printf("Test Case %d: Input: %f, %f -> Predicted: %f, Expected: %f\n",
                i + 1, inputs[i][0], inputs[i][1], output, expected_outputs[i]);
     }
@@ -124,13 +197,13 @@ void test_training()
 
     init_Network(&network, input_Size, hidden_Sizes, num_Hidden_Layers, output_Size);
 
-    double inputs[4][2] = {
+    real inputs[4][2] = {
         {0.0, 0.0},
         {0.0, 1.0},
         {1.0, 0.0},
         {1.0, 1.0}
     };
-    double expected_outputs[4][1] = {
+    real expected_outputs[4][1] = {
         {0.0},
         {1.0},
         {1.0},
@@ -138,42 +211,39 @@ void test_training()
     };
 
     // Setting weights manually
-    network.hidden_Layer[0].weights[0][0] = 2.0;
-    network.hidden_Layer[0].weights[0][1] = 2.0;
-    network.hidden_Layer[0].weights[0][2] = -3.0;
-
-    network.hidden_Layer[0].weights[1][0] = -2.0;
-    network.hidden_Layer[0].weights[1][1] = -2.0;
-    network.hidden_Layer[0].weights[1][2] = 3.0;
-
-    network.output_Layer.weights[0][0] = 2.0;
-    network.output_Layer.weights[0][1] = -3.0;
-    network.output_Layer.weights[0][2] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[0] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[1] = 2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 0)[2] = -3.0;
 
+    get_Weight_Row(&network.hidden_Layer[0], 1)[0] = -2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[1] = -2.0;
+    get_Weight_Row(&network.hidden_Layer[0], 1)[2] = 3.0;
 
-    // Test with validation set
-    double validation_inputs[4][2] = {
-        {0.0, 0.0},
-        {0.0, 1.0},
-        {1.0, 0.0},
-        {1.0, 1.0}
-    };
-    double validation_outputs[4][1] = {
-        {0.0},
-        {1.0},
-        {1.0},
-        {0.0}
-    };
+    get_Weight_Row(&network.output_Layer, 0)[0] = 2.0;
+    get_Weight_Row(&network.output_Layer, 0)[1] = -3.0;
+    get_Weight_Row(&network.output_Layer, 0)[2] = 2.0;
 
 
+    // Train on the XOR truth table, the label is the index of the active output
+    struct Data training_data = init_Data(4, 2, 1);
+    for (int i = 0; i < 4; ++i)
+    {
+        training_data.pixels[2 * i] = inputs[i][0] * 255;
+        training_data.pixels[2 * i + 1] = inputs[i][1] * 255;
+        training_data.labels[i] = expected_outputs[i][0] == 1.0 ? 0 : 1;
+    }
 
-    training(&network, EPOCHS,L_RATE,validation_inputs,validation_outputs,4);
+    struct Training_Config config;
+    init_Training_Config(&config);
+    config.learning_rate = L_RATE;
+    training(&network, &config, &training_data, 4);
+    free_Data(&training_data);
     // Testing after training
     for (int i = 0; i < 4; ++i)
     {
         forward_propagate(&network, inputs[i]);
 
-        double output = network.output_Layer.outputs[0];
+        real output = network.output_Layer.outputs[0];
         printf("Test Case %d: Input: %f, %f -> Predicted: %f, Expected: %f\n",
                i + 1, inputs[i][0], inputs[i][1], output, expected_outputs[i][0]);
 
@@ -184,14 +254,663 @@ void test_training()
     free_Network(&network);
 }
 
+/* --------------------------------------------------- */
+void test_forward_propagate_batch()
+{
+    struct Network network;
+    init_batch_network(&network);
+    struct Data data = init_batch_data();
+
+    struct Workspace workspace;
+    init_Workspace(&workspace, &network, 5);
+    stage_Batch(&network, &workspace, &data, NULL, 0, 5);
+    forward_propagate_batch(&network, &workspace, 5);
+
+    // The first hidden layer computes sigmoid(weights * inputs + biases)
+    const real *hidden = workspace.activations[1];
+    const real *staged = workspace.activations[0];
+    for (int j = 0; j < network.hidden_Layer[0].num_Neurons; ++j)
+    {
+        real sum = network.hidden_Layer[0].biases[j];
+        for (int k = 0; k < 3; ++k)
+        {
+            sum += get_Weight_Row(&network.hidden_Layer[0], j)[k] * staged[k];
+        }
+        assert(fabs(hidden[j] - sigmoid(sum)) < SIGMOID_VEC_MAX_ERROR);
+    }
+
+    // Every row of the batch matches a single sample forward pass
+    const real *outputs = workspace.activations[workspace.num_Layers];
+    real values[3];
+    for (int s = 0; s < 5; ++s)
+    {
+        get_Sample(&data, s, values, NULL);
+        forward_propagate(&network, values);
+        for (int i = 0; i < 2; ++i)
+        {
+            assert(fabs(outputs[s * workspace.ld[workspace.num_Layers] + i] - network.output_Layer.outputs[i]) < EPSILON);
+        }
+    }
+
+    free_Workspace(&workspace);
+    free_Data(&data);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+void test_stage_Batch_shuffled()
+{
+    struct Network network;
+    init_batch_network(&network);
+    struct Data data = init_batch_data();
+    struct Sampler sampler;
+    init_Sampler(&sampler, 5, 3);
+    shuffle_Sampler(&sampler);
+
+    // The second batch of 3 samples in shuffled order, only 2 are left
+    struct Workspace workspace;
+    init_Workspace(&workspace, &network, 3);
+    stage_Batch(&network, &workspace, &data, sampler.order, 3, 2);
+
+    int ld_In = workspace.ld[0];
+    int ld_Out = workspace.ld[workspace.num_Layers];
+    real values[3], labels[2];
+    for (int s = 0; s < 2; ++s)
+    {
+        get_Sample(&data, sampler.order[3 + s], values, labels);
+        assert(memcmp(workspace.activations[0] + s * ld_In, values, sizeof(values)) == 0);
+        assert(memcmp(workspace.targets + s * ld_Out, labels, sizeof(labels)) == 0);
+    }
+
+    free_Workspace(&workspace);
+    free_Sampler(&sampler);
+    free_Data(&data);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+void test_update_weights_batch()
+{
+    struct Network network;
+    init_batch_network(&network);
+    struct Data data = init_batch_data();
+
+    // Reference: the sum of the single sample updates, each computed from the initial weights
+    real expected_delta[3][4 * 8] = {{0.0}};
+    real expected_bias_delta[3][4] = {{0.0}};
+    for (int s = 0; s < 5; ++s)
+    {
+        struct Network reference;
+        init_batch_network(&reference);
+        real values[3], labels[2];
+        get_Sample(&data, s, values, labels);
+        forward_propagate(&reference, values);
+        backward_propagate(&reference, labels, 0.5);
+        for (int l = 0; l < 3; ++l)
+        {
+            struct Layer *updated = get_Layer(&reference, l);
+            struct Layer *initial = get_Layer(&network, l);
+            for (int j = 0; j < updated->num_Neurons; ++j)
+            {
+                for (int k = 0; k < updated->num_Inputs; ++k)
+                {
+                    expected_delta[l][j * updated->num_Inputs + k] += get_Weight_Row(updated, j)[k] - get_Weight_Row(initial, j)[k];
+                }
+                expected_bias_delta[l][j] += updated->biases[j] - initial->biases[j];
+            }
+        }
+        free_Network(&reference);
+    }
+
+    struct Network batched;
+    init_batch_network(&batched);
+    struct Workspace workspace;
+    init_Workspace(&workspace, &batched, 5);
+    stage_Batch(&batched, &workspace, &data, NULL, 0, 5);
+    forward_propagate_batch(&batched, &workspace, 5);
+    calculate_errors_batch(&batched, &workspace, 5);
+    update_weights_batch(&batched, &workspace, 5, 0.5);
+
+    for (int l = 0; l < 3; ++l)
+    {
+        struct Layer *updated = get_Layer(&batched, l);
+        struct Layer *initial = get_Layer(&network, l);
+        for (int j = 0; j < updated->num_Neurons; ++j)
+        {
+            for (int k = 0; k < updated->num_Inputs; ++k)
+            {
+                real delta = get_Weight_Row(updated, j)[k] - get_Weight_Row(initial, j)[k];
+                assert(fabs(delta - expected_delta[l][j * updated->num_Inputs + k]) < EPSILON);
+            }
+            real bias_delta = updated->biases[j] - initial->biases[j];
+            assert(bias_delta != 0.0);
+            assert(fabs(bias_delta - expected_bias_delta[l][j]) < EPSILON);
+        }
+    }
+
+    free_Workspace(&workspace);
+    free_Data(&data);
+    free_Network(&batched);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+void test_batch_in_parallel_region()
+{
+    // Layers wider than one block of neurons, so that several threads get work
+    int hidden_Sizes[] = {20, 12};
+    struct Network single, team;
+    srand(7);
+    init_Network(&single, 6, hidden_Sizes, 2, 3);
+    srand(7);
+    init_Network(&team, 6, hidden_Sizes, 2, 3);
+
+    struct Data data = init_random_data(7);
+
+    struct Workspace workspace_single, workspace_team;
+    init_Workspace(&workspace_single, &single, 7);
+    init_Workspace(&workspace_team, &team, 7);
+
+    // Two batches, so the second one runs on weights updated by the team
+    for (int batch = 0; batch < 2; ++batch)
+    {
+        stage_Batch(&single, &workspace_single, &data, NULL, 0, 7);
+        forward_propagate_batch(&single, &workspace_single, 7);
+        calculate_errors_batch(&single, &workspace_single, 7);
+        update_weights_batch(&single, &workspace_single, 7, 0.1);
+
+        #pragma omp parallel num_threads(3)
+        {
+            stage_Batch(&team, &workspace_team, &data, NULL, 0, 7);
+            forward_propagate_batch(&team, &workspace_team, 7);
+            calculate_errors_batch(&team, &workspace_team, 7);
+            update_weights_batch(&team, &workspace_team, 7, 0.1);
+        }
+    }
+
+    for (int l = 0; l < 3; ++l)
+    {
+        struct Layer *a = get_Layer(&single, l);
+        struct Layer *b = get_Layer(&team, l);
+        for (int j = 0; j < a->num_Neurons; ++j)
+        {
+            for (int k = 0; k < a->num_Inputs; ++k)
+            {
+                assert(fabs(get_Weight_Row(a, j)[k] - get_Weight_Row(b, j)[k]) < EPSILON);
+            }
+        }
+    }
+
+    free_Workspace(&workspace_single);
+    free_Workspace(&workspace_team);
+    free_Data(&data);
+    free_Network(&single);
+    free_Network(&team);
+}
+
+/* --------------------------------------------------- */
+void test_train_batch_data_parallel()
+{
+    int hidden_Sizes[] = {20, 12};
+    struct Network single, sharded[2];
+    srand(9);
+    init_Network(&single, 6, hidden_Sizes, 2, 3);
+    for (int n = 0; n < 2; ++n)
+    {
+        srand(9);
+        init_Network(&sharded[n], 6, hidden_Sizes, 2, 3);
+    }
+
+    struct Data data = init_random_data(7);
+
+    // 7 samples on 3 threads give shards of 3, 3 and 1 samples
+    struct Workspace workspace_single, workspaces[2][3];
+    init_Workspace(&workspace_single, &single, 7);
+    for (int n = 0; n < 2; ++n)
+    {
+        for (int w = 0; w < 3; ++w) init_Workspace(&workspaces[n][w], &sharded[n], 3);
+    }
+
+    for (int batch = 0; batch < 2; ++batch)
+    {
+        int correct = train_batch_neuron_parallel(&single, &workspace_single, &data, NULL, 0, 7, 0.1);
+        for (int n = 0; n < 2; ++n)
+        {
+            assert(train_batch_data_parallel(&sharded[n], workspaces[n], 3, &data, NULL, 0, 7, 0.1) == correct);
+        }
+    }
+
+    for (int l = 0; l < 3; ++l)
+    {
+        struct Layer *a = get_Layer(&single, l);
+        struct Layer *b = get_Layer(&sharded[0], l);
+        struct Layer *c = get_Layer(&sharded[1], l);
+        for (int j = 0; j < a->num_Neurons; ++j)
+        {
+            for (int k = 0; k < a->num_Inputs; ++k)
+            {
+                // same update as one thread up to the summation order ...
+                assert(fabs(get_Weight_Row(a, j)[k] - get_Weight_Row(b, j)[k]) < EPSILON);
+                // ... and bit for bit reproducible with the same number of threads
+                assert(get_Weight_Row(b, j)[k] == get_Weight_Row(c, j)[k]);
+            }
+        }
+    }
+
+    free_Workspace(&workspace_single);
+    free_Data(&data);
+    free_Network(&single);
+    for (int n = 0; n < 2; ++n)
+    {
+        for (int w = 0; w < 3; ++w) free_Workspace(&workspaces[n][w]);
+        free_Network(&sharded[n]);
+    }
+}
+
+/* --------------------------------------------------- */
+void test_train_epoch_hogwild()
+{
+    int hidden_Sizes[] = {20, 12};
+    srand(11);
+    struct Data data = init_random_data(10);
+
+    // With one thread Hogwild is plain mini-batch training over the samples in order
+    struct Network single, hogwild;
+    srand(12);
+    init_Network(&single, 6, hidden_Sizes, 2, 3);
+    srand(12);
+    init_Network(&hogwild, 6, hidden_Sizes, 2, 3);
+    struct Workspace workspace_single, workspace_hogwild;
+    init_Workspace(&workspace_single, &single, 4);
+    init_Workspace(&workspace_hogwild, &hogwild, 4);
+
+    int correct = 0;
+    for (int batch_start = 0; batch_start < 10; batch_start += 4)
+    {
+        int batch_Size = batch_start + 4 < 10 ? 4 : 10 - batch_start;
+        correct += train_batch_neuron_parallel(&single, &workspace_single, &data, NULL, batch_start, batch_Size, 0.1);
+    }
+    assert(train_epoch_hogwild(&hogwild, &workspace_hogwild, 1, &data, NULL, 10, 0.1) == correct);
+    for (int l = 0; l < 3; ++l)
+    {
+        struct Layer *a = get_Layer(&single, l);
+        struct Layer *b = get_Layer(&hogwild, l);
+        for (int j = 0; j < a->num_Neurons; ++j)
+        {
+            for (int k = 0; k < a->num_Inputs; ++k)
+            {
+                assert(get_Weight_Row(a, j)[k] == get_Weight_Row(b, j)[k]);
+            }
+        }
+    }
+
+    // With several threads every sample is still seen exactly once per epoch
+    struct Workspace workspaces[3];
+    for (int w = 0; w < 3; ++w) init_Workspace(&workspaces[w], &hogwild, 2);
+    int num_correct = train_epoch_hogwild(&hogwild, workspaces, 3, &data, NULL, 10, 0.1);
+    assert(num_correct >= 0 && num_correct <= 10);
+    for (int w = 0; w < 3; ++w) free_Workspace(&workspaces[w]);
+
+    free_Workspace(&workspace_single);
+    free_Workspace(&workspace_hogwild);
+    free_Data(&data);
+    free_Network(&single);
+    free_Network(&hogwild);
+}
+
+/* --------------------------------------------------- */
+void test_calculate_accuracy()
+{
+    // More samples than one evaluation batch, the last batch is partial
+    int num_samples = EVAL_BATCH_SIZE + 45;
+    int hidden_Sizes[] = {20, 12};
+    struct Network network;
+    srand(13);
+    init_Network(&network, 6, hidden_Sizes, 2, 3);
+    // away from saturation, so that no two outputs round to the same value
+    for (int l = 0; l < get_Num_Weighted_Layers(&network); ++l)
+    {
+        struct Layer *layer = get_Layer(&network, l);
+        for (int j = 0; j < layer->num_Neurons; ++j)
+        {
+            for (int k = 0; k < layer->num_Inputs; ++k) get_Weight_Row(layer, j)[k] -= 0.5;
+        }
+    }
+    struct Data data = init_random_data(num_samples);
+
+    // Reference: single sample forward passes
+    int expected_correct = 0;
+    int expected_confusion[3][3] = {{0}};
+    real values[6];
+    for (int s = 0; s < num_samples; ++s)
+    {
+        get_Sample(&data, s, values, NULL);
+        forward_propagate(&network, values);
+        int predicted = get_predicted_label(&network);
+        expected_confusion[data.labels[s]][predicted]++;
+        expected_correct += predicted == data.labels[s];
+    }
+
+    int confusion[3][3];
+    double accuracy = calculate_accuracy(&network, &data, num_samples, &confusion[0][0]);
+    assert(fabs(accuracy - 100.0 * expected_correct / num_samples) < 1e-9);
+    assert(memcmp(confusion, expected_confusion, sizeof(confusion)) == 0);
+
+    // more samples than rows only evaluates the rows
+    assert(fabs(calculate_accuracy(&network, &data, num_samples + 100, NULL) - accuracy) < 1e-9);
+
+    free_Data(&data);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+void test_calculate_accuracy_mismatch()
+{
+    int hidden_Sizes[] = {8};
+    struct Network network;
+    srand(17);
+    // one output more than the data set has classes
+    init_Network(&network, 6, hidden_Sizes, 1, 4);
+    struct Data data = init_random_data(20);
+
+    int confusion[3][3] = {{-1}};
+    assert(calculate_accuracy(&network, &data, 20, &confusion[0][0]) == -1.0);
+    assert(confusion[0][0] == -1); // nothing was evaluated
+    free_Network(&network);
+
+    // one input more than the data set has features, e.g. a model loaded for other data
+    init_Network(&network, 7, hidden_Sizes, 1, 3);
+    assert(calculate_accuracy(&network, &data, 20, &confusion[0][0]) == -1.0);
+    assert(confusion[0][0] == -1);
+    free_Network(&network);
+
+    init_Network(&network, 6, hidden_Sizes, 1, 3);
+    assert(calculate_accuracy(&network, &data, 0, NULL) == -1.0);
+
+    free_Data(&data);
+    free_Network(&network);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Initialize a network with leaky ReLU and tanh hidden layers and a softmax output,
+ * wide enough that a team of threads splits the output layer
+ */
+static void init_activation_network(struct Network *network)
+{
+    int hidden_Sizes[] = {20, 12};
+    srand(11);
+    init_Network(network, 6, hidden_Sizes, 2, 20);
+    assert(set_Network_Activations(network, ACTIVATION_LEAKY_RELU, ACTIVATION_SOFTMAX));
+    set_Layer_Activation(&network->hidden_Layer[1], ACTIVATION_TANH);
+}
+
+void test_activations_batch()
+{
+    struct Network single, team;
+    init_activation_network(&single);
+    init_activation_network(&team);
+
+    struct Data data = init_Data(9, 6, 20);
+    for (int s = 0; s < 9; ++s)
+    {
+        for (int i = 0; i < 6; ++i) data.pixels[s * 6 + i] = rand() % 256;
+        data.labels[s] = (s * 7) % 20;
+    }
+
+    struct Workspace workspace_single, workspace_team;
+    init_Workspace(&workspace_single, &single, 9);
+    init_Workspace(&workspace_team, &team, 9);
+
+    // The softmax rows of the team match the single sample forward pass and sum to one
+    #pragma omp parallel num_threads(3)
+    {
+        stage_Batch(&team, &workspace_team, &data, NULL, 0, 9);
+        forward_propagate_batch(&team, &workspace_team, 9);
+    }
+    const real *outputs = workspace_team.activations[workspace_team.num_Layers];
+    int ld_Out = workspace_team.ld[workspace_team.num_Layers];
+    real values[6];
+    for (int s = 0; s < 9; ++s)
+    {
+        get_Sample(&data, s, values, NULL);
+        forward_propagate(&single, values);
+        double sum = 0.0;
+        for (int i = 0; i < 20; ++i)
+        {
+            assert(fabs(outputs[s * ld_Out + i] - single.output_Layer.outputs[i]) < EPSILON);
+            sum += outputs[s * ld_Out + i];
+        }
+        assert(fabs(sum - 1.0) < EPSILON);
+    }
+
+    // Two batches, so the second one runs on weights updated by the team
+    for (int batch = 0; batch < 2; ++batch)
+    {
+        stage_Batch(&single, &workspace_single, &data, NULL, 0, 9);
+        forward_propagate_batch(&single, &workspace_single, 9);
+        calculate_errors_batch(&single, &workspace_single, 9);
+        update_weights_batch(&single, &workspace_single, 9, 0.1);
+
+        #pragma omp parallel num_threads(3)
+        {
+            stage_Batch(&team, &workspace_team, &data, NULL, 0, 9);
+            forward_propagate_batch(&team, &workspace_team, 9);
+            calculate_errors_batch(&team, &workspace_team, 9);
+            update_weights_batch(&team, &workspace_team, 9, 0.1);
+        }
+    }
+    for (int l = 0; l < 3; ++l)
+    {
+        struct Layer *a = get_Layer(&single, l);
+        struct Layer *b = get_Layer(&team, l);
+        for (int j = 0; j < a->num_Neurons; ++j)
+        {
+            for (int k = 0; k < a->num_Inputs; ++k)
+            {
+                assert(fabs(get_Weight_Row(a, j)[k] - get_Weight_Row(b, j)[k]) < EPSILON);
+            }
+        }
+    }
+
+    free_Workspace(&workspace_single);
+    free_Workspace(&workspace_team);
+    free_Data(&data);
+    free_Network(&single);
+    free_Network(&team);
+}
+
+/* --------------------------------------------------- */
+/* First update of a parameter with gradient g and learning rate 0.01, all optimizer state still 0 */
+static double first_step(enum Optimizer optimizer, double g)
+{
+    switch (optimizer)
+    {
+        case OPTIMIZER_RMSPROP: return 0.01 * g / (sqrt(1 - RMSPROP_DECAY) * fabs(g) + OPTIMIZER_EPSILON);
+        case OPTIMIZER_ADAM:    return 0.01 * g / (fabs(g) + OPTIMIZER_EPSILON);
+        default:                return 0.01 * g; // without a history momentum is plain SGD
+    }
+}
+
+void test_optimizers()
+{
+    struct Data data = init_batch_data();
+    struct Network network, initial;
+    init_batch_network(&initial);
+
+    for (int o = 0; o < NUM_OPTIMIZERS; ++o)
+    {
+        init_batch_network(&network);
+        set_Network_Optimizer(&network, (enum Optimizer)o);
+        assert((network.hidden_Layer[0].first_Moments != NULL) == (o == OPTIMIZER_MOMENTUM || o == OPTIMIZER_ADAM));
+        assert((network.hidden_Layer[0].second_Moments != NULL) == (o == OPTIMIZER_RMSPROP || o == OPTIMIZER_ADAM));
+
+        struct Workspace workspace;
+        init_Workspace(&workspace, &network, 5);
+        stage_Batch(&network, &workspace, &data, NULL, 0, 5);
+        forward_propagate_batch(&network, &workspace, 5);
+        calculate_errors_batch(&network, &workspace, 5);
+        update_weights_batch(&network, &workspace, 5, 0.01);
+        assert(network.optimizer_Steps == 1);
+
+        for (int l = 0; l < get_Num_Weighted_Layers(&network); ++l)
+        {
+            struct Layer *updated = get_Layer(&network, l);
+            struct Layer *before = get_Layer(&initial, l);
+            for (int j = 0; j < updated->num_Neurons; ++j)
+            {
+                for (int k = 0; k < updated->stride; ++k)
+                {
+                    real delta = get_Weight_Row(updated, j)[k] - get_Weight_Row(before, j)[k];
+                    real gradient = workspace.gradients[l][j * updated->stride + k];
+                    if (k < updated->num_Inputs)
+                    {
+                        assert(fabs(delta - first_step((enum Optimizer)o, gradient)) < EPSILON);
+                    }
+                    else
+                    {
+                        // the padding stays 0
+                        assert(get_Weight_Row(updated, j)[k] == 0.0);
+                    }
+                }
+                real bias_delta = updated->biases[j] - before->biases[j];
+                assert(fabs(bias_delta - first_step((enum Optimizer)o, workspace.bias_Gradients[l][j])) < EPSILON);
+            }
+        }
+
+        // Training goes on from the state of the first step
+        for (int repeat = 0; repeat < 20; ++repeat)
+        {
+            forward_propagate_batch(&network, &workspace, 5);
+            calculate_errors_batch(&network, &workspace, 5);
+            update_weights_batch(&network, &workspace, 5, 0.01);
+        }
+        assert(network.optimizer_Steps == 21);
+
+        free_Workspace(&workspace);
+        free_Network(&network);
+    }
+
+    free_Network(&initial);
+    free_Data(&data);
+}
+
 /**
  * Main entry for the test.
  */
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that training() takes the batch size, epochs and learning rate of its configuration
+ *
+ * Without shuffling, training is mini-batch training over the samples in order, with and without pipeline.
+ */
+void test_training_config()
+{
+    int hidden_Sizes[] = {20, 12};
+    srand(13);
+    struct Data data = init_random_data(10);
+    set_Log_Level(0);
+
+    for (int slots = 0; slots <= 2; slots += 2)
+    {
+        struct Network expected, trained;
+        srand(14);
+        init_Network(&expected, 6, hidden_Sizes, 2, 3);
+        srand(14);
+        init_Network(&trained, 6, hidden_Sizes, 2, 3);
+        struct Workspace workspace;
+        init_Workspace(&workspace, &expected, 3);
+        for (int epoch = 0; epoch < 2; ++epoch)
+        {
+            for (int batch_start = 0; batch_start < 10; batch_start += 3)
+            {
+                int batch_Size = batch_start + 3 < 10 ? 3 : 10 - batch_start;
+                train_batch_neuron_parallel(&expected, &workspace, &data, NULL, batch_start, batch_Size, 0.1);
+            }
+        }
+
+        struct Training_Config config;
+        init_Training_Config(&config);
+        config.epochs = 2;
+        config.learning_rate = 0.1;
+        config.batch_Size = 3;
+        config.shuffle = 0;
+        config.pipeline_Slots = slots;
+        training(&trained, &config, &data, 10);
+        for (int l = 0; l < 3; ++l)
+        {
+            struct Layer *a = get_Layer(&expected, l);
+            struct Layer *b = get_Layer(&trained, l);
+            for (int j = 0; j < a->num_Neurons; ++j)
+            {
+                assert(a->biases[j] == b->biases[j]);
+                for (int k = 0; k < a->num_Inputs; ++k)
+                {
+                    assert(get_Weight_Row(a, j)[k] == get_Weight_Row(b, j)[k]);
+                }
+            }
+        }
+        free_Workspace(&workspace);
+        free_Network(&expected);
+        free_Network(&trained);
+    }
+
+    set_Log_Level(LOG);
+    free_Data(&data);
+}
+
+/* --------------------------------------------------- */
+/**
+ * @brief Function to test that training() rejects a network whose input or output layer does not fit the data set
+ */
+void test_training_mismatch()
+{
+    int hidden_Sizes[] = {8};
+    srand(15);
+    struct Data data = init_random_data(10);
+    struct Training_Config config;
+    init_Training_Config(&config);
+    config.epochs = 1;
+    set_Log_Level(0);
+
+    for (int slots = 0; slots <= 2; slots += 2)
+    {
+        config.pipeline_Slots = slots;
+        struct Network network;
+        // one input more than the data set has features
+        init_Network(&network, 7, hidden_Sizes, 1, 3);
+        real weight = get_Weight_Row(get_Layer(&network, 0), 0)[0];
+        assert(training(&network, &config, &data, 10) == -1);
+        assert(get_Weight_Row(get_Layer(&network, 0), 0)[0] == weight); // nothing was trained
+        free_Network(&network);
+
+        // one output less than the data set has classes
+        init_Network(&network, 6, hidden_Sizes, 1, 2);
+        assert(training(&network, &config, &data, 10) == -1);
+        free_Network(&network);
+    }
+
+    set_Log_Level(LOG);
+    free_Data(&data);
+}
+
 int main(int argc, char **argv)
 {
     //test_forward_propagation();
     //test_back_propagation();
     //test_training();
+    test_forward_propagate_batch();
+    test_stage_Batch_shuffled();
+    test_update_weights_batch();
+    test_batch_in_parallel_region();
+    test_train_batch_data_parallel();
+    test_train_epoch_hogwild();
+    test_calculate_accuracy();
+    test_calculate_accuracy_mismatch();
+    test_activations_batch();
+    test_optimizers();
+    test_training_config();
+    test_training_mismatch();
     return 0;
 }
 /* -------------------- EOF -------------------------- */
\ No newline at end of file
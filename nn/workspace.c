@@ -0,0 +1,80 @@
+/**
+ * @file Workspace source file
+ * @brief Workspace function definitions
+ */
+
+/* Includes ------------------------------------------ */
+#include "workspace.h"
+/* --------------------------------------------------- */
+
+real *alloc_Matrix(int rows, int ld)
+{
+    size_t size = (size_t)rows * ld * sizeof(real);
+    if (size == 0){
+        return NULL;
+    }
+    real *matrix = (real *)aligned_alloc(WEIGHT_ALIGNMENT, size);
+    if (matrix == NULL){
+        fprintf(stderr, "Could not allocate workspace matrix!");
+        exit(-1);
+    }
+    for (size_t i = 0; i < size / sizeof(real); ++i){
+        matrix[i] = 0.0;
+    }
+    return matrix;
+}
+
+/* --------------------------------------------------- */
+void init_Workspace(struct Workspace *workspace, struct Network *network, int max_Batch){
+    const int elements_Per_Line = WEIGHT_ALIGNMENT / sizeof(real);
+    int num_Layers = get_Num_Weighted_Layers(network);
+
+    workspace->max_Batch = max_Batch;
+    workspace->num_Layers = num_Layers;
+    workspace->ld = (int *)malloc((num_Layers + 1) * sizeof(int));
+    workspace->activations = (real **)malloc((num_Layers + 1) * sizeof(real *));
+    workspace->errors = (real **)malloc(num_Layers * sizeof(real *));
+    workspace->gradients = (real **)malloc(num_Layers * sizeof(real *));
+    workspace->bias_Gradients = (real **)malloc(num_Layers * sizeof(real *));
+    if (workspace->ld == NULL || workspace->activations == NULL || workspace->errors == NULL || workspace->gradients == NULL ||
+        workspace->bias_Gradients == NULL){
+        fprintf(stderr, "Could not allocate workspace!");
+        exit(-1);
+    }
+
+    for (int l = 0; l <= num_Layers; ++l){
+        int width = (l == 0) ? network->input_Layer.num_Neurons : get_Layer(network, l - 1)->num_Neurons;
+        workspace->ld[l] = (width + elements_Per_Line - 1) / elements_Per_Line * elements_Per_Line;
+        workspace->activations[l] = alloc_Matrix(max_Batch, workspace->ld[l]);
+    }
+    for (int l = 0; l < num_Layers; ++l){
+        struct Layer *layer = get_Layer(network, l);
+        workspace->errors[l] = alloc_Matrix(max_Batch, workspace->ld[l + 1]);
+        workspace->gradients[l] = alloc_Matrix(layer->num_Neurons, layer->stride);
+        workspace->bias_Gradients[l] = alloc_Matrix(1, workspace->ld[l + 1]);
+    }
+    workspace->targets = alloc_Matrix(max_Batch, workspace->ld[num_Layers]);
+}
+
+/* --------------------------------------------------- */
+void free_Workspace(struct Workspace *workspace){
+    if (workspace == NULL){
+        fprintf(stderr, "Workspace does not exist!\n");
+        return;
+    }
+    for (int l = 0; l <= workspace->num_Layers; ++l){
+        free(workspace->activations[l]);
+    }
+    for (int l = 0; l < workspace->num_Layers; ++l){
+        free(workspace->errors[l]);
+        free(workspace->gradients[l]);
+        free(workspace->bias_Gradients[l]);
+    }
+    free(workspace->targets);
+    free(workspace->activations);
+    free(workspace->errors);
+    free(workspace->gradients);
+    free(workspace->bias_Gradients);
+    free(workspace->ld);
+}
+/* --------------------------------------------------- */
@@ -0,0 +1,62 @@
+/**
+ * @file Workspace header file
+ * @brief Batch buffers used by the batched forward and backward passes
+ */
+#ifndef NN_WORKSPACE_H
+#define NN_WORKSPACE_H
+
+/* Includes ------------------------------------------ */
+#include "network.h"
+/* --------------------------------------------------- */
+
+/**
+ * @struct Workspace
+ * @brief Holds the per-batch matrices of a network
+ *
+ * Every matrix is row-major with one row per sample of the batch and is aligned to
+ * WEIGHT_ALIGNMENT. For a network with L weighted layers (hidden layers + output layer):
+ * - `activations[0]` holds the staged inputs, `activations[l + 1]` the outputs of weighted layer l
+ * - `ld[l]` is the leading dimension of `activations[l]` and of `errors[l - 1]`
+ * - `errors[l]` holds the errors (deltas) of weighted layer l
+ * - `gradients[l]` holds the weight gradients of weighted layer l, laid out like its weights
+ * - `bias_Gradients[l]` holds the bias gradients of weighted layer l, one row of `ld[l + 1]` entries
+ * - `targets` holds the expected outputs of the batch, with leading dimension `ld[L]`
+ */
+struct Workspace {
+    int max_Batch;          /**< Number of samples the matrices have room for */
+    int num_Layers;         /**< Number of weighted layers L */
+    int *ld;                /**< Leading dimensions of the activation matrices, L + 1 entries */
+    real **activations;     /**< Activation matrices (max_Batch x ld[l]), L + 1 entries */
+    real **errors;          /**< Error matrices (max_Batch x ld[l + 1]), L entries */
+    real **gradients;       /**< Weight gradient matrices (num_Neurons x stride), L entries */
+    real **bias_Gradients;  /**< Bias gradient vectors (1 x ld[l + 1]), L entries */
+    real *targets;          /**< Expected outputs (max_Batch x ld[L]) */
+};
+/* --------------------------------------------------- */
+
+/**
+ * @brief Allocate an aligned, zeroed matrix
+ * @param rows number of rows
+ * @param ld leading dimension in elements, a multiple of WEIGHT_ALIGNMENT / sizeof(real)
+ * @return pointer to the matrix, NULL if it is empty
+ */
+real *alloc_Matrix(int rows, int ld);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Allocate the batch buffers for a network
+ * @param workspace pointer to the workspace struct that is going to be initialized
+ * @param network pointer to the network the buffers are sized for
+ * @param max_Batch maximum number of samples per batch
+ */
+void init_Workspace(struct Workspace *workspace, struct Network *network, int max_Batch);
+/* --------------------------------------------------- */
+
+/**
+ * @brief Delete the workspace struct previously initialized
+ * @param workspace pointer to the workspace struct that is going to be deleted
+ */
+void free_Workspace(struct Workspace *workspace);
+/* --------------------------------------------------- */
+
+#endif //NN_WORKSPACE_H
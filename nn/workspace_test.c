@@ -0,0 +1,62 @@
+/**
+ * @brief Test for functions in workspace.c
+ */
+/* Includes ------------------------------------------ */
+#include "layer.c"
+#include "network.c"
+#include "workspace.c"
+#include <assert.h>
+/* --------------------------------------------------- */
+static void test_init_Workspace();
+/* --------------------------------------------------- */
+
+/**
+ * @brief Function to test the allocation of the batch buffers of a network
+ *
+ * A network with 3 inputs, hidden layers of 5 and 9 neurons and 2 outputs gets a workspace
+ * for batches of 4 samples. The testing happens when asserting the leading dimensions,
+ * the alignment and the initial content of the different matrices.
+ */
+static void test_init_Workspace(){
+    struct Network network;
+    int hidden_Sizes[] = {5, 9};
+    init_Network(&network, 3, hidden_Sizes, 2, 2);
+
+    struct Workspace workspace;
+    init_Workspace(&workspace, &network, 4);
+    assert(workspace.max_Batch == 4);
+    assert(workspace.num_Layers == 3);
+
+    int widths[] = {3, 5, 9, 2};
+    for (int l = 0; l <= workspace.num_Layers; ++l) {
+        /* rows are padded to whole cache lines */
+        assert(workspace.ld[l] >= widths[l] && (workspace.ld[l] * sizeof(real)) % WEIGHT_ALIGNMENT == 0);
+        assert((size_t)workspace.activations[l] % WEIGHT_ALIGNMENT == 0);
+        for (int i = 0; i < workspace.max_Batch * workspace.ld[l]; ++i) {
+            assert(workspace.activations[l][i] == 0.0);
+        }
+    }
+    for (int l = 0; l < workspace.num_Layers; ++l) {
+        assert((size_t)workspace.errors[l] % WEIGHT_ALIGNMENT == 0);
+        /* gradients share the layout of the weights */
+        struct Layer *layer = get_Layer(&network, l);
+        for (int i = 0; i < layer->num_Neurons * layer->stride; ++i) {
+            assert(workspace.gradients[l][i] == 0.0);
+        }
+    }
+    assert(workspace.targets != NULL);
+
+    free_Workspace(&workspace);
+    free_Network(&network);
+}
+/* --------------------------------------------------- */
+
+/**
+ * Main entry for the test.
+ */
+int main(int argc, char **argv)
+{
+    test_init_Workspace();
+    return 0;
+}
+/* -------------------- EOF -------------------------- */